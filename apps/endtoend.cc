@@ -1,6 +1,7 @@
 #include "address.hh"
 #include "arp_message.hh"
 #include "bidirectional_stream_copy.hh"
+#include "buffer_pool.hh"
 #include "exception.hh"
 #include "helpers.hh"
 #include "router.hh"
@@ -8,7 +9,9 @@
 #include "tcp_over_ip.hh"
 
 #include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <span>
 #include <thread>
 #include <utility>
 
@@ -42,10 +45,13 @@ EthernetAddress random_router_ethernet_address()
 optional<EthernetFrame> maybe_receive_frame( FileDescriptor& fd )
 {
   vector<string> strs( 4 );
+  for ( auto& header : span { strs }.first( 3 ) ) {
+    header = BufferPool::small(); // returned to the pool once parsed
+  }
   strs.at( 0 ).resize( EthernetHeader::LENGTH );
   strs.at( 1 ).resize( IPv4Header::LENGTH );
   strs.at( 2 ).resize( TCPSegment::HEADER_LENGTH );
-  fd.read( strs );
+  fd.read( strs ); // takes the payload buffer from the pool
 
   EthernetFrame frame;
   if ( not parse( frame, move( strs ) ) ) {
@@ -83,7 +89,11 @@ public:
   NetworkInterfaceAdapter( const Address& ip_address, const Address& next_hop ) // NOLINT(*-swappable-*)
     : _interface( "network interface adapter", sender_, random_host_ethernet_address(), ip_address )
     , _next_hop( next_hop )
-  {}
+  {
+    // the link to the router is an in-process socketpair, which cannot corrupt a segment, and the
+    // Internet hop is a UDP socket, which has a checksum of its own
+    set_checksum_offload( { .skip_verify = true } );
+  }
 
   optional<TCPMessage> read()
   {
@@ -158,10 +168,10 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
   class FramesOut : public NetworkInterface::OutputPort
   {
   public:
-    queue<EthernetFrame> frames {};
+    deque<EthernetFrame> frames {};
     void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x ) override
     {
-      frames.push( clone( x ) );
+      frames.push_back( clone( x ) );
     }
   };
 
@@ -211,6 +221,13 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
   thread network_thread( [&]() {
     try {
       EventLoop event_loop;
+      event_loop.set_dispatch( EventLoop::Dispatch::AllReady ); // one poll serves every ready direction
+
+      // frames to and from the Internet are batched, to amortize system calls over bursts
+      constexpr size_t batch_size = 32;
+      vector<string> inbound_batch( batch_size );
+      vector<PacketBuffers> outbound_batch;
+
       // Frames from host to router
       event_loop.add_rule( "frames from host to router", sock.adapter().frame_fd(), Direction::In, [&] {
         auto frame_opt = maybe_receive_frame( sock.adapter().frame_fd() );
@@ -236,7 +253,7 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
             cerr << "     Router->host:     " << summary( f->frames.front() ) << "\n";
           }
           sock.adapter().frame_fd().write( serialize( f->frames.front() ) );
-          f->frames.pop();
+          f->frames.pop_front();
         },
         [&] { return not router_to_host->frames.empty(); } );
 
@@ -247,25 +264,34 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
         Direction::Out,
         [&] {
           auto& f = router_to_internet;
-          if ( debug ) {
-            cerr << "     Router->Internet: " << summary( f->frames.front() ) << "\n";
+          // send everything queued (up to a batch) with one system call
+          outbound_batch.clear();
+          while ( outbound_batch.size() < f->frames.size() and outbound_batch.size() < batch_size ) {
+            const EthernetFrame& frame = f->frames.at( outbound_batch.size() );
+            if ( debug ) {
+              cerr << "     Router->Internet: " << summary( frame ) << "\n";
+            }
+            outbound_batch.push_back( serialize( frame ) );
           }
-          internet_socket.write( serialize( f->frames.front() ) );
-          f->frames.pop();
+          const size_t sent = internet_socket.send_batch( outbound_batch );
+          f->frames.erase( f->frames.begin(), f->frames.begin() + static_cast<ptrdiff_t>( sent ) );
         },
         [&] { return not router_to_internet->frames.empty(); } );
 
       // Frames from Internet to router
       event_loop.add_rule( "frames from Internet to router", internet_socket, Direction::In, [&] {
-        auto frame_opt = maybe_receive_frame( internet_socket );
-        if ( not frame_opt ) {
-          return;
-        }
-        EthernetFrame frame = move( frame_opt.value() );
-        if ( debug ) {
-          cerr << "     Internet->router: " << summary( frame ) << "\n";
+        // take everything queued (up to a batch) with one system call, then route it all
+        const size_t received = internet_socket.recv_batch( inbound_batch );
+        for ( size_t i = 0; i < received; ++i ) {
+          EthernetFrame frame;
+          if ( not parse( frame, span { &inbound_batch.at( i ), 1 } ) ) {
+            continue;
+          }
+          if ( debug ) {
+            cerr << "     Internet->router: " << summary( frame ) << "\n";
+          }
+          router.interface( internet_side )->recv_frame( move( frame ) );
         }
-        router.interface( internet_side )->recv_frame( move( frame ) );
         router.route();
       } );
 
@@ -304,6 +330,12 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
   exit_flag = true;
   network_thread.join();
   cerr << "done.\n";
+
+  if ( debug ) {
+    const auto& counters = sock.adapter().checksum_counters();
+    cerr << "DEBUG: TCP checksums verified=" << counters.verified << " skipped=" << counters.skipped
+         << " computed=" << counters.computed << " deferred=" << counters.deferred << "\n";
+  }
 }
 // NOLINTEND(*-cognitive-complexity)
 
@@ -11,6 +11,7 @@
 #include <span>
 #include <string>
 #include <tuple>
+#include <utility>
 
 using namespace std;
 
@@ -35,7 +36,9 @@ void show_usage( const char* argv0, const char* msg )
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n"
+       << "   -o              Use TCP checksum offload and coalesced reads    (off)\n"
+       << "   -u              Read and write <tundev> through io_uring        (off)\n\n"
 
        << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
        << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
@@ -56,7 +59,7 @@ void check_argc( const span<char*>& args, size_t curr, const char* err )
   }
 }
 
-tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char*>& args )
+tuple<TCPConfig, FdAdapterConfig, bool, const char*, bool, bool> get_config( const span<char*>& args )
 {
   TCPConfig c_fsm {};
   c_fsm.isn = Wrap32 { random_device()() };
@@ -66,6 +69,8 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
 
   size_t curr = 1;
   bool listen = false;
+  bool tcp_offload = false;
+  bool use_io_uring = false;
   const size_t argc = args.size();
 
   string source_address = LOCAL_ADDRESS_DFLT;
@@ -101,6 +106,14 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
       tundev = args[curr + 1];
       curr += 2;
 
+    } else if ( strncmp( "-o", args[curr], 3 ) == 0 ) {
+      tcp_offload = true;
+      curr += 1;
+
+    } else if ( strncmp( "-u", args[curr], 3 ) == 0 ) {
+      use_io_uring = true;
+      curr += 1;
+
     } else if ( strncmp( "-Lu", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -Lu requires one argument." );
       const float lossrate = strtof( args[curr + 1], nullptr );
@@ -127,6 +140,11 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     }
   }
 
+  if ( tcp_offload and use_io_uring ) {
+    show_usage( args[0], "ERROR: -o and -u cannot be combined." );
+    exit( 1 );
+  }
+
   // parse positional command-line arguments
   if ( listen ) {
     c_filt.source = { "0", args[curr + 1] };
@@ -139,7 +157,7 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     c_filt.source = { source_address, source_port };
   }
 
-  return make_tuple( c_fsm, c_filt, listen, tundev );
+  return make_tuple( c_fsm, c_filt, listen, tundev, tcp_offload, use_io_uring );
 }
 } // namespace
 
@@ -157,9 +175,10 @@ int main( int argc, char** argv )
       return EXIT_FAILURE;
     }
 
-    auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
-    LossyTCPOverIPv4MinnowSocket tcp_socket( LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>(
-      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
+    auto [c_fsm, c_filt, listen, tun_dev_name, tcp_offload, use_io_uring] = get_config( args );
+    TunFD tun { tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name, tcp_offload };
+    LossyTCPOverIPv4MinnowSocket tcp_socket(
+      LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>( TCPOverIPv4OverTunFdAdapter( move( tun ), use_io_uring ) ) );
 
     if ( listen ) {
       tcp_socket.listen_and_accept( c_fsm, c_filt );
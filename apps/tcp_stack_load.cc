@@ -0,0 +1,148 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "sharded_tcp_stack.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Load test for TCPStack: one stack listens and another opens many connections to it, over a
+// Unix-domain datagram socket pair standing in for the network. Each client sends a fixed number of
+// bytes and closes; the server reads to EOF and closes. Each stack is sharded across a number of workers.
+
+namespace {
+void show_usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0
+       << " [connections (default 100)] [bytes per connection (default 100000)] [workers per stack (default 1)]\n";
+}
+
+pair<FileDescriptor, FileDescriptor> make_socket_pair()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+bool program_body( size_t connections, size_t bytes_per_connection, size_t workers )
+{
+  auto [server_wire, client_wire] = make_socket_pair();
+  ShardedTCPStack server_stack { server_wire.duplicate(), move( server_wire ), workers };
+  ShardedTCPStack client_stack { client_wire.duplicate(), move( client_wire ), workers };
+
+  TCPConfig config;
+  config.rt_timeout = 100;
+
+  const Address server_address { "10.144.0.1", 80 };
+  TCPListener listener = server_stack.listen( config, server_address, connections );
+
+  const auto start_time = chrono::steady_clock::now();
+
+  vector<LocalStreamSocket> clients;
+  for ( size_t i = 0; i < connections; i++ ) {
+    FdAdapterConfig c_ad;
+    c_ad.source = Address { "10.144.0.2", static_cast<uint16_t>( 1024 + i ) };
+    c_ad.destination = server_address;
+    clients.push_back( client_stack.connect( config, c_ad ) );
+    clients.back().set_blocking( false );
+  }
+
+  vector<LocalStreamSocket> servers;
+  for ( size_t i = 0; i < connections; i++ ) {
+    servers.push_back( listener.accept() );
+  }
+
+  const auto accepted_time = chrono::steady_clock::now();
+  cerr << "Accepted " << connections << " connections in "
+       << chrono::duration_cast<chrono::milliseconds>( accepted_time - start_time ).count() << " ms.\n";
+
+  EventLoop eventloop { EventLoop::Backend::Epoll };
+  const string chunk( 16384, 'x' );
+  vector<size_t> bytes_sent( connections );
+  vector<size_t> bytes_received( connections );
+
+  const size_t send_category = eventloop.add_category( "client writes" );
+  const size_t receive_category = eventloop.add_category( "server reads" );
+  for ( size_t i = 0; i < connections; i++ ) {
+    eventloop.add_rule(
+      send_category,
+      clients[i],
+      Direction::Out,
+      [&, i] {
+        const size_t len = min( chunk.size(), bytes_per_connection - bytes_sent[i] );
+        bytes_sent[i] += clients[i].write( string_view { chunk }.substr( 0, len ) );
+        if ( bytes_sent[i] == bytes_per_connection ) {
+          clients[i].shutdown( SHUT_WR );
+        }
+      },
+      [&, i] { return bytes_sent[i] < bytes_per_connection; } );
+
+    eventloop.add_rule( receive_category, servers[i], Direction::In, [&, i] {
+      string buffer;
+      servers[i].read( buffer );
+      bytes_received[i] += buffer.size();
+      if ( servers[i].eof() ) {
+        servers[i].shutdown( SHUT_WR );
+      }
+    } );
+  }
+
+  while ( eventloop.wait_next_event( -1 ) != EventLoop::Result::Exit ) {}
+
+  const auto done_time = chrono::steady_clock::now();
+  const auto ms = chrono::duration_cast<chrono::milliseconds>( done_time - accepted_time ).count();
+  size_t total = 0;
+  bool ok = true;
+  for ( size_t i = 0; i < connections; i++ ) {
+    total += bytes_received[i];
+    ok &= ( bytes_received[i] == bytes_per_connection );
+  }
+  cerr << "Transferred " << total << " bytes over " << connections << " connections in " << ms << " ms ("
+       << ( ms > 0 ? static_cast<double>( total ) * 8 / static_cast<double>( ms ) / 1000 : 0 ) << " Mbit/s).\n";
+
+  // wait for the connections to finish (the client side lingers after its streams finish)
+  for ( int i = 0; i < 100 and server_stack.connection_count() + client_stack.connection_count() > 0; i++ ) {
+    this_thread::sleep_for( chrono::milliseconds( 50 ) );
+  }
+  cerr << "Connections remaining: server " << server_stack.connection_count() << ", client "
+       << client_stack.connection_count() << ".\n";
+
+  return ok;
+}
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+    if ( argc > 4 ) {
+      show_usage( args.front() );
+      return EXIT_FAILURE;
+    }
+
+    const size_t connections = argc > 1 ? stoul( args[1] ) : 100;
+    const size_t bytes_per_connection = argc > 2 ? stoul( args[2] ) : 100000;
+    const size_t workers = argc > 3 ? stoul( args[3] ) : 1;
+
+    if ( not program_body( connections, bytes_per_connection, workers ) ) {
+      cerr << "Error: some connections did not deliver all of their bytes.\n";
+      return EXIT_FAILURE;
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
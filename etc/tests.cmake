@@ -45,6 +45,7 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_timestamps)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,11 +54,46 @@ ttest(send_ack)
 ttest(send_close)
 ttest(send_retx)
 ttest(send_extra)
+ttest(send_timestamps)
 
 ttest(net_interface)
 
 ttest(router)
 
+ttest(ref_share)
+ttest(buffer_pool)
+ttest(small_vector)
+ttest(timer_wheel)
+ttest(parse_split)
+ttest(serialize_tcp_in_ip)
+ttest(checksum_offload)
+ttest(datagram_batch)
+
+ttest(tcp_stack_dispatch)
+ttest(tcp_listener_backlog)
+ttest(sharded_tcp_accept)
+ttest(shared_ring_stream)
+
+# needs CAP_NET_ADMIN to create a veth pair, and is skipped without it
+add_test(NAME t_packet_ring COMMAND "${PROJECT_SOURCE_DIR}/tests/packet_ring_t.sh" "${PROJECT_BINARY_DIR}")
+set_property(TEST t_packet_ring PROPERTY FIXTURES_REQUIRED compile)
+set_property(TEST t_packet_ring PROPERTY SKIP_RETURN_CODE 77)
+
+# uses a TUN device if it can create one (CAP_NET_ADMIN), and is skipped if io_uring is unavailable
+add_test(NAME t_io_uring_packets COMMAND "${PROJECT_SOURCE_DIR}/tests/io_uring_packets_t.sh" "${PROJECT_BINARY_DIR}")
+set_property(TEST t_io_uring_packets PROPERTY FIXTURES_REQUIRED compile)
+set_property(TEST t_io_uring_packets PROPERTY SKIP_RETURN_CODE 77)
+
+# needs CAP_NET_ADMIN to create a TUN device, and is skipped without it
+add_test(NAME t_tun_offload COMMAND "${PROJECT_SOURCE_DIR}/tests/tun_offload_t.sh" "${PROJECT_BINARY_DIR}")
+set_property(TEST t_tun_offload PROPERTY FIXTURES_REQUIRED compile)
+set_property(TEST t_tun_offload PROPERTY SKIP_RETURN_CODE 77)
+
+# needs CAP_NET_ADMIN to create a multiqueue TUN device, and is skipped without it
+add_test(NAME t_multiqueue_tun COMMAND "${PROJECT_SOURCE_DIR}/tests/multiqueue_tun_t.sh" "${PROJECT_BINARY_DIR}")
+set_property(TEST t_multiqueue_tun PROPERTY FIXTURES_REQUIRED compile)
+set_property(TEST t_multiqueue_tun PROPERTY SKIP_RETURN_CODE 77)
+
 ttest(no_skip)
 
 add_custom_target (check0 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 15 -R 'webget|^byte_stream_|^no_skip')
@@ -94,3 +130,5 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(eventloop_speed_test)
+stest(checksum_speed_test)
@@ -48,10 +48,8 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
   // We don't know the Ethernet address, queue the datagram
   pending_datagrams_[next_hop_ip].push( dgram );
   
-  // Check if we recently sent an ARP request for this IP (within 5 seconds)
-  auto recent_request = recent_arp_requests_.find( next_hop_ip );
-  if ( recent_request != recent_arp_requests_.end() && 
-       current_time_ms_ - recent_request->second < 5000 ) {
+  // Check if we recently sent an ARP request for this IP (within 5 seconds; older requests have expired)
+  if ( recent_arp_requests_.contains( next_hop_ip ) ) {
     // Already sent ARP request recently, just wait
     return;
   }
@@ -73,6 +71,7 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
   
   // Record that we sent this ARP request
   recent_arp_requests_[next_hop_ip] = current_time_ms_;
+  timers_.schedule_in( ARP_REQUEST_TTL_ms, { true, next_hop_ip, current_time_ms_ } );
 }
 
 //! \param[in] frame the incoming Ethernet frame
@@ -96,6 +95,7 @@ void NetworkInterface::recv_frame( EthernetFrame frame )
     if ( parse( arp_msg, frame.payload ) && arp_msg.supported() ) {
       // Learn the mapping from sender's IP and Ethernet address
       arp_table_[arp_msg.sender_ip_address] = { arp_msg.sender_ethernet_address, current_time_ms_ };
+      timers_.schedule_in( ARP_ENTRY_TTL_ms, { false, arp_msg.sender_ip_address, current_time_ms_ } );
       
       // Send any pending datagrams for this IP
       auto pending = pending_datagrams_.find( arp_msg.sender_ip_address );
@@ -139,26 +139,25 @@ void NetworkInterface::recv_frame( EthernetFrame frame )
 void NetworkInterface::tick( const size_t ms_since_last_tick )
 {
   current_time_ms_ += ms_since_last_tick;
-  
-  // Expire ARP table entries older than 30 seconds (30,000 ms)
-  auto arp_it = arp_table_.begin();
-  while ( arp_it != arp_table_.end() ) {
-    if ( current_time_ms_ - arp_it->second.second >= 30000 ) {
-      arp_it = arp_table_.erase( arp_it );
-    } else {
-      ++arp_it;
+
+  // Expire ARP table entries older than 30 seconds and ARP requests older than 5 seconds
+  timers_.advance( ms_since_last_tick, [&]( ARPTimer&& timer ) { expire( timer ); } );
+}
+
+void NetworkInterface::expire( const ARPTimer& timer )
+{
+  if ( not timer.is_request ) {
+    auto entry = arp_table_.find( timer.ip_address );
+    if ( entry != arp_table_.end() and entry->second.second == timer.timestamp ) {
+      arp_table_.erase( entry );
     }
+    return;
   }
-  
-  // Clean up old ARP request timestamps and drop corresponding pending datagrams (older than 5 seconds)
-  auto arp_req_it = recent_arp_requests_.begin();
-  while ( arp_req_it != recent_arp_requests_.end() ) {
-    if ( current_time_ms_ - arp_req_it->second >= 5000 ) {
-      // Drop pending datagrams for this IP since the ARP request expired
-      pending_datagrams_.erase( arp_req_it->first );
-      arp_req_it = recent_arp_requests_.erase( arp_req_it );
-    } else {
-      ++arp_req_it;
-    }
+
+  auto request = recent_arp_requests_.find( timer.ip_address );
+  if ( request != recent_arp_requests_.end() and request->second == timer.timestamp ) {
+    // Drop pending datagrams for this IP since the ARP request expired
+    pending_datagrams_.erase( timer.ip_address );
+    recent_arp_requests_.erase( request );
   }
 }
@@ -3,6 +3,7 @@
 #include "address.hh"
 #include "ethernet_frame.hh"
 #include "ipv4_datagram.hh"
+#include "timer_wheel.hh"
 
 #include <map>
 #include <memory>
@@ -93,6 +94,21 @@ private:
   // Recent ARP requests: maps IP addresses to timestamp of last request
   std::map<uint32_t, size_t> recent_arp_requests_ {};
 
+  // How long a learned mapping is remembered, and how long to wait before re-sending an ARP request
+  static constexpr size_t ARP_ENTRY_TTL_ms = 30'000;
+  static constexpr size_t ARP_REQUEST_TTL_ms = 5'000;
+
+  // Expiry deadlines for the ARP table and recent requests. An entry is only expired if it still has
+  // the timestamp it had when the timer was scheduled (otherwise it has been refreshed since).
+  struct ARPTimer
+  {
+    bool is_request;
+    uint32_t ip_address;
+    size_t timestamp;
+  };
+  TimerWheel<ARPTimer> timers_ {};
+  void expire( const ARPTimer& timer );
+
   // Current time in milliseconds
   size_t current_time_ms_ { 0 };
 };
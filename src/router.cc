@@ -41,10 +41,8 @@ void Router::route()
         // TTL is 0 or would become 0, drop the datagram
         continue;
       }
-      datagram.header.ttl--;
-      
-      // Recompute checksum after TTL change
-      datagram.header.compute_checksum();
+      // Decrement TTL, adjusting the checksum incrementally instead of recomputing it
+      datagram.header.set_ttl( datagram.header.ttl - 1 );
       
       // Find the longest-prefix-match route
       const RouteEntry* best_route = nullptr;
@@ -0,0 +1,189 @@
+#include "sharded_tcp_stack.hh"
+#include "eventloop.hh"
+#include "exception.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+vector<FileDescriptor> one_interface( FileDescriptor&& fd )
+{
+  vector<FileDescriptor> ret;
+  ret.push_back( move( fd ) );
+  return ret;
+}
+
+// the workers exchange plain IPv4 datagrams, without the virtio-net header that TCP offload adds
+const TunFD& check_no_offload( const TunFD& tun )
+{
+  if ( tun.tcp_offload() ) {
+    throw runtime_error( "ShardedTCPStack cannot use a TUN device opened with tcp_offload" );
+  }
+  return tun;
+}
+
+vector<FileDescriptor> duplicate_all( const vector<TunFD>& queues )
+{
+  vector<FileDescriptor> ret;
+  ret.reserve( queues.size() );
+  for ( const auto& queue : queues ) {
+    ret.push_back( check_no_offload( queue ).duplicate() );
+  }
+  return ret;
+}
+} // namespace
+
+ShardedTCPStack::ShardedTCPStack( TunFD&& tun, const size_t workers )
+  : ShardedTCPStack( check_no_offload( tun ).duplicate(), move( tun ), workers )
+{}
+
+ShardedTCPStack::ShardedTCPStack( FileDescriptor&& ingress, FileDescriptor&& egress, const size_t workers )
+  : ShardedTCPStack( one_interface( move( ingress ) ),
+                     one_interface( move( egress ) ),
+                     workers,
+                     socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM ) )
+{}
+
+// (the stack keeps its own duplicates of the queues, so it does not matter when `queues` is destroyed)
+ShardedTCPStack::ShardedTCPStack( vector<TunFD>&& queues )
+  : ShardedTCPStack( duplicate_all( queues ),
+                     duplicate_all( queues ),
+                     queues.size(),
+                     socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM ) )
+{}
+
+//! \param[in] ingress are read by the ingress threads (one each) for incoming IPv4 datagrams
+//! \param[in] egress are written by the workers with outgoing IPv4 datagrams (worker `i` gets its own dup
+//! of `egress[i % egress.size()]`)
+//! \param[in] workers is the number of worker threads
+//! \param[in] stop_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
+ShardedTCPStack::ShardedTCPStack( vector<FileDescriptor>&& ingress,
+                                  vector<FileDescriptor>&& egress,
+                                  const size_t workers,
+                                  pair<LocalStreamSocket, LocalStreamSocket> stop_pair )
+  : ingress_( move( ingress ) )
+  , stop_sender_( move( stop_pair.first ) )
+  , stop_receiver_( move( stop_pair.second ) )
+{
+  if ( workers == 0 ) {
+    throw runtime_error( "ShardedTCPStack needs at least one worker" );
+  }
+
+  worker_ingress_.resize( ingress_.size() );
+  for ( size_t i = 0; i < workers; i++ ) {
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+
+    // a separate descriptor per ingress thread, so no FileDescriptor is shared between threads
+    const FileDescriptor worker_sender { fds[0] };
+    for ( auto& senders : worker_ingress_ ) {
+      senders.emplace_back( CheckSystemCall( "dup", ::dup( worker_sender.fd_num() ) ) );
+      senders.back().set_blocking( false ); // drop rather than stall the other workers
+    }
+
+    // and a separate descriptor per worker
+    const FileDescriptor& interface = egress.at( i % egress.size() );
+    FileDescriptor worker_egress { CheckSystemCall( "dup", ::dup( interface.fd_num() ) ) };
+    workers_.push_back( make_unique<TCPStack>( FileDescriptor { fds[1] }, move( worker_egress ) ) );
+  }
+
+  // the workers make their dups of the interfaces non-blocking, which also applies to the ingress
+  // descriptors that share them (an ingress thread only reads once the interface is readable)
+  for ( auto& interface : ingress_ ) {
+    interface.set_blocking( false );
+  }
+
+  stop_sender_.set_blocking( false );
+
+  for ( size_t i = 0; i < ingress_.size(); i++ ) {
+    ingress_threads_.emplace_back( &ShardedTCPStack::steer_loop, this, i );
+  }
+}
+
+ShardedTCPStack::~ShardedTCPStack()
+{
+  try {
+    stop_.store( true );
+    stop_sender_.write( string( ingress_threads_.size(), 'x' ) ); // one byte to wake each ingress thread
+    for ( auto& thread : ingress_threads_ ) {
+      thread.join();
+    }
+    workers_.clear();
+  } catch ( const exception& e ) {
+    cerr << "Exception destructing ShardedTCPStack: " << e.what() << "\n";
+  }
+}
+
+LocalStreamSocket ShardedTCPStack::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+{
+  const FourTuple flow { .local_address = c_ad.source.ipv4_numeric(),
+                         .local_port = c_ad.source.port(),
+                         .remote_address = c_ad.destination.ipv4_numeric(),
+                         .remote_port = c_ad.destination.port() };
+  return workers_.at( worker_for( flow ) )->connect( c_tcp, c_ad );
+}
+
+TCPListener ShardedTCPStack::listen( const TCPConfig& c_tcp, const Address& local, const size_t backlog )
+{
+  auto queue = make_shared<AcceptQueue>( backlog );
+  for ( auto& worker : workers_ ) {
+    worker->listen( c_tcp, local, queue );
+  }
+  return TCPListener { move( queue ) };
+}
+
+size_t ShardedTCPStack::connection_count() const
+{
+  size_t ret = 0;
+  for ( const auto& worker : workers_ ) {
+    ret += worker->connection_count();
+  }
+  return ret;
+}
+
+void ShardedTCPStack::steer_loop( const size_t ingress_index )
+{
+  try {
+    EventLoop eventloop { EventLoop::Backend::Epoll };
+    FileDescriptor& ingress = ingress_.at( ingress_index );
+    vector<FileDescriptor>& senders = worker_ingress_.at( ingress_index );
+    FileDescriptor stop_receiver { CheckSystemCall( "dup", ::dup( stop_receiver_.fd_num() ) ) };
+    stop_receiver.set_blocking( false );
+
+    // reused by each read, which keeps its capacity rather than taking a buffer from the pool every time
+    string dgram;
+    eventloop.add_rule( "steer datagram to worker", ingress, Direction::In, [&] {
+      dgram.clear();
+      ingress.read( dgram );
+      if ( dgram.empty() ) {
+        return;
+      }
+
+      // datagrams that are not TCP go to worker 0, which drops them
+      const auto flow = peek_tcp_in_ip_flow( dgram );
+      senders.at( flow.has_value() ? worker_for( flow.value() ) : 0 ).write( dgram );
+    } );
+
+    eventloop.add_rule( "stop ingress thread", stop_receiver, Direction::In, [&] {
+      string buffer( 1, 0 ); // leave the other ingress threads their bytes
+      stop_receiver.read( buffer );
+    } );
+
+    while ( not stop_ ) {
+      if ( eventloop.wait_next_event( -1 ) == EventLoop::Result::Exit ) {
+        break;
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception in ShardedTCPStack ingress thread: " << e.what() << "\n";
+    throw;
+  }
+}
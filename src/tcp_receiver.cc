@@ -9,6 +9,11 @@ void TCPReceiver::receive( TCPSenderMessage message )
     reassembler_.reader().set_error();
     return;
   }
+  // PAWS (RFC 7323): a segment carrying a timestamp older than TS.Recent is an old duplicate
+  if ( message.timestamp.has_value() and ts_recent_.has_value()
+       and static_cast<int32_t>( *message.timestamp - *ts_recent_ ) < 0 ) {
+    return;
+  }
   if ( !is_syn_received_ ) {
     if ( !message.SYN )
       return;
@@ -16,6 +21,10 @@ void TCPReceiver::receive( TCPSenderMessage message )
     is_syn_received_ = true;
   }
   uint64_t first_index = message.seqno.unwrap( isn_, reassembler_.writer().bytes_pushed() ) - 1 + message.SYN;
+  // Only segments starting at or before the ackno update TS.Recent, so the echo reflects in-order data
+  if ( message.timestamp.has_value() and first_index <= reassembler_.writer().bytes_pushed() ) {
+    ts_recent_ = message.timestamp;
+  }
   reassembler_.insert( first_index, message.payload, message.FIN );
 }
 
@@ -27,5 +36,6 @@ TCPReceiverMessage TCPReceiver::send() const
   if ( is_syn_received_ ) {
     ackno = Wrap32( isn_ + writer.bytes_pushed() + 1 + writer.is_closed() );
   }
-  return TCPReceiverMessage { .ackno = ackno, .window_size = window_size, .RST = writer.has_error() };
+  return TCPReceiverMessage {
+    .ackno = ackno, .window_size = window_size, .RST = writer.has_error(), .timestamp_echo = ts_recent_ };
 }
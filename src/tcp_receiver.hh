@@ -29,4 +29,5 @@ private:
   Reassembler reassembler_;
   Wrap32 isn_ { 0 };
   bool is_syn_received_ { false };
+  std::optional<uint32_t> ts_recent_ {}; // most recent timestamp from the peer (RFC 7323 TS.Recent)
 };
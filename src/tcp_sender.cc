@@ -24,6 +24,14 @@ uint64_t TCPSender::consecutive_retransmissions() const
   return max_retransmissions_count;
 }
 
+optional<uint64_t> TCPSender::ms_until_retransmission() const
+{
+  if ( outstanding_segments_.empty() ) {
+    return {};
+  }
+  return RTO_ms_ - min( last_tick_ms_, RTO_ms_ );
+}
+
 void TCPSender::push( const TransmitFunction& transmit )
 {
   // Calculate available window capacity
@@ -64,10 +72,11 @@ void TCPSender::push( const TransmitFunction& transmit )
     // Reset timer for first segment in flight
     if ( outstanding_segments_.empty() ) {
       last_tick_ms_ = 0;
-      RTO_ms_ = initial_RTO_ms_;
+      RTO_ms_ = base_RTO_ms_;
     }
 
     // Transmit the segment
+    stamp( message );
     transmit( message );
 
     // Store segment for retransmission tracking
@@ -87,7 +96,31 @@ void TCPSender::push( const TransmitFunction& transmit )
 
 TCPSenderMessage TCPSender::make_empty_message() const
 {
-  return TCPSenderMessage { .seqno = next_seqno_, .RST = input_.has_error() };
+  TCPSenderMessage message { .seqno = next_seqno_, .RST = input_.has_error() };
+  stamp( message );
+  return message;
+}
+
+void TCPSender::stamp( TCPSenderMessage& message ) const
+{
+  // The option is offered on the SYN, and used on the rest of the connection only once the peer echoes it
+  if ( timestamps_ and ( message.SYN or peer_echoes_timestamps_ ) ) {
+    message.timestamp = static_cast<uint32_t>( current_time_ms_ );
+  }
+}
+
+// RFC 6298, with the RTO clamped below by TCPConfig::TIMEOUT_MIN
+void TCPSender::sample_rtt( uint64_t rtt_ms )
+{
+  if ( not srtt_ms_.has_value() ) {
+    srtt_ms_ = rtt_ms;
+    rttvar_ms_ = rtt_ms / 2;
+  } else {
+    const uint64_t deviation = *srtt_ms_ > rtt_ms ? *srtt_ms_ - rtt_ms : rtt_ms - *srtt_ms_;
+    rttvar_ms_ = ( 3 * rttvar_ms_ + deviation ) / 4;
+    srtt_ms_ = ( 7 * *srtt_ms_ + rtt_ms ) / 8;
+  }
+  base_RTO_ms_ = max<uint64_t>( *srtt_ms_ + max<uint64_t>( 1, 4 * rttvar_ms_ ), TCPConfig::TIMEOUT_MIN );
 }
 
 void TCPSender::receive( const TCPReceiverMessage& msg )
@@ -105,6 +138,10 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
 
   last_ackno_ = *msg.ackno;
 
+  if ( timestamps_ and msg.timestamp_echo.has_value() ) {
+    peer_echoes_timestamps_ = true;
+  }
+
   uint64_t abs_ackno = msg.ackno->unwrap( isn_, writer().bytes_pushed() );
   uint64_t next_seqno = next_seqno_.unwrap( isn_, writer().bytes_pushed() );
 
@@ -114,6 +151,7 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
   }
 
   // Remove acknowledged segments
+  bool acked_new_data = false;
   auto it = outstanding_segments_.begin();
   while ( it != outstanding_segments_.end() ) {
     uint64_t seg_start = it->first;
@@ -121,17 +159,27 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
 
     if ( seg_end <= abs_ackno ) {
       it = outstanding_segments_.erase( it );
-      last_tick_ms_ = 0;
-      RTO_ms_ = initial_RTO_ms_;
+      acked_new_data = true;
     } else {
       break;
     }
   }
+
+  if ( acked_new_data ) {
+    // The echoed TSval identifies the transmission being acknowledged, so even acknowledgments of
+    // retransmitted segments give a valid sample (no need for Karn's algorithm)
+    if ( peer_echoes_timestamps_ and msg.timestamp_echo.has_value() ) {
+      sample_rtt( static_cast<uint32_t>( current_time_ms_ - *msg.timestamp_echo ) );
+    }
+    last_tick_ms_ = 0;
+    RTO_ms_ = base_RTO_ms_;
+  }
 }
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
   last_tick_ms_ += ms_since_last_tick;
+  current_time_ms_ += ms_since_last_tick;
 
   if ( outstanding_segments_.empty() ) {
     return;
@@ -141,6 +189,8 @@ void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& trans
   auto& oldest = it->second;
 
   if ( last_tick_ms_ >= RTO_ms_ ) {
+    oldest.message.timestamp.reset();
+    stamp( oldest.message );
     transmit( oldest.message );
     last_tick_ms_ = 0;
     oldest.retransmissions_count++;
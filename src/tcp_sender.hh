@@ -6,13 +6,15 @@
 
 #include <functional>
 #include <map>
+#include <optional>
 
 class TCPSender
 {
 public:
   /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
-  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
-    : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms )
+  /* If `timestamps` is set, the sender offers the RFC 7323 timestamps option and uses the echoes for RTT */
+  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms, bool timestamps = false )
+    : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ), timestamps_( timestamps )
   {}
 
   /* Generate an empty TCPSenderMessage */
@@ -33,6 +35,9 @@ public:
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // For testing: how many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // For testing: how many consecutive retransmissions have happened?
+  uint64_t current_RTO_ms() const { return base_RTO_ms_; } // RTO before backoff (from RTT samples, if any)
+  std::optional<uint64_t> smoothed_RTT_ms() const { return srtt_ms_; }
+  std::optional<uint64_t> ms_until_retransmission() const; // Time until tick() would retransmit (if outstanding)
   const Writer& writer() const { return input_.writer(); }
   const Reader& reader() const { return input_.reader(); }
   Writer& writer() { return input_.writer(); }
@@ -40,9 +45,16 @@ public:
 private:
   Reader& reader() { return input_.reader(); }
 
+  // Set the TSval on an outgoing message (if timestamps are in use)
+  void stamp( TCPSenderMessage& message ) const;
+
+  // Update the RFC 6298 estimator with a round-trip time sample
+  void sample_rtt( uint64_t rtt_ms );
+
   ByteStream input_;
   Wrap32 isn_;
   uint64_t initial_RTO_ms_;
+  uint64_t base_RTO_ms_ { initial_RTO_ms_ };
   uint64_t RTO_ms_ { initial_RTO_ms_ };
   uint64_t last_tick_ms_ { 0 };
   uint64_t window_size_ { 1 };
@@ -51,6 +63,12 @@ private:
   bool is_syn_sent_ { false };
   bool is_fin_sent_ { false };
 
+  bool timestamps_;                    // offer the timestamps option?
+  bool peer_echoes_timestamps_ {};     // has the peer echoed one of our timestamps (option in use)?
+  uint64_t current_time_ms_ { 0 };     // clock for TSval: total time passed in tick()
+  std::optional<uint64_t> srtt_ms_ {}; // smoothed round-trip time
+  uint64_t rttvar_ms_ {};              // round-trip time variation
+
   struct TCPSegment
   {
     TCPSenderMessage message {};
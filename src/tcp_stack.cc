@@ -0,0 +1,358 @@
+#include "tcp_stack.hh"
+#include "helpers.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+
+using namespace std;
+
+TCPStack::TCPStack( TunFD&& tun ) : TCPStack( tun.duplicate(), move( tun ) ) {}
+
+TCPStack::TCPStack( FileDescriptor&& ingress, FileDescriptor&& egress )
+  : TCPStack( move( ingress ), move( egress ), socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM ) )
+{}
+
+//! \param[in] ingress is read for incoming IPv4 datagrams
+//! \param[in] egress is written with outgoing IPv4 datagrams
+//! \param[in] wake_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
+TCPStack::TCPStack( FileDescriptor&& ingress,
+                    FileDescriptor&& egress,
+                    pair<LocalStreamSocket, LocalStreamSocket> wake_pair )
+  : ingress_( move( ingress ) )
+  , egress_( move( egress ) )
+  , wake_sender_( move( wake_pair.first ) )
+  , wake_receiver_( move( wake_pair.second ) )
+{
+  wake_sender_.set_blocking( false );
+  wake_receiver_.set_blocking( false );
+
+  // like a NIC with a full transmit queue, drop outgoing datagrams rather than stall every connection
+  egress_.set_blocking( false );
+
+  // rule 1: read from the interface and hand each segment to its connection
+  eventloop_.add_rule(
+    "receive TCP segment from the network", ingress_, Direction::In, [&] { receive_datagram(); } );
+
+  // rule 2: pick up connections requested by the application thread
+  eventloop_.add_rule( "accept new connections from application", wake_receiver_, Direction::In, [&] {
+    string buffer;
+    wake_receiver_.read( buffer );
+    accept_pending();
+  } );
+
+  // the per-connection rules share these categories (an EventLoop has a limited number of them)
+  push_category_ = eventloop_.add_category( "push bytes to TCPPeer" );
+  pull_category_ = eventloop_.add_category( "read bytes from inbound stream" );
+
+  thread_ = thread( &TCPStack::main_loop, this );
+}
+
+TCPStack::~TCPStack()
+{
+  try {
+    stop_.store( true );
+    wake_sender_.write( "x" );
+    thread_.join();
+  } catch ( const exception& e ) {
+    cerr << "Exception destructing TCPStack: " << e.what() << "\n";
+  }
+}
+
+//! \param[in] c_tcp is the TCPConfig for the new connection
+//! \param[in] c_ad gives the local (source) and remote (destination) addresses of the new connection
+LocalStreamSocket TCPStack::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+{
+  auto [app_side, stack_side] = socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM );
+
+  const FourTuple flow { .local_address = c_ad.source.ipv4_numeric(),
+                         .local_port = c_ad.source.port(),
+                         .remote_address = c_ad.destination.ipv4_numeric(),
+                         .remote_port = c_ad.destination.port() };
+
+  post( [&] { pending_.push_back( { c_tcp, flow, move( stack_side ) } ); } );
+
+  return move( app_side );
+}
+
+//! \param[in] c_tcp is the TCPConfig for connections accepted by the listener (each gets a random ISN)
+//! \param[in] local is the address and port to listen on
+//! \param[in] backlog is the maximum number of connections that are half-open or waiting for accept()
+TCPListener TCPStack::listen( const TCPConfig& c_tcp, const Address& local, const size_t backlog )
+{
+  auto queue = make_shared<AcceptQueue>( backlog );
+  listen( c_tcp, local, queue );
+  return TCPListener { move( queue ) };
+}
+
+void TCPStack::listen( const TCPConfig& c_tcp, const Address& local, shared_ptr<AcceptQueue> queue )
+{
+  Listener listener { .address = local.ipv4_numeric(), .config = c_tcp, .queue = move( queue ) };
+  const uint16_t port = local.port();
+  post( [&] { pending_listeners_.emplace_back( port, move( listener ) ); } );
+}
+
+void TCPStack::post( const function<void()>& add_to_pending )
+{
+  bool was_empty = false;
+  {
+    const lock_guard lock { pending_mutex_ };
+    was_empty = pending_.empty() and pending_listeners_.empty();
+    add_to_pending();
+  }
+
+  // one wake-up byte per batch of pending work keeps the wake socket from ever filling up
+  if ( was_empty ) {
+    wake_sender_.write( "x" );
+  }
+}
+
+void TCPStack::transmit( const FourTuple& flow, const TCPMessage& msg )
+{
+  egress_.write( serialize_tcp_in_ip( msg, flow ) ); // returns 0 (dropped) if the interface is busy
+}
+
+void TCPStack::receive_datagram()
+{
+  vector<string> strs( 3 );
+  strs[0].resize( IPv4Header::LENGTH );
+  strs[1].resize( TCPSegment::HEADER_LENGTH );
+  ingress_.read( strs );
+
+  InternetDatagram ip_dgram;
+  if ( not parse( ip_dgram, move( strs ) ) ) {
+    return;
+  }
+
+  FourTuple flow;
+  auto msg = parse_tcp_in_ip( move( ip_dgram ), flow );
+  if ( not msg.has_value() ) {
+    return;
+  }
+
+  const auto it = connections_.find( flow );
+  if ( it == connections_.end() ) {
+    open_passive( flow, move( msg.value() ) );
+    return;
+  }
+
+  Connection& conn = *it->second;
+  conn.peer.receive( move( msg.value() ), [&]( const TCPMessage& x ) { transmit( conn.flow, x ); } );
+  deliver_if_established( conn );
+
+  // the segment may have brought inbound bytes, or acknowledged outbound ones and so made room
+  for ( auto& rule : conn.rules ) {
+    rule.interest_changed();
+  }
+}
+
+void TCPStack::open_passive( const FourTuple& flow, TCPMessage&& syn )
+{
+  if ( not syn.sender->SYN or syn.sender->RST or syn.receiver->ackno.has_value() ) {
+    return;
+  }
+
+  const auto it = listeners_.find( flow.local_port );
+  if ( it == listeners_.end() ) {
+    return;
+  }
+
+  const Listener& listener = it->second;
+  if ( listener.queue->closed() ) {
+    listeners_.erase( it );
+    return;
+  }
+
+  if ( listener.address != 0 and listener.address != flow.local_address ) {
+    return;
+  }
+
+  if ( not listener.queue->reserve() ) {
+    return; // backlog is full; the peer will retransmit its SYN
+  }
+
+  TCPConfig config = listener.config;
+  config.isn = Wrap32 { static_cast<uint32_t>( rng_() ) };
+
+  auto [app_side, stack_side] = socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM );
+  Connection& conn = add_connection( config, flow, move( stack_side ) );
+  conn.listener = listener.queue;
+  conn.app_side.emplace( move( app_side ) );
+  conn.peer.receive( move( syn ), [&]( const TCPMessage& x ) { transmit( conn.flow, x ); } );
+}
+
+void TCPStack::deliver_if_established( Connection& conn )
+{
+  if ( conn.listener and conn.peer.has_ackno() and conn.peer.sender().sequence_numbers_in_flight() == 0 ) {
+    conn.listener->push( move( conn.app_side.value() ) );
+    conn.listener.reset();
+    conn.app_side.reset();
+  }
+}
+
+void TCPStack::accept_pending()
+{
+  vector<PendingConnect> pending;
+  vector<pair<uint16_t, Listener>> pending_listeners;
+  {
+    const lock_guard lock { pending_mutex_ };
+    swap( pending, pending_ );
+    swap( pending_listeners, pending_listeners_ );
+  }
+
+  for ( auto& [port, listener] : pending_listeners ) {
+    const auto [it, inserted] = listeners_.try_emplace( port, listener );
+    if ( not inserted ) {
+      if ( not it->second.queue->closed() ) {
+        cerr << "DEBUG: minnow stack already has a listener on port " << port << "; refusing.\n";
+        listener.queue->close();
+        continue;
+      }
+      it->second = move( listener );
+    }
+  }
+
+  for ( auto& request : pending ) {
+    if ( connections_.contains( request.flow ) ) {
+      cerr << "DEBUG: minnow stack already has a connection on that four-tuple; refusing.\n";
+      continue; // destroying the socket closes the application's end
+    }
+    Connection& conn = add_connection( request.config, request.flow, move( request.data ) );
+    conn.peer.push( [&]( const TCPMessage& x ) { transmit( conn.flow, x ); } );
+  }
+}
+
+TCPStack::Connection& TCPStack::add_connection( const TCPConfig& config,
+                                                const FourTuple& flow,
+                                                LocalStreamSocket&& data )
+{
+  auto conn_ptr
+    = make_unique<Connection>( Connection { .flow = flow, .peer = TCPPeer { config }, .data = move( data ) } );
+  Connection& conn = *connections_.emplace( flow, move( conn_ptr ) ).first->second;
+  connection_count_.store( connections_.size() );
+
+  conn.data.set_blocking( false );
+  auto send = [this, &conn]( const TCPMessage& x ) { transmit( conn.flow, x ); };
+
+  // per-connection rule 1: read from the application into the outbound stream
+  conn.rules.push_back( eventloop_.add_rule(
+    push_category_,
+    conn.data,
+    Direction::In,
+    [&conn, send] {
+      string buffer;
+      buffer.resize( conn.peer.outbound_writer().available_capacity() );
+      conn.data.read( buffer );
+      conn.peer.outbound_writer().push( move( buffer ) );
+
+      if ( conn.data.eof() ) {
+        conn.peer.outbound_writer().close();
+        conn.outbound_shutdown = true;
+      }
+
+      conn.peer.push( send );
+    },
+    [&conn] {
+      return conn.peer.active() and ( not conn.outbound_shutdown )
+             and ( conn.peer.outbound_writer().available_capacity() > 0 );
+    },
+    [&conn, send] {
+      conn.peer.outbound_writer().close();
+      conn.outbound_shutdown = true;
+      conn.peer.push( send );
+    },
+    [&conn] { conn.peer.outbound_writer().set_error(); } ) );
+
+  // per-connection rule 2: write from the inbound stream to the application
+  conn.rules.push_back( eventloop_.add_rule(
+    pull_category_,
+    conn.data,
+    Direction::Out,
+    [&conn] {
+      Reader& inbound = conn.peer.inbound_reader();
+      if ( inbound.bytes_buffered() ) {
+        inbound.pop( conn.data.write( inbound.peek() ) );
+      }
+
+      if ( inbound.is_finished() or inbound.has_error() ) {
+        conn.data.shutdown( SHUT_WR );
+        conn.inbound_shutdown = true;
+      }
+    },
+    [&conn] {
+      const Reader& inbound = conn.peer.inbound_reader();
+      return inbound.bytes_buffered()
+             or ( ( inbound.is_finished() or inbound.has_error() ) and not conn.inbound_shutdown );
+    },
+    [] {},
+    [&conn] { conn.peer.inbound_reader().set_error(); } ) );
+
+  return conn;
+}
+
+void TCPStack::tick_connections( const uint64_t ms_since_last_tick )
+{
+  for ( auto it = connections_.begin(); it != connections_.end(); ) {
+    Connection& conn = *it->second;
+    if ( conn.peer.active() ) {
+      conn.peer.tick( ms_since_last_tick, [&]( const TCPMessage& x ) { transmit( conn.flow, x ); } );
+    }
+
+    if ( conn.peer.active() ) {
+      ++it;
+      continue;
+    }
+
+    // the connection has finished: stop serving it and let the application see EOF
+    if ( conn.listener ) {
+      conn.listener->release();
+    }
+    for ( auto& rule : conn.rules ) {
+      rule.cancel();
+    }
+    conn.data.shutdown( SHUT_RDWR );
+    it = connections_.erase( it );
+  }
+  connection_count_.store( connections_.size() );
+}
+
+void TCPStack::main_loop()
+{
+  try {
+    auto base_time = timestamp_ms();
+    while ( not stop_ ) {
+      if ( eventloop_.wait_next_event( TCP_TICK_MS ) == EventLoop::Result::Exit ) {
+        break;
+      }
+
+      // ticking every connection is O(connections), so do it at most once per tick interval
+      const auto next_time = timestamp_ms();
+      if ( next_time - base_time >= TCP_TICK_MS ) {
+        tick_connections( next_time - base_time );
+        base_time = next_time;
+      }
+    }
+    {
+      const lock_guard lock { pending_mutex_ };
+      for ( auto& [port, listener] : pending_listeners_ ) {
+        listener.queue->close();
+      }
+    }
+    for ( auto& [port, listener] : listeners_ ) {
+      listener.queue->close();
+    }
+    for ( auto& [port, conn] : connections_ ) {
+      if ( conn->listener ) {
+        conn->listener->release();
+      }
+    }
+    connections_.clear();
+    connection_count_.store( 0 );
+  } catch ( const exception& e ) {
+    cerr << "Exception in TCPStack thread: " << e.what() << "\n";
+    throw;
+  }
+}
@@ -0,0 +1,150 @@
+#include "buffer_pool.hh"
+#include "ref.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// BufferPool hands out strings of the small and large capacities, takes them back when an owning
+// Ref<string> is destroyed (or through recycle()), refuses strings of other capacities, keeps at most
+// MAX_*_BUFFERS of each, and counts the buffers it had to allocate. Each test runs in a thread of its own,
+// so it starts with empty pools.
+
+namespace {
+
+// Run `test` in a new thread, and rethrow whatever it threw
+template<typename Test>
+void in_new_thread( const Test& test )
+{
+  string error;
+  thread { [&] {
+    try {
+      test();
+    } catch ( const exception& e ) {
+      error = e.what();
+    }
+  } }.join();
+  if ( not error.empty() ) {
+    throw runtime_error( error );
+  }
+}
+
+// A string with a capacity of at least `capacity` bytes, not from the pools
+string with_capacity( const size_t capacity )
+{
+  string ret;
+  ret.reserve( capacity );
+  return ret;
+}
+
+void test_capacities()
+{
+  const string small = BufferPool::small();
+  const string large = BufferPool::large();
+  test_should_be( small.empty(), true );
+  test_should_be( large.empty(), true );
+  test_should_be( small.capacity() >= BufferPool::SMALL_CAPACITY, true );
+  test_should_be( large.capacity() >= BufferPool::LARGE_CAPACITY, true );
+
+  // the pools were empty, so both were allocated
+  test_should_be( BufferPool::misses(), uint64_t { 2 } );
+}
+
+void test_recycling()
+{
+  for ( const bool large : { false, true } ) {
+    const auto take = [&] { return large ? BufferPool::large() : BufferPool::small(); };
+
+    string buffer = take();
+    buffer.assign( "some contents" );
+    const char* const chars = buffer.data();
+    {
+      const Ref<string> owner { move( buffer ) };
+    }
+
+    // the owning Ref gave the string back, emptied, and the next taken is that one
+    const uint64_t misses = BufferPool::misses();
+    const string again = take();
+    test_should_be( again.data() == chars, true );
+    test_should_be( again.empty(), true );
+    test_should_be( BufferPool::misses(), misses );
+  }
+}
+
+void test_rejection()
+{
+  // too small for either pool, between them, and so large that it would waste memory while pooled
+  for ( const size_t capacity : { BufferPool::SMALL_CAPACITY / 2,
+                                  BufferPool::SMALL_CAPACITY * 4,
+                                  BufferPool::LARGE_CAPACITY * 4 } ) {
+    BufferPool::recycle( with_capacity( capacity ) );
+
+    // so both pools are still empty
+    const uint64_t misses = BufferPool::misses();
+    const string small = BufferPool::small();
+    const string large = BufferPool::large();
+    test_should_be( BufferPool::misses(), misses + 2 );
+  }
+
+  // a string that was not taken from a pool is kept if its capacity fits one
+  string buffer = with_capacity( BufferPool::LARGE_CAPACITY + 100 );
+  const char* const chars = buffer.data();
+  BufferPool::recycle( move( buffer ) );
+  const uint64_t misses = BufferPool::misses();
+  test_should_be( BufferPool::large().data() == chars, true );
+  test_should_be( BufferPool::misses(), misses );
+}
+
+void test_caps()
+{
+  constexpr size_t EXTRA = 5;
+  for ( const bool large : { false, true } ) {
+    const auto take = [&] { return large ? BufferPool::large() : BufferPool::small(); };
+    const size_t max_buffers = large ? BufferPool::MAX_LARGE_BUFFERS : BufferPool::MAX_SMALL_BUFFERS;
+
+    // take more buffers than the pool keeps, all of them allocated, and give them all back
+    uint64_t misses = BufferPool::misses();
+    vector<string> buffers;
+    for ( size_t i = 0; i < max_buffers + EXTRA; i++ ) {
+      buffers.push_back( take() );
+    }
+    test_should_be( BufferPool::misses(), misses + max_buffers + EXTRA );
+    for ( auto& buffer : buffers ) {
+      BufferPool::recycle( move( buffer ) );
+    }
+    buffers.clear();
+
+    // only the first max_buffers were kept
+    misses = BufferPool::misses();
+    for ( size_t i = 0; i < max_buffers + EXTRA; i++ ) {
+      buffers.push_back( take() );
+    }
+    test_should_be( BufferPool::misses(), misses + EXTRA );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    in_new_thread( test_capacities );
+    in_new_thread( test_recycling );
+    in_new_thread( test_rejection );
+    in_new_thread( test_caps );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#include "helpers.hh"
+#include "ipv4_datagram.hh"
+#include "ipv4_header.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A TCPOverIPv4Adapter verifies the TCP checksums of the datagrams it receives unless told to trust them,
+// computes those of the segments it sends, and counts each. An adapter without a device to complete a
+// partial checksum refuses ChecksumOffload::partial_transmit.
+
+namespace {
+
+const FourTuple PEER_FLOW { .local_address = Address { "10.144.0.2" }.ipv4_numeric(),
+                            .local_port = 1024,
+                            .remote_address = Address { "10.144.0.1" }.ipv4_numeric(),
+                            .remote_port = 80 };
+
+TCPMessage test_message()
+{
+  TCPMessage msg;
+  msg.sender->seqno = Wrap32 { 1000 };
+  msg.sender->payload = "hello, checksums";
+  msg.receiver->ackno = Wrap32 { 2000 };
+  msg.receiver->window_size = 1000;
+  return msg;
+}
+
+// A datagram from the peer, with its TCP checksum corrupted if `corrupt`
+InternetDatagram from_peer( const bool corrupt )
+{
+  string wire = concat( serialize_tcp_in_ip( test_message(), PEER_FLOW ) );
+  if ( corrupt ) {
+    wire.at( IPv4Header::LENGTH + TCPSegment::CHECKSUM_OFFSET ) ^= 0x5a;
+  }
+  InternetDatagram dgram;
+  if ( not parse( dgram, vector<string> { wire } ) ) {
+    throw runtime_error( "the test datagram does not parse" );
+  }
+  return dgram;
+}
+
+void test_counters( const TCPOverIPv4Adapter& adapter,
+                    const uint64_t verified,
+                    const uint64_t skipped,
+                    const uint64_t computed,
+                    const uint64_t deferred )
+{
+  const ChecksumCounters& counters = adapter.checksum_counters();
+  test_should_be( counters.verified, verified );
+  test_should_be( counters.skipped, skipped );
+  test_should_be( counters.computed, computed );
+  test_should_be( counters.deferred, deferred );
+}
+
+void test_receive()
+{
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().source = Address { "10.144.0.1", 80 };
+  adapter.config_mut().destination = Address { "10.144.0.2", 1024 };
+
+  // by default, checksums are verified, and a corrupted one is rejected
+  test_should_be( adapter.unwrap_tcp_in_ip( from_peer( false ) ).has_value(), true );
+  test_should_be( adapter.unwrap_tcp_in_ip( from_peer( true ) ).has_value(), false );
+  test_counters( adapter, 2, 0, 0, 0 );
+
+  // ... unless the device vouches for it
+  test_should_be( adapter.unwrap_tcp_in_ip( from_peer( true ), true ).has_value(), true );
+  test_counters( adapter, 2, 1, 0, 0 );
+
+  // with skip_verify, the link is trusted
+  adapter.set_checksum_offload( { .skip_verify = true } );
+  const auto msg = adapter.unwrap_tcp_in_ip( from_peer( true ) );
+  test_should_be( msg.has_value(), true );
+  test_should_be( msg->sender->payload == test_message().sender->payload, true );
+  test_counters( adapter, 2, 2, 0, 0 );
+}
+
+void test_transmit()
+{
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().source = Address { "10.144.0.2", 1024 };
+  adapter.config_mut().destination = Address { "10.144.0.1", 80 };
+
+  // a complete checksum, which the receiver verifies
+  for ( const bool serialized : { true, false } ) {
+    InternetDatagram dgram;
+    if ( serialized ) {
+      if ( not parse( dgram, adapter.serialize_tcp_in_ip( test_message() ) ) ) {
+        throw runtime_error( "a serialized segment does not parse" );
+      }
+    } else {
+      dgram = adapter.wrap_tcp_in_ip( test_message() );
+    }
+    FourTuple flow;
+    test_should_be( parse_tcp_in_ip( move( dgram ), flow ).has_value(), true );
+  }
+  test_counters( adapter, 0, 0, 2, 0 );
+
+  // a partial one, for a device to complete, which does not verify as it is
+  InternetDatagram partial;
+  if ( not parse( partial, adapter.serialize_tcp_in_ip( test_message(), true ) ) ) {
+    throw runtime_error( "a serialized segment does not parse" );
+  }
+  test_counters( adapter, 0, 0, 2, 1 );
+  InternetDatagram trusted = partial;
+  FourTuple flow;
+  test_should_be( parse_tcp_in_ip( move( partial ), flow ).has_value(), false );
+  test_should_be( parse_tcp_in_ip( move( trusted ), flow, false ).has_value(), true );
+
+  // with no device to complete partial checksums, partial_transmit is refused, and sent segments stay complete
+  bool refused = false;
+  try {
+    adapter.set_checksum_offload( { .partial_transmit = true } );
+  } catch ( const invalid_argument& ) {
+    refused = true;
+  }
+  test_should_be( refused, true );
+  test_should_be( adapter.checksum_offload().partial_transmit, false );
+  InternetDatagram dgram;
+  if ( not parse( dgram, adapter.serialize_tcp_in_ip( test_message() ) ) ) {
+    throw runtime_error( "a serialized segment does not parse" );
+  }
+  test_should_be( parse_tcp_in_ip( move( dgram ), flow ).has_value(), true );
+  test_counters( adapter, 0, 0, 3, 1 );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_receive();
+    test_transmit();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+#include "checksum.hh"
+#include "ipv4_header.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// The internet checksum computed a byte at a time, as RFC 1071 describes it
+uint16_t reference_checksum( const uint32_t initial, const string_view data )
+{
+  uint64_t sum = initial;
+  for ( size_t i = 0; i < data.size(); ++i ) {
+    const auto byte = static_cast<uint8_t>( data[i] );
+    sum += i % 2 ? byte : uint32_t( byte ) << 8;
+  }
+  while ( sum > 0xffff ) {
+    sum = ( sum & 0xffff ) + ( sum >> 16 );
+  }
+  return static_cast<uint16_t>( ~sum );
+}
+
+string random_bytes( default_random_engine& rd, const size_t length )
+{
+  uniform_int_distribution<int> ud { 0, 255 };
+  string ret( length, 0 );
+  for ( auto& c : ret ) {
+    c = static_cast<char>( ud( rd ) );
+  }
+  return ret;
+}
+
+// Check the checksum of data fed in random chunks, at random alignments, against the bytewise version
+void correctness_test( const size_t num_trials, const size_t random_seed )
+{
+  default_random_engine rd { random_seed };
+  uniform_int_distribution<size_t> length_dist { 0, 3000 };
+  uniform_int_distribution<size_t> offset_dist { 0, 31 };
+  uniform_int_distribution<uint32_t> initial_dist { 0, 0x3ffff };
+
+  for ( size_t trial = 0; trial < num_trials; ++trial ) {
+    // start the data at an arbitrary offset into the buffer, to exercise unaligned loads
+    const size_t offset = offset_dist( rd );
+    const string buffer = random_bytes( rd, offset + length_dist( rd ) );
+    const string_view data = string_view { buffer }.substr( offset );
+    const uint32_t initial = initial_dist( rd );
+
+    InternetChecksum checksum { initial };
+    uniform_int_distribution<size_t> chunk_dist { 0, trial % 4 == 0 ? 4UL : 101UL };
+    vector<string_view> chunks;
+    for ( size_t i = 0; i < data.size(); ) {
+      const string_view chunk = data.substr( i, chunk_dist( rd ) );
+      chunks.push_back( chunk );
+      i += chunk.size();
+    }
+    checksum.add( chunks );
+
+    const uint16_t expected = reference_checksum( initial, data );
+    if ( checksum.value() != expected ) {
+      throw runtime_error( "InternetChecksum of " + to_string( data.size() ) + " bytes in "
+                           + to_string( chunks.size() ) + " chunks was " + to_string( checksum.value() )
+                           + ", expected " + to_string( expected ) );
+    }
+  }
+
+  cout << "InternetChecksum matched the bytewise checksum over " << num_trials << " random chunkings.\n";
+}
+
+// Measure how fast InternetChecksum sums packets of the given size
+double speed_test( fstream& debug_output,
+                   const size_t packet_size, // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t total_bytes,
+                   const size_t random_seed )
+{
+  default_random_engine rd { random_seed };
+  const string packet = random_bytes( rd, packet_size );
+  const size_t num_packets = total_bytes / packet_size;
+
+  uint16_t combined = 0; // keeps the loop from being optimized away
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_packets; ++i ) {
+    InternetChecksum checksum { static_cast<uint32_t>( i ) };
+    checksum.add( packet );
+    combined ^= checksum.value();
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( InternetChecksum checksum; checksum.add( packet ), checksum.value() != reference_checksum( 0, packet ) ) {
+    throw runtime_error( "InternetChecksum did not match the bytewise checksum" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const double gigabits_per_second
+    = 8 * static_cast<double>( num_packets * packet_size ) / test_duration.count() / 1e9;
+
+  cout << "InternetChecksum of " << packet_size << "-byte packets reached " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s (" << combined << ").\n";
+  debug_output << "        InternetChecksum throughput (" << setw( 5 ) << packet_size << " bytes): " << fixed
+               << setprecision( 2 ) << setw( 8 ) << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 10 ) {
+    throw runtime_error( "InternetChecksum did not meet minimum speed of 10 Gbit/s" );
+  }
+
+  return gigabits_per_second;
+}
+
+// Rewrite random TCP segments' addresses, ports and sequence numbers as a NAT would, and check that the
+// incrementally updated checksum agrees with recomputing it
+void tcp_update_test( default_random_engine& rd, const size_t num_segments )
+{
+  uniform_int_distribution<uint32_t> address_dist;
+  uniform_int_distribution<uint16_t> word_dist;
+  uniform_int_distribution<size_t> length_dist { 0, 100 };
+  bernoulli_distribution flag_dist;
+
+  for ( size_t i = 0; i < num_segments; ++i ) {
+    TCPSegment seg;
+    seg.udinfo.src_port = word_dist( rd );
+    seg.udinfo.dst_port = word_dist( rd );
+    seg.message.sender->seqno = Wrap32 { address_dist( rd ) };
+    seg.message.sender->SYN = flag_dist( rd );
+    seg.message.sender->payload = random_bytes( rd, length_dist( rd ) );
+    seg.message.receiver->ackno = Wrap32 { address_dist( rd ) };
+    seg.message.receiver->window_size = word_dist( rd );
+
+    IPv4Header ip;
+    ip.proto = IPv4Header::PROTO_TCP;
+    ip.len = IPv4Header::LENGTH + seg.header_length() + seg.message.sender->payload.size();
+    ip.src = address_dist( rd );
+    ip.dst = address_dist( rd );
+    seg.compute_checksum( ip.pseudo_checksum() );
+
+    const uint32_t new_src = address_dist( rd );
+    const uint32_t new_dst = address_dist( rd );
+    seg.update_checksum_for_address( ip.src, new_src );
+    seg.update_checksum_for_address( ip.dst, new_dst );
+    ip.src = new_src;
+    ip.dst = new_dst;
+    seg.set_src_port( word_dist( rd ) );
+    seg.set_dst_port( word_dist( rd ) );
+    seg.set_seqno( Wrap32 { address_dist( rd ) } );
+
+    const uint16_t incremental = seg.udinfo.cksum;
+    seg.compute_checksum( ip.pseudo_checksum() );
+    if ( incremental != seg.udinfo.cksum ) {
+      throw runtime_error( "incremental checksum update of " + seg.to_string() + " gave " + to_string( incremental )
+                           + ", expected " + to_string( seg.udinfo.cksum ) );
+    }
+  }
+}
+
+// Check that incremental updates (RFC 1624) agree with recomputing the header checksum, and compare their cost
+void update_test( fstream& debug_output, const size_t num_headers, const size_t random_seed )
+{
+  default_random_engine rd { random_seed };
+  uniform_int_distribution<uint32_t> address_dist;
+  uniform_int_distribution<uint16_t> word_dist;
+  uniform_int_distribution<uint16_t> ttl_dist { 1, 255 };
+
+  vector<IPv4Header> headers( num_headers );
+  for ( auto& header : headers ) {
+    header.len = word_dist( rd );
+    header.id = word_dist( rd );
+    header.ttl = static_cast<uint8_t>( ttl_dist( rd ) );
+    header.src = address_dist( rd );
+    header.dst = address_dist( rd );
+    header.compute_checksum();
+
+    IPv4Header rewritten = header;
+    rewritten.set_src( address_dist( rd ) );
+    rewritten.set_dst( address_dist( rd ) );
+    rewritten.set_ttl( rewritten.ttl - 1 );
+    const uint16_t incremental = rewritten.cksum;
+    rewritten.compute_checksum();
+    if ( incremental != rewritten.cksum ) {
+      throw runtime_error( "incremental checksum update of " + rewritten.to_string() + " gave "
+                           + to_string( incremental ) + ", expected " + to_string( rewritten.cksum ) );
+    }
+  }
+
+  tcp_update_test( rd, num_headers / 10 );
+
+  auto decrement_all = [&]( auto&& decrement ) {
+    auto copies = headers;
+    const auto start_time = steady_clock::now();
+    for ( auto& header : copies ) {
+      decrement( header );
+    }
+    const auto stop_time = steady_clock::now();
+    return duration_cast<duration<double, nano>>( stop_time - start_time ).count()
+           / static_cast<double>( num_headers );
+  };
+
+  const double recompute_ns = decrement_all( []( IPv4Header& header ) {
+    --header.ttl;
+    header.compute_checksum();
+  } );
+  const double update_ns
+    = decrement_all( []( IPv4Header& header ) { header.set_ttl( header.ttl - 1 ); } );
+
+  cout << "Decrementing the TTL took " << fixed << setprecision( 2 ) << recompute_ns
+       << " ns recomputing the checksum, " << update_ns << " ns updating it.\n";
+  debug_output << "        IPv4 TTL decrement (recompute/update): " << fixed << setprecision( 2 ) << setw( 8 )
+               << recompute_ns << " / " << update_ns << " ns\n";
+
+  if ( update_ns >= recompute_ns ) {
+    throw runtime_error( "updating the checksum was not faster than recomputing it" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  correctness_test( 20000, 1071 );
+  update_test( debug_output, 1000000, 1624 );
+
+  speed_test( debug_output, 40, 1e9, 1624 );
+  speed_test( debug_output, 1500, 1e10, 1624 );
+  speed_test( debug_output, 65535, 1e10, 1624 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -2,9 +2,11 @@
 #include "exception.hh"
 #include "helpers.hh"
 
+#include <array>
 #include <csignal>
 #include <iostream>
 #include <sstream>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -89,6 +91,9 @@ string to_string( const TCPSenderMessage& msg )
   if ( msg.RST ) {
     o << " +RST";
   }
+  if ( msg.timestamp.has_value() ) {
+    o << " TSval=" << msg.timestamp.value();
+  }
   o << ")";
   return o.str();
 }
@@ -139,3 +144,21 @@ Timeout::Timer Timeout::make_timer() // NOLINT(readability-convert-member-functi
 {
   return {};
 }
+
+pair<FileDescriptor, FileDescriptor> make_socket_pair()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+string read_all( FileDescriptor& fd )
+{
+  string ret;
+  while ( not fd.eof() ) {
+    string buffer;
+    fd.read( buffer );
+    ret += buffer;
+  }
+  return ret;
+}
@@ -3,6 +3,7 @@
 #include "conversions.hh"
 #include "debug.hh"
 #include "exception.hh"
+#include "file_descriptor.hh"
 #include "tcp_sender_message.hh"
 
 #include <iostream>
@@ -251,3 +252,10 @@ struct ExpectBool : public ExpectNumber<T, bool>
 };
 
 std::string to_string( const TCPSenderMessage& msg );
+
+//! A connected pair of Unix-domain datagram sockets, e.g. a "wire" between two TCP stacks (as in
+//! apps/tcp_stack_load)
+std::pair<FileDescriptor, FileDescriptor> make_socket_pair();
+
+//! Read a stream (e.g. a socket) to EOF
+std::string read_all( FileDescriptor& fd );
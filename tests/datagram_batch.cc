@@ -0,0 +1,157 @@
+#include "common.hh"
+#include "ref.hh"
+#include "socket.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A pair of UDP sockets on the loopback interface exchanges batches of datagrams gathered from several
+// buffers: each batch arrives whole and in order, with the sender of each datagram, and a receive takes
+// no more datagrams than it has payloads for. Then a batch to a peer that is not reading fills a
+// non-blocking socket's buffer, and is sent in part.
+
+namespace {
+
+constexpr size_t BATCH = 6;
+
+// The buffers of datagram `i`, which differ in number and size from one datagram to the next
+vector<string> pieces( const size_t i )
+{
+  vector<string> ret { "datagram " + to_string( i ), string( i * 100, 'x' ) };
+  if ( i % 2 ) {
+    ret.emplace_back( "!" );
+  }
+  return ret;
+}
+
+string contents( const size_t i )
+{
+  string ret;
+  for ( const auto& piece : pieces( i ) ) {
+    ret += piece;
+  }
+  return ret;
+}
+
+// Check that `payloads` holds datagrams `first` onwards, `count` of them from `source`, and then nothing
+void check_received( const vector<string>& payloads,
+                     const vector<Address>& sources,
+                     const size_t first,
+                     const size_t count,
+                     const Address& source )
+{
+  test_should_be( sources.size(), count );
+  for ( size_t i = 0; i < payloads.size(); i++ ) {
+    if ( i < count ) {
+      test_should_be( payloads[i].size(), contents( first + i ).size() );
+      test_should_be( payloads[i] == contents( first + i ), true );
+      test_should_be( sources[i] == source, true );
+    } else {
+      test_should_be( payloads[i].empty(), true );
+    }
+  }
+}
+
+// A UDP socket bound to an ephemeral loopback port
+UDPSocket loopback_socket()
+{
+  UDPSocket ret;
+  ret.bind( Address { "127.0.0.1", 0 } );
+  return ret;
+}
+
+void test_batches()
+{
+  UDPSocket sender = loopback_socket();
+  UDPSocket receiver = loopback_socket();
+  sender.connect( receiver.local_address() );
+
+  vector<vector<string>> storage;
+  vector<vector<string_view>> views;
+  vector<PacketBuffers> refs;
+  for ( size_t i = 0; i < BATCH; i++ ) {
+    storage.push_back( pieces( i ) );
+  }
+  for ( const auto& datagram : storage ) {
+    views.emplace_back( datagram.begin(), datagram.end() );
+    PacketBuffers buffers;
+    for ( const auto& piece : datagram ) {
+      buffers.push_back( Ref<string>::borrow( piece ) );
+    }
+    refs.push_back( move( buffers ) );
+  }
+
+  // one batch arrives whole and in order, and the payloads left over are emptied (of what they held before)
+  vector<string> payloads( BATCH + 2, "stale" );
+  vector<Address> sources;
+  test_should_be( sender.send_batch( views ), BATCH );
+  test_should_be( receiver.recv_batch( payloads, &sources ), BATCH );
+  check_received( payloads, sources, 0, BATCH, sender.local_address() );
+
+  // a receive takes no more datagrams than it has payloads for, and the rest wait for the next
+  test_should_be( sender.send_batch( refs ), BATCH );
+  payloads.resize( BATCH / 2 );
+  test_should_be( receiver.recv_batch( payloads, &sources ), BATCH / 2 );
+  check_received( payloads, sources, 0, BATCH / 2, sender.local_address() );
+  payloads.resize( BATCH );
+  test_should_be( receiver.recv_batch( payloads, &sources ), BATCH - BATCH / 2 );
+  check_received( payloads, sources, BATCH / 2, BATCH - BATCH / 2, sender.local_address() );
+
+  // the other way, to an explicit destination
+  test_should_be( receiver.sendto_batch( sender.local_address(), views ), BATCH );
+  test_should_be( sender.recv_batch( payloads, &sources ), BATCH );
+  check_received( payloads, sources, 0, BATCH, receiver.local_address() );
+
+  // a non-blocking socket with nothing queued receives nothing
+  receiver.set_blocking( false );
+  test_should_be( receiver.recv_batch( payloads, &sources ), size_t { 0 } );
+  check_received( payloads, sources, 0, 0, sender.local_address() );
+}
+
+// A Unix-domain datagram socket, whose datagrams count against the sender's buffer until they are read
+class UnixDatagramSocket : public DatagramSocket
+{
+public:
+  explicit UnixDatagramSocket( FileDescriptor&& fd ) : DatagramSocket( move( fd ), AF_UNIX, SOCK_DGRAM ) {}
+};
+
+void test_partial_send()
+{
+  auto [wire, peer] = make_socket_pair();
+  UnixDatagramSocket sender { move( wire ) };
+  sender.set_blocking( false );
+
+  // many more bytes than a socket buffer holds (net.core.wmem_default)
+  const string payload( 16384, 'p' );
+  const vector<vector<string_view>> datagrams( 1024, { payload } );
+  const size_t sent = sender.send_batch( datagrams );
+  test_should_be( sent > 0, true );
+  test_should_be( sent < datagrams.size(), true );
+
+  // once full, the buffer takes nothing more
+  test_should_be( sender.send_batch( datagrams ), size_t { 0 } );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_batches();
+    test_partial_send();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,316 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "socket.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string_view>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// count heap allocations, to check that dispatching does not allocate
+namespace {
+size_t allocations = 0;
+}
+
+void* operator new( const size_t size )
+{
+  ++allocations;
+  if ( void* const p = malloc( size ) ) { // NOLINT(*-no-malloc, *-owning-memory)
+    return p;
+  }
+  throw bad_alloc {};
+}
+
+void operator delete( void* p ) noexcept
+{
+  free( p ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* p, size_t /* size */ ) noexcept
+{
+  free( p ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+string backend_name( const EventLoop::Backend backend )
+{
+  return backend == EventLoop::Backend::Epoll     ? "epoll"
+         : backend == EventLoop::Backend::IoUring ? "io_uring"
+                                                  : "poll";
+}
+
+// Measure the cost of dispatching one event when an EventLoop watches many idle file descriptors
+double speed_test( fstream& debug_output,
+                   const EventLoop::Backend backend,
+                   const size_t num_fds, // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t num_events,
+                   const size_t random_seed )
+{
+  vector<LocalStreamSocket> write_ends;
+  vector<LocalStreamSocket> read_ends;
+  for ( size_t i = 0; i < num_fds; ++i ) {
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM, 0, fds.data() ) );
+    write_ends.emplace_back( FileDescriptor { fds[0] } );
+    read_ends.emplace_back( FileDescriptor { fds[1] } );
+  }
+
+  EventLoop loop { backend };
+  const size_t category = loop.add_category( "read one byte" );
+  size_t events_served = 0;
+  string buffer;
+  for ( auto& sock : read_ends ) {
+    loop.add_rule( category, sock, Direction::In, [&] {
+      buffer.resize( 1 );
+      sock.read( buffer );
+      ++events_served;
+    } );
+  }
+
+  default_random_engine rd { random_seed };
+  uniform_int_distribution<size_t> which_fd { 0, num_fds - 1 };
+
+  // count the allocations made by the loop (after the first waits, which may size its buffers)
+  const size_t warmup = min<size_t>( num_events / 10, 100 );
+  size_t loop_allocations = 0;
+
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_events; ++i ) {
+    write_ends.at( which_fd( rd ) ).write( "x" );
+    const size_t allocations_before = allocations;
+    if ( loop.wait_next_event( -1 ) != EventLoop::Result::Success ) {
+      throw runtime_error( "EventLoop did not report an event" );
+    }
+    if ( i >= warmup ) {
+      loop_allocations += allocations - allocations_before;
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( loop_allocations > 0 ) {
+    throw runtime_error( "EventLoop (" + backend_name( backend ) + ") allocated " + to_string( loop_allocations )
+                         + " times while dispatching" );
+  }
+
+  if ( events_served != num_events ) {
+    throw runtime_error( "EventLoop served " + to_string( events_served ) + " events, expected "
+                         + to_string( num_events ) );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const double us_per_event = test_duration.count() * 1e6 / static_cast<double>( num_events );
+  const string name = backend_name( backend );
+
+  cout << "EventLoop (" << name << ") with " << num_fds << " fds dispatched one event per " << fixed
+       << setprecision( 2 ) << us_per_event << " us.\n";
+  debug_output << "        EventLoop dispatch, " << num_fds << " fds (" << name << "): " << fixed
+               << setprecision( 2 ) << setw( 8 ) << us_per_event << " us/event\n";
+
+  return us_per_event;
+}
+
+// Measure the cost of dispatching a burst in which every watched file descriptor becomes readable at once
+double burst_test( fstream& debug_output,
+                   const EventLoop::Dispatch dispatch,
+                   const size_t max_per_round, // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t num_fds,
+                   const size_t num_bursts )
+{
+  vector<LocalStreamSocket> write_ends;
+  vector<LocalStreamSocket> read_ends;
+  for ( size_t i = 0; i < num_fds; ++i ) {
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM, 0, fds.data() ) );
+    write_ends.emplace_back( FileDescriptor { fds[0] } );
+    read_ends.emplace_back( FileDescriptor { fds[1] } );
+  }
+
+  EventLoop loop;
+  loop.set_dispatch( dispatch, max_per_round );
+  const size_t category = loop.add_category( "read one byte" );
+  size_t events_served = 0;
+  string buffer;
+  for ( auto& sock : read_ends ) {
+    loop.add_rule( category, sock, Direction::In, [&] {
+      buffer.resize( 1 );
+      sock.read( buffer );
+      ++events_served;
+    } );
+  }
+
+  size_t waits = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_bursts; ++i ) {
+    for ( auto& sock : write_ends ) {
+      sock.write( "x" );
+    }
+    while ( events_served < ( i + 1 ) * num_fds ) {
+      if ( loop.wait_next_event( -1 ) != EventLoop::Result::Success ) {
+        throw runtime_error( "EventLoop did not report an event" );
+      }
+      ++waits;
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( events_served != num_bursts * num_fds ) {
+    throw runtime_error( "EventLoop served " + to_string( events_served ) + " events, expected "
+                         + to_string( num_bursts * num_fds ) );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const double us_per_event = test_duration.count() * 1e6 / static_cast<double>( events_served );
+  const string name = dispatch == EventLoop::Dispatch::One ? "one per wait"
+                      : max_per_round == SIZE_MAX         ? "all ready"
+                                                           : "up to " + to_string( max_per_round ) + " per wait";
+
+  cout << "EventLoop (" << name << ") served bursts on " << num_fds << " fds in " << waits
+       << " waits, one event per " << fixed << setprecision( 2 ) << us_per_event << " us.\n";
+  debug_output << "        EventLoop burst, " << num_fds << " fds (" << name << "): " << fixed << setprecision( 2 )
+               << setw( 8 ) << us_per_event << " us/event\n";
+
+  return us_per_event;
+}
+
+// Measure the cost of the loop's own bookkeeping (without a system call) by serving a non-fd rule
+double dispatch_test( fstream& debug_output, const size_t num_events )
+{
+  EventLoop loop;
+  bool wanted = false;
+  size_t events_served = 0;
+  loop.add_rule(
+    "count",
+    [&] {
+      wanted = false;
+      ++events_served;
+    },
+    [&] { return wanted; } );
+
+  const size_t allocations_before = allocations;
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_events; ++i ) {
+    wanted = true;
+    if ( loop.wait_next_event( -1 ) != EventLoop::Result::Success ) {
+      throw runtime_error( "EventLoop did not report an event" );
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( events_served != num_events ) {
+    throw runtime_error( "EventLoop served " + to_string( events_served ) + " events, expected "
+                         + to_string( num_events ) );
+  }
+  if ( allocations != allocations_before ) {
+    throw runtime_error( "EventLoop allocated while dispatching a non-fd rule" );
+  }
+
+  const double ns_per_event
+    = duration_cast<duration<double, nano>>( stop_time - start_time ).count() / static_cast<double>( num_events );
+
+  cout << "EventLoop dispatched a non-fd rule once per " << fixed << setprecision( 2 ) << ns_per_event
+       << " ns.\n";
+  debug_output << "        EventLoop non-fd dispatch: " << fixed << setprecision( 2 ) << setw( 8 ) << ns_per_event
+               << " ns/event\n";
+
+  return ns_per_event;
+}
+
+// Measure how late timer rules fire, with deadlines finer than the millisecond timeouts of poll(2)
+double timer_test( fstream& debug_output, const EventLoop::Backend backend, const size_t num_timers )
+{
+  EventLoop loop { backend };
+  constexpr auto delay = microseconds { 250 };
+  size_t fired = 0;
+  steady_clock::time_point deadline;
+  steady_clock::duration total_lateness {};
+
+  auto timer = loop.add_timer( "timer", [&] {
+    const auto now = steady_clock::now();
+    if ( now < deadline ) {
+      throw runtime_error( "timer fired early" );
+    }
+    total_lateness += now - deadline;
+    ++fired;
+  } );
+
+  for ( size_t i = 0; i < num_timers; ++i ) {
+    deadline = steady_clock::now() + delay;
+    timer.set( deadline );
+    while ( fired == i ) {
+      if ( loop.wait_next_event( -1 ) == EventLoop::Result::Exit ) {
+        throw runtime_error( "EventLoop exited with a timer scheduled" );
+      }
+    }
+  }
+
+  if ( loop.wait_next_event( -1 ) != EventLoop::Result::Exit ) {
+    throw runtime_error( "EventLoop did not exit with no timers scheduled" );
+  }
+
+  const double us_late = duration_cast<duration<double, micro>>( total_lateness ).count() / num_timers;
+  const string name = backend_name( backend );
+
+  cout << "EventLoop (" << name << ") ran " << num_timers << " timers of " << delay.count() << " us, on average "
+       << fixed << setprecision( 2 ) << us_late << " us late.\n";
+  debug_output << "        EventLoop timer lateness (" << name << "): " << fixed << setprecision( 2 ) << setw( 8 )
+               << us_late << " us\n";
+
+  return us_late;
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test( debug_output, EventLoop::Backend::Poll, 16, 20000, 321 );
+  speed_test( debug_output, EventLoop::Backend::Epoll, 16, 20000, 321 );
+  speed_test( debug_output, EventLoop::Backend::IoUring, 16, 20000, 321 );
+
+  const double poll_us = speed_test( debug_output, EventLoop::Backend::Poll, 2048, 5000, 321 );
+  const double epoll_us = speed_test( debug_output, EventLoop::Backend::Epoll, 2048, 20000, 321 );
+  const double io_uring_us = speed_test( debug_output, EventLoop::Backend::IoUring, 2048, 20000, 321 );
+
+  if ( epoll_us >= poll_us ) {
+    throw runtime_error( "epoll backend was not faster than poll with many idle fds" );
+  }
+  if ( io_uring_us >= poll_us ) {
+    throw runtime_error( "io_uring backend was not faster than poll with many idle fds" );
+  }
+
+  const double one_us = burst_test( debug_output, EventLoop::Dispatch::One, SIZE_MAX, 64, 1000 );
+  const double all_us = burst_test( debug_output, EventLoop::Dispatch::AllReady, SIZE_MAX, 64, 1000 );
+  burst_test( debug_output, EventLoop::Dispatch::AllReady, 10, 64, 1000 );
+
+  if ( all_us >= one_us ) {
+    throw runtime_error( "serving all ready rules was not faster than serving one per wait" );
+  }
+
+  dispatch_test( debug_output, 1000000 );
+
+  timer_test( debug_output, EventLoop::Backend::Poll, 1000 );
+  timer_test( debug_output, EventLoop::Backend::Epoll, 1000 );
+  timer_test( debug_output, EventLoop::Backend::IoUring, 1000 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include "common.hh"
+#include "exception.hh"
+#include "io_uring_packet_io.hh"
+#include "socket.hh"
+#include "tcp_minnow_socket_impl.hh"
+#include "tuntap_adapter.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// An IoUringPacketIO on one end of a Unix-domain datagram socket pair reads, and writes in batches, more
+// packets than it has buffers. Then, given a TUN device (see io_uring_packets_t.sh, which creates one),
+// a TCPMinnowSocket whose adapter uses io_uring exchanges a stream with a kernel TCP socket over it.
+
+namespace {
+
+// Wait (with a time limit) for the ring to have completions
+void wait_readable( IoUringPacketIO& io )
+{
+  io.flush();
+  pollfd pfd { io.fd().fd_num(), POLLIN, 0 };
+  if ( CheckSystemCall( "poll", ::poll( &pfd, 1, 2000 ) ) == 0 ) {
+    throw runtime_error( "timed out waiting for completions" );
+  }
+}
+
+string packet_contents( const size_t i )
+{
+  return "packet " + to_string( i ) + string( i % 100, 'x' );
+}
+
+// a Unix-domain datagram socket queues at most 10 datagrams (net.unix.max_dgram_qlen) by default
+constexpr size_t BATCH = 8;
+constexpr size_t BATCHES = 5;
+
+void test_read()
+{
+  auto [wire, peer] = make_socket_pair();
+  IoUringPacketIO io { wire, 4 }; // fewer buffers than a batch: the read runs out, and is queued again
+
+  size_t received = 0;
+  for ( size_t batch = 0; batch < BATCHES; batch++ ) {
+    for ( size_t i = 0; i < BATCH; i++ ) {
+      peer.write( packet_contents( batch * BATCH + i ) );
+    }
+    while ( received < ( batch + 1 ) * BATCH ) {
+      wait_readable( io );
+      string packet;
+      while ( io.read( packet ) ) {
+        if ( packet != packet_contents( received ) ) {
+          throw runtime_error( "packet " + to_string( received ) + " was read as \"" + packet + "\"" );
+        }
+        received++;
+      }
+    }
+  }
+}
+
+void test_write()
+{
+  auto [wire, peer] = make_socket_pair();
+  IoUringPacketIO io { wire };
+
+  for ( size_t batch = 0; batch < BATCHES; batch++ ) {
+    // the strings are borrowed, so the writes must copy them before they change
+    string buffer;
+    for ( size_t i = 0; i < BATCH; i++ ) {
+      buffer = packet_contents( batch * BATCH + i );
+      const array<Ref<string>, 1> pieces { Ref<string>::borrow( buffer ) };
+      io.write( pieces );
+      buffer.assign( buffer.size(), '?' );
+    }
+    io.flush();
+
+    for ( size_t i = 0; i < BATCH; i++ ) {
+      string packet;
+      peer.read( packet );
+      if ( packet != packet_contents( batch * BATCH + i ) ) {
+        throw runtime_error( "packet " + to_string( batch * BATCH + i ) + " was written as \"" + packet + "\"" );
+      }
+    }
+
+    // the writes' completions are consumed by read(), which finds no packet among them
+    wait_readable( io );
+    string packet;
+    if ( io.read( packet ) ) {
+      throw runtime_error( "read() returned a packet that nobody sent" );
+    }
+  }
+}
+
+void test_tun( const string& tun_name )
+{
+  const Address server_address { "169.254.150.1", 8150 };
+  TCPSocket listener;
+  listener.set_reuseaddr();
+  listener.bind( server_address );
+  listener.listen();
+
+  string server_error;
+  thread server_thread { [&] {
+    try {
+      TCPSocket server = listener.accept();
+      const string message = read_all( server );
+      server.write( "echo: " + message );
+    } catch ( const exception& e ) {
+      server_error = e.what();
+    }
+  } };
+
+  TCPConfig config;
+  config.rt_timeout = 100;
+  FdAdapterConfig c_ad;
+  c_ad.source = Address { "169.254.150.9", 1234 };
+  c_ad.destination = server_address;
+
+  TCPOverIPv4MinnowSocket client { TCPOverIPv4OverTunFdAdapter { TunFD { tun_name }, true } };
+  client.connect( config, c_ad );
+  const string message( 100000, 'm' );
+  client.write( message );
+  client.shutdown( SHUT_WR );
+  const string reply = read_all( client );
+  client.wait_until_closed();
+  server_thread.join();
+
+  if ( not server_error.empty() ) {
+    throw runtime_error( "server: " + server_error );
+  }
+  if ( reply != "echo: " + message ) {
+    throw runtime_error( "the kernel echoed " + to_string( reply.size() ) + " bytes instead of "
+                         + to_string( message.size() + 6 ) );
+  }
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    try {
+      auto [wire, peer] = make_socket_pair();
+      const IoUringPacketIO probe { wire };
+    } catch ( const unix_error& e ) {
+      cerr << "io_uring is unavailable (" << e.what() << "); skipping\n";
+      return 77;
+    }
+
+    test_read();
+    test_write();
+    if ( argc == 2 ) {
+      test_tun( argv[1] ); // NOLINT(*-pointer-arithmetic)
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
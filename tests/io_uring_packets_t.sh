@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Run the io_uring_packets test, with a TUN device of its own if it can create one (which needs
+# CAP_NET_ADMIN, e.g. root). Without it, only the socket-pair parts run.
+
+TUN=minnow-uring0
+
+if ! ip tuntap add mode tun name "${TUN}" 2>/dev/null; then
+    echo "cannot create a TUN device (needs CAP_NET_ADMIN); testing with socket pairs only"
+    exec "${1}/tests/io_uring_packets_sanitized"
+fi
+trap 'ip tuntap del mode tun name "${TUN}"' EXIT
+
+# keep IPv6 neighbor discovery off the device
+sysctl -q -w "net.ipv6.conf.${TUN}.disable_ipv6=1" 2>/dev/null
+ip addr add 169.254.150.1/24 dev "${TUN}"
+ip link set dev "${TUN}" up
+
+"${1}/tests/io_uring_packets_sanitized" "${TUN}"
@@ -0,0 +1,123 @@
+#include "common.hh"
+#include "sharded_tcp_stack.hh"
+#include "socket.hh"
+#include "tcp_listener.hh"
+#include "tun.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A ShardedTCPStack on the queues of a multiqueue TUN device (see multiqueue_tun_t.sh, which creates the
+// device), with one worker and one ingress thread per queue, serves several kernel TCP clients at once:
+// each sends a message and gets it back echoed. Queues opened with TCP offload are refused.
+
+namespace {
+
+constexpr size_t QUEUES = 4;
+constexpr size_t CLIENTS = 12;
+
+const Address SERVER { "169.254.152.9", 80 };
+
+string message_from( const size_t client )
+{
+  return "from client " + to_string( client ) + string( client * 500, '.' );
+}
+
+void test_offload_refused( const string& tun_name )
+{
+  bool refused = false;
+  try {
+    const ShardedTCPStack stack { TunFD::open_queues( tun_name, QUEUES, true ) };
+  } catch ( const runtime_error& ) {
+    refused = true;
+  }
+  if ( not refused ) {
+    throw runtime_error( "ShardedTCPStack accepted queues opened with tcp_offload" );
+  }
+}
+
+void test_clients( const string& tun_name )
+{
+  ShardedTCPStack server_stack { TunFD::open_queues( tun_name, QUEUES ) };
+  if ( server_stack.worker_count() != QUEUES ) {
+    throw runtime_error( "the stack has " + to_string( server_stack.worker_count() ) + " workers instead of "
+                         + to_string( QUEUES ) );
+  }
+  TCPListener listener = server_stack.listen( TCPConfig {}, SERVER );
+
+  vector<string> replies( CLIENTS );
+  vector<string> client_errors( CLIENTS );
+  vector<thread> clients;
+  for ( size_t i = 0; i < CLIENTS; i++ ) {
+    clients.emplace_back( [&, i] {
+      try {
+        TCPSocket client;
+        client.connect( SERVER );
+        client.write( message_from( i ) );
+        client.shutdown( SHUT_WR );
+        replies[i] = read_all( client );
+      } catch ( const exception& e ) {
+        client_errors[i] = e.what();
+      }
+    } );
+  }
+
+  // serve the connections one at a time, in whatever order the handshakes complete
+  set<string> received;
+  for ( size_t i = 0; i < CLIENTS; i++ ) {
+    LocalStreamSocket server = listener.accept();
+    const string message = read_all( server );
+    received.insert( message );
+    server.write( "echo: " + message );
+  }
+  for ( auto& client : clients ) {
+    client.join();
+  }
+
+  set<string> expected;
+  for ( size_t i = 0; i < CLIENTS; i++ ) {
+    if ( not client_errors[i].empty() ) {
+      throw runtime_error( "client " + to_string( i ) + ": " + client_errors[i] );
+    }
+    if ( replies[i] != "echo: " + message_from( i ) ) {
+      throw runtime_error( "client " + to_string( i ) + " got a reply of " + to_string( replies[i].size() )
+                           + " bytes instead of its message echoed" );
+    }
+    expected.insert( message_from( i ) );
+  }
+  if ( received != expected ) {
+    throw runtime_error( "the accepted connections did not each carry one client's message" );
+  }
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc != 2 ) {
+      cerr << "Usage: " << argv[0] << " TUN_DEVICE\n"; // NOLINT(*-pointer-arithmetic)
+      return EXIT_FAILURE;
+    }
+    const string tun_name = argv[1]; // NOLINT(*-pointer-arithmetic)
+
+    // first, as opening a queue with TCP offload changes the whole device
+    test_offload_refused( tun_name );
+    test_clients( tun_name );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
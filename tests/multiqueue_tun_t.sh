@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Run the multiqueue_tun test over a multiqueue TUN device of its own, which needs CAP_NET_ADMIN (e.g.
+# root). Without it, the test is skipped.
+
+TUN=minnow-mq0
+
+if ! ip tuntap add mode tun multi_queue name "${TUN}" 2>/dev/null; then
+    echo "cannot create a multiqueue TUN device (needs CAP_NET_ADMIN); skipping"
+    exit 77
+fi
+trap 'ip tuntap del mode tun multi_queue name "${TUN}"' EXIT
+
+# keep IPv6 neighbor discovery off the device
+sysctl -q -w "net.ipv6.conf.${TUN}.disable_ipv6=1" 2>/dev/null
+ip addr add 169.254.152.1/24 dev "${TUN}"
+ip link set dev "${TUN}" up
+
+"${1}/tests/multiqueue_tun_sanitized" "${TUN}"
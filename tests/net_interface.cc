@@ -478,6 +478,58 @@ int main()
       test.execute( ExpectNoFrame {} );
     }
 
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress old_eth = random_private_ethernet_address();
+      const EthernetAddress new_eth = random_private_ethernet_address();
+      const auto datagram1 = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      const auto datagram3 = make_datagram( "5.6.7.8", "13.12.11.12" );
+
+      NetworkInterfaceTestHarness test {
+        "ARP mapping refreshed just before it expires", local_eth, Address( "100.5.100.5", 0 ) };
+
+      // learn a mapping at t = 0
+      test.execute( ReceiveFrame { make_frame(
+        old_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, old_eth, "144.144.144.144", {}, "100.5.100.5" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // at t = 29.999s, the peer announces a new Ethernet address, refreshing the mapping
+      test.execute( Tick { 29999 } );
+      test.execute( ReceiveFrame { make_frame(
+        new_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, new_eth, "144.144.144.144", {}, "100.5.100.5" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // the original mapping's deadline (t = 30s) passes within one tick, but the refreshed mapping survives
+      test.execute( Tick { 29000 } );
+      test.execute( SendDatagram { datagram1, Address( "144.144.144.144", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, new_eth, EthernetHeader::TYPE_IPv4, serialize( datagram1 ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // ... until 30 seconds after the refresh
+      test.execute( Tick { 999 } );
+      test.execute( SendDatagram { datagram2, Address( "144.144.144.144", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, new_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      test.execute( Tick { 1 } );
+      test.execute( SendDatagram { datagram3, Address( "144.144.144.144", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "100.5.100.5", {}, "144.144.144.144" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
     // test credit: Josselin Somerville Roberts
     {
       const EthernetAddress local_eth = random_private_ethernet_address();
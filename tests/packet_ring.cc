@@ -0,0 +1,149 @@
+#include "ethernet_frame.hh"
+#include "exception.hh"
+#include "packet_ring.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Frames sent from one PacketRingSocket to another over the two ends of a veth pair (see
+// packet_ring_t.sh, which creates the pair). A callback that throws must not stall the receive ring.
+
+namespace {
+
+constexpr uint16_t TYPE_TEST = 0x88b5; // "local experimental" EtherType, so other traffic can be ignored
+
+PacketRingConfig small_rings()
+{
+  return {
+    .block_size = 1 << 16, .block_count = 4, .retire_timeout_ms = 1, .frame_size = 2048, .tx_frame_count = 64 };
+}
+
+void send( PacketRingSocket& socket, const string& prefix, const size_t count )
+{
+  for ( size_t i = 0; i < count; i++ ) {
+    EthernetFrame frame;
+    frame.header.dst = ETHERNET_BROADCAST;
+    frame.header.src = { 2, 0, 0, 0, 0, 1 };
+    frame.header.type = TYPE_TEST;
+    frame.payload.emplace_back( prefix + to_string( i ) );
+    if ( not socket.queue( frame ) ) {
+      throw runtime_error( "the transmit ring is full" );
+    }
+  }
+  socket.flush();
+}
+
+// The payload of a test frame, or an empty view for other traffic
+string_view test_payload( const string_view raw )
+{
+  if ( raw.size() < EthernetHeader::LENGTH
+       or ( static_cast<uint8_t>( raw[12] ) << 8U | static_cast<uint8_t>( raw[13] ) ) != TYPE_TEST ) {
+    return {};
+  }
+  return raw.substr( EthernetHeader::LENGTH, raw.find( '\0', EthernetHeader::LENGTH ) - EthernetHeader::LENGTH );
+}
+
+// Call for_each_frame( f ) whenever the socket is readable, until `done` or a time limit
+template<typename F, typename Done>
+void receive_until( PacketRingSocket& socket, F&& f, Done&& done )
+{
+  const auto deadline = chrono::steady_clock::now() + chrono::seconds( 2 );
+  while ( not done() ) {
+    if ( chrono::steady_clock::now() > deadline ) {
+      throw runtime_error( "timed out waiting for frames" );
+    }
+    pollfd pfd { socket.fd_num(), POLLIN, 0 };
+    CheckSystemCall( "poll", ::poll( &pfd, 1, 10 ) );
+    socket.for_each_frame( f );
+  }
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc != 3 ) {
+      cerr << "Usage: " << argv[0] << " SENDING_INTERFACE RECEIVING_INTERFACE\n"; // NOLINT(*-pointer-arithmetic)
+      return EXIT_FAILURE;
+    }
+    const string sending_interface = argv[1];   // NOLINT(*-pointer-arithmetic)
+    const string receiving_interface = argv[2]; // NOLINT(*-pointer-arithmetic)
+    PacketRingSocket sender { sending_interface, small_rings() };
+    PacketRingSocket receiver { receiving_interface, small_rings() };
+
+    // every frame sent arrives, in order
+    constexpr size_t count = 40;
+    send( sender, "first ", count );
+    vector<string> received;
+    receive_until(
+      receiver,
+      [&]( const string_view raw ) {
+        if ( const auto payload = test_payload( raw ); not payload.empty() ) {
+          received.emplace_back( payload );
+        }
+      },
+      [&] { return received.size() == count; } );
+    for ( size_t i = 0; i < count; i++ ) {
+      if ( received[i] != "first " + to_string( i ) ) {
+        throw runtime_error( "frame " + to_string( i ) + " arrived as \"" + received[i] + "\"" );
+      }
+    }
+
+    // a callback that throws gives the block back anyway, dropping the frames after it in the block, so
+    // that the next call goes on to the next block (rather than visiting the same one again, or stalling)
+    send( sender, "second ", count );
+    bool thrown = false;
+    try {
+      receive_until(
+        receiver,
+        [&]( const string_view raw ) {
+          if ( not test_payload( raw ).empty() ) {
+            thrown = true;
+            throw runtime_error( "callback failed" );
+          }
+        },
+        [&] { return thrown; } );
+    } catch ( const runtime_error& ) {
+      if ( not thrown ) {
+        throw;
+      }
+    }
+
+    send( sender, "third ", count );
+    received.clear();
+    receive_until(
+      receiver,
+      [&]( const string_view raw ) {
+        const auto payload = test_payload( raw );
+        if ( payload == "second 0" ) {
+          throw runtime_error( "the frame whose callback threw was visited again" );
+        }
+        if ( payload.starts_with( "third " ) ) {
+          received.emplace_back( payload );
+        }
+      },
+      [&] { return received.size() == count; } );
+    for ( size_t i = 0; i < count; i++ ) {
+      if ( received[i] != "third " + to_string( i ) ) {
+        throw runtime_error( "after the exception, frame " + to_string( i ) + " arrived as \"" + received[i]
+                             + "\"" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# Run the packet_ring test over a veth pair of its own, which needs CAP_NET_ADMIN (e.g. root).
+# Without it, the test is skipped.
+
+VETH_A=minnow-ring0
+VETH_B=minnow-ring1
+
+if ! ip link add "${VETH_A}" type veth peer name "${VETH_B}" 2>/dev/null; then
+    echo "cannot create a veth pair (needs CAP_NET_ADMIN); skipping"
+    exit 77
+fi
+trap 'ip link del "${VETH_A}"' EXIT
+
+for DEV in "${VETH_A}" "${VETH_B}"; do
+    # keep IPv6 neighbor discovery off the wire
+    sysctl -q -w "net.ipv6.conf.${DEV}.disable_ipv6=1" 2>/dev/null
+    ip link set dev "${DEV}" up
+done
+
+"${1}/tests/packet_ring_sanitized" "${VETH_A}" "${VETH_B}"
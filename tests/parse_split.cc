@@ -0,0 +1,153 @@
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "helpers.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress SRC_ETH { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+const EthernetAddress DST_ETH { 0x02, 0x66, 0x77, 0x88, 0x99, 0xaa };
+
+string flatten( const EthernetFrame& frame )
+{
+  return concat( serialize( frame ) );
+}
+
+// An Ethernet frame carrying a TCP segment (with the timestamps option and a payload) in an IPv4 datagram
+string tcp_frame()
+{
+  TCPMessage msg;
+  msg.sender->seqno = Wrap32 { 0x12345678 };
+  msg.sender->payload = "a payload that spans a few more bytes than the headers do";
+  msg.sender->FIN = true;
+  msg.sender->timestamp = 0xdeadbeef;
+  msg.receiver->ackno = Wrap32 { 0x9abcdef0 };
+  msg.receiver->window_size = 4321;
+  msg.receiver->timestamp_echo = 0x01020304;
+
+  const FourTuple flow { .local_address = 0x0a000001,
+                         .local_port = 40000,
+                         .remote_address = 0xc0a80102,
+                         .remote_port = 443 };
+
+  const InternetDatagram dgram = make_tcp_in_ip( msg, flow );
+  EthernetFrame frame;
+  frame.header = { .dst = DST_ETH, .src = SRC_ETH, .type = EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram ); // borrows the datagram's payload
+  return flatten( frame );
+}
+
+// An Ethernet frame carrying an ARP request
+string arp_frame()
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REQUEST;
+  arp.sender_ethernet_address = SRC_ETH;
+  arp.sender_ip_address = 0x0a000001;
+  arp.target_ip_address = 0x0a0000fe;
+
+  EthernetFrame frame;
+  frame.header = { .dst = ETHERNET_BROADCAST, .src = SRC_ETH, .type = EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  return flatten( frame );
+}
+
+// Parse the frame in `buffers` and everything it carries, describing each layer
+string describe( PacketBuffers buffers )
+{
+  EthernetFrame frame;
+  if ( not parse( frame, move( buffers ) ) ) {
+    return "bad Ethernet frame";
+  }
+  string ret = frame.header.to_string();
+
+  if ( frame.header.type == EthernetHeader::TYPE_ARP ) {
+    ARPMessage arp;
+    return ret + ( parse( arp, move( frame.payload ) ) ? " " + arp.to_string() : " bad ARP message" );
+  }
+
+  InternetDatagram dgram;
+  if ( not parse( dgram, move( frame.payload ) ) ) {
+    return ret + " bad IPv4 datagram";
+  }
+  ret += " " + dgram.header.to_string();
+
+  TCPSegment seg;
+  if ( not parse( seg, move( dgram.payload ), dgram.header.pseudo_checksum() ) ) {
+    return ret + " bad TCP segment";
+  }
+  return ret + " " + seg.to_string() + " ports=" + to_string( seg.udinfo.src_port ) + ">"
+         + to_string( seg.udinfo.dst_port ) + " cksum=" + to_string( seg.udinfo.cksum )
+         + " payload=" + seg.message.sender->payload;
+}
+
+// The bytes, as buffers split at each of `offsets` (which are increasing)
+PacketBuffers split( const string_view bytes, const vector<size_t>& offsets )
+{
+  PacketBuffers ret;
+  size_t start = 0;
+  for ( const size_t offset : offsets ) {
+    ret.emplace_back( string { bytes.substr( start, offset - start ) } );
+    start = offset;
+  }
+  ret.emplace_back( string { bytes.substr( start ) } );
+  return ret;
+}
+
+// Parse `bytes` split at every offset (and at every pair of offsets) and check that the result is the same as
+// parsing them contiguously
+void check_splits( const string& name, const string& bytes )
+{
+  const string expected = describe( split( bytes, {} ) );
+  if ( expected.starts_with( "bad" ) or expected.find( " bad " ) != string::npos ) {
+    throw runtime_error( name + ": contiguous frame did not parse: " + expected );
+  }
+
+  auto check = [&]( const vector<size_t>& offsets ) {
+    const string actual = describe( split( bytes, offsets ) );
+    if ( actual != expected ) {
+      string where;
+      for ( const size_t offset : offsets ) {
+        where += " " + to_string( offset );
+      }
+      throw runtime_error( name + " split at" + where + " parsed as\n  " + actual + "\ninstead of\n  "
+                           + expected );
+    }
+  };
+
+  for ( size_t i = 1; i < bytes.size(); ++i ) {
+    check( { i } );
+    for ( size_t j = i + 1; j < bytes.size(); ++j ) {
+      check( { i, j } );
+    }
+  }
+
+  cout << name << " (" << bytes.size() << " bytes) parsed identically when split at every offset.\n";
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    check_splits( "TCP/IPv4/Ethernet frame", tcp_frame() );
+    check_splits( "ARP/Ethernet frame", arp_frame() );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -80,6 +80,13 @@ struct ExpectReset : public ExpectBool<TCPReceiver>
   bool value( const TCPReceiver& rs ) const override { return rs.send().RST; }
 };
 
+struct ExpectTimestampEcho : public ExpectNumber<TCPReceiver, std::optional<uint32_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "timestamp_echo"; }
+  std::optional<uint32_t> value( const TCPReceiver& rs ) const override { return rs.send().timestamp_echo; }
+};
+
 struct ExpectAcknoBetween : public Expectation<TCPReceiver>
 {
   Wrap32 isn_;
@@ -146,6 +153,12 @@ struct SegmentArrives : public Action<TCPReceiver>
 
   SegmentArrives& with_seqno( uint32_t seqno_ ) { return with_seqno( Wrap32 { seqno_ } ); }
 
+  SegmentArrives& with_timestamp( uint32_t tsval )
+  {
+    msg_.timestamp = tsval;
+    return *this;
+  }
+
   SegmentArrives& with_data( std::string data )
   {
     msg_.payload = move( data );
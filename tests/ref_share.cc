@@ -0,0 +1,149 @@
+#include "buffer_pool.hh"
+#include "helpers.hh"
+#include "ref.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// A pooled (small) buffer holding `contents`, long enough that its characters live outside the string
+string pooled( const string& contents )
+{
+  string ret = BufferPool::small();
+  ret.assign( contents );
+  return ret;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    const string text = "a packet payload longer than a short string";
+
+    // sharing an owned Ref makes both shared, referring to one object
+    {
+      Ref<string> original { pooled( text ) };
+      const char* const chars = original.get().data();
+      const Ref<string> copy = original.share();
+      test_should_be( original.is_shared(), true );
+      test_should_be( copy.is_shared(), true );
+      test_should_be( &copy.get() == &original.get(), true );
+      test_should_be( copy.get().data() == chars, true ); // the characters did not move
+      test_should_be( copy.get() == text, true );
+    }
+
+    // copying a shared Ref shares it; copying an owned one copies it
+    {
+      Ref<string> original { pooled( text ) };
+      const Ref<string> owned_copy { original };
+      test_should_be( owned_copy.is_owned(), true );
+      test_should_be( &owned_copy.get() != &original.get(), true );
+
+      const Ref<string> shared = original.share();
+      Ref<string> copied { shared };
+      test_should_be( copied.is_shared(), true );
+      test_should_be( &copied.get() == &original.get(), true );
+
+      Ref<string> assigned { string { "something else" } };
+      assigned = shared;
+      test_should_be( &assigned.get() == &original.get(), true );
+    }
+
+    // cloning a const owned buffer copies it and leaves it owned; cloning a non-const one shares it
+    {
+      Ref<string> original { pooled( text ) };
+      const Ref<string>& const_original = original;
+      const Ref<string> copy = clone( const_original );
+      test_should_be( original.is_owned(), true );
+      test_should_be( copy.is_owned(), true );
+      test_should_be( copy.get() == text, true );
+
+      const Ref<string> shared = clone( original );
+      test_should_be( original.is_shared(), true );
+      test_should_be( &shared.get() == &original.get(), true );
+      const Ref<string> shared_again = clone( const_original );
+      test_should_be( &shared_again.get() == &original.get(), true );
+    }
+
+    // mutating a Ref shared with others copies the object first (copy-on-write)
+    {
+      Ref<string> original { pooled( text ) };
+      const Ref<string> other = original.share();
+      original.get_mut().append( "!" );
+      test_should_be( original.is_owned(), true );
+      test_should_be( original.get() == text + "!", true );
+      test_should_be( other.get() == text, true );
+    }
+
+    // ... but mutating the only reference to a shared object changes it in place
+    {
+      Ref<string> original { pooled( text ) };
+      Ref<string> other = original.share();
+      const string* const object = &original.get();
+      { // drop the other reference
+        const Ref<string> dropped = std::move( other );
+      }
+      original.get_mut().append( "!" );
+      test_should_be( original.is_shared(), true );
+      test_should_be( &original.get() == object, true );
+      test_should_be( original.get() == text + "!", true );
+    }
+
+    // releasing a Ref shared with others yields a copy, and leaves the others intact
+    {
+      Ref<string> original { pooled( text ) };
+      const Ref<string> other = original.share();
+      const string released = original.release();
+      test_should_be( released == text, true );
+      test_should_be( other.get() == text, true );
+      test_should_be( other.get().data() != released.data(), true );
+    }
+
+    // a borrowed Ref cannot be shared (it does not own the object)
+    {
+      const string object = text;
+      Ref<string> borrowed = borrow( object );
+      bool threw = false;
+      try {
+        const Ref<string> shared = borrowed.share();
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      test_should_be( threw, true );
+    }
+
+    // the last reference to a shared string gives its buffer back to the pool, and not before
+    {
+      Ref<string> original { pooled( text ) };
+      const char* const chars = original.get().data();
+      Ref<string> other = original.share();
+      {
+        const Ref<string> dropped = std::move( original );
+      }
+
+      string taken = BufferPool::small(); // the shared buffer is still in use...
+      test_should_be( taken.data() != chars, true );
+      BufferPool::recycle( std::move( taken ) );
+
+      {
+        const Ref<string> dropped = std::move( other );
+      }
+      string recycled = BufferPool::small(); // ... until its last reference is gone
+      test_should_be( recycled.data() == chars, true );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <optional>
 #include <string>
 
 using namespace std;
@@ -46,6 +47,28 @@ int main()
       test.execute( HasError { false } );
     }
 
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      TCPSenderTestHarness test { "Time until retransmission follows the timer", cfg };
+      test.execute( ExpectMsUntilRetransmission { nullopt } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectMsUntilRetransmission { retx_timeout } );
+      test.execute( Tick { retx_timeout - 1U } );
+      test.execute( ExpectMsUntilRetransmission { 1 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      // exponential back-off
+      test.execute( ExpectMsUntilRetransmission { 2 * retx_timeout } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } } );
+      test.execute( ExpectMsUntilRetransmission { nullopt } );
+    }
+
     {
       TCPConfig cfg;
       const Wrap32 isn( rd() );
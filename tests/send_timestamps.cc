@@ -0,0 +1,129 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Timestamps offered on SYN, used once echoed", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ).with_timestamp( 0 ) );
+      test.execute( Tick { 50 } );
+      test.execute( Receive { { isn + 1, 1000 } }.with_timestamp_echo( 0 ) );
+      test.execute( ExpectSmoothedRTT { 50 } );
+      test.execute( ExpectRTO { TCPConfig::TIMEOUT_MIN } );
+      test.execute( Push { "hello" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "hello" ).with_timestamp( 50 ) );
+      test.execute( ExpectSeqno { isn + 6 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "No timestamps after SYN if peer never echoes", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( 0 ) );
+      test.execute( Tick { 20 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectSmoothedRTT { nullopt } );
+      test.execute( ExpectRTO { cfg.rt_timeout } );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_no_timestamp() );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+
+      TCPSenderTestHarness test { "Timestamps disabled", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_no_timestamp() );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "RTT sample from a retransmitted segment", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( 0 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( cfg.rt_timeout ) );
+      test.execute( Tick { 30 } );
+      test.execute( Receive { { isn + 1, 1000 } }.with_timestamp_echo( cfg.rt_timeout ) );
+      test.execute( ExpectSmoothedRTT { 30 } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Retransmission timer follows measured RTT", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( 0 ) );
+      test.execute( Tick { 500 } );
+      test.execute( Receive { { isn + 1, 1000 } }.with_timestamp_echo( 0 ) );
+      test.execute( ExpectSmoothedRTT { 500 } );
+      test.execute( ExpectRTO { 1500 } );
+      test.execute( Push { "x" } );
+      test.execute( ExpectMessage {}.with_data( "x" ).with_timestamp( 500 ) );
+      test.execute( Tick { 1499 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "x" ).with_timestamp( 2000 ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 2, 1000 } }.with_timestamp_echo( 2000 ) );
+      // SRTT = 7/8 * 500 + 1/8 * 100, RTTVAR = 3/4 * 250 + 1/4 * 400
+      test.execute( ExpectSmoothedRTT { 450 } );
+      test.execute( ExpectRTO { 450 + 4 * 287 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Stamp taken after an idle gap", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( 0 ) );
+      test.execute( Tick { 40 } );
+      test.execute( Receive { { isn + 1, 1000 } }.with_timestamp_echo( 0 ) );
+      test.execute( ExpectSmoothedRTT { 40 } );
+      // nothing in flight for 5 seconds: the next segment's TSval must still be current...
+      test.execute( Tick { 5000 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { "late" } );
+      test.execute( ExpectMessage {}.with_data( "late" ).with_timestamp( 5040 ) );
+      // ... so that its echo measures the round trip, not the idle time
+      test.execute( Tick { 40 } );
+      test.execute( Receive { { isn + 5, 1000 } }.with_timestamp_echo( 5040 ) );
+      test.execute( ExpectSmoothedRTT { 40 } );
+      test.execute( ExpectRTO { TCPConfig::TIMEOUT_MIN } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -55,7 +55,8 @@ public:
   TCPSenderTestHarness( std::string name, TCPConfig config )
     : TestHarness( move( name ),
                    "initial_RTO_ms=" + to_string( config.rt_timeout ) + " and ISN=" + to_string( config.isn ),
-                   { TCPSender { ByteStream { config.send_capacity }, config.isn, config.rt_timeout } } )
+                   { TCPSender {
+                     ByteStream { config.send_capacity }, config.isn, config.rt_timeout, config.timestamps } } )
   {}
 
   template<std::derived_from<TestStep<TCPSender>> T>
@@ -90,6 +91,30 @@ struct ExpectReset : public ExpectBool<TCPSender>
   bool value( const TCPSender& sender ) const override { return sender.make_empty_message().RST; }
 };
 
+struct ExpectRTO : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "current_RTO_ms"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.current_RTO_ms(); }
+};
+
+struct ExpectSmoothedRTT : public ExpectNumber<TCPSender, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "smoothed_RTT_ms"; }
+  std::optional<uint64_t> value( const TCPSender& sender ) const override { return sender.smoothed_RTT_ms(); }
+};
+
+struct ExpectMsUntilRetransmission : public ExpectNumber<TCPSender, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "ms_until_retransmission"; }
+  std::optional<uint64_t> value( const TCPSender& sender ) const override
+  {
+    return sender.ms_until_retransmission();
+  }
+};
+
 struct ExpectSeqnosInFlight : public ExpectNumber<TCPSender, uint64_t>
 {
   using ExpectNumber::ExpectNumber;
@@ -222,7 +247,11 @@ struct Receive : public Action<SenderAndOutput>
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size;
+    if ( msg_.timestamp_echo.has_value() ) {
+      desc << ", TSecr=" << msg_.timestamp_echo.value();
+    }
+    desc << ")";
     if ( push_ ) {
       desc << ", then push";
     }
@@ -243,6 +272,12 @@ struct Receive : public Action<SenderAndOutput>
     }
   }
 
+  Receive& with_timestamp_echo( uint32_t tsecr )
+  {
+    msg_.timestamp_echo = tsecr;
+    return *this;
+  }
+
   Receive& without_push()
   {
     push_ = false;
@@ -283,8 +318,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<std::optional<uint32_t>> timestamp {};
 
-  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size ); }
+  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size or timestamp ); }
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -324,6 +360,18 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     return *this;
   }
 
+  ExpectMessage& with_timestamp( uint32_t timestamp_ )
+  {
+    timestamp = timestamp_;
+    return *this;
+  }
+
+  ExpectMessage& with_no_timestamp()
+  {
+    timestamp = std::optional<uint32_t> {};
+    return *this;
+  }
+
   ExpectMessage& with_data( std::string data_ )
   {
     data = std::move( data_ );
@@ -361,6 +409,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( rst.has_value() ) {
       o << ( rst.value() ? " +RST" : " -RST" );
     }
+    if ( timestamp.has_value() ) {
+      o << ( timestamp->has_value() ? " TSval=" + to_string( timestamp->value() ) : " (no timestamp)" );
+    }
     return o.str();
   }
 
@@ -400,6 +451,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( data.has_value() and data.value() != static_cast<std::string>( seg.payload ) ) {
       throw MessageExpectationViolation( seg, "payload", data.value(), static_cast<std::string>( seg.payload ) );
     }
+    if ( timestamp.has_value() and seg.timestamp != timestamp.value() ) {
+      throw MessageExpectationViolation( seg, "timestamp", timestamp.value(), seg.timestamp );
+    }
   }
 
   constexpr std::string obj() const override { return "TCPSender"; }
@@ -0,0 +1,93 @@
+#include "helpers.hh"
+#include "ipv4_header.hh"
+#include "random.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// A TCP message with random fields, flags, options and payload (empty, small, or larger than a GSO segment)
+TCPMessage random_message( default_random_engine& rd )
+{
+  const auto coin = [&] { return rd() % 2 == 0; };
+
+  TCPMessage msg;
+  msg.sender->seqno = Wrap32 { static_cast<uint32_t>( rd() ) };
+  msg.sender->SYN = coin();
+  msg.sender->FIN = coin();
+  msg.sender->RST = rd() % 8 == 0;
+  if ( coin() ) {
+    msg.sender->timestamp = static_cast<uint32_t>( rd() );
+  }
+
+  const size_t sizes[] = { 0, 1 + rd() % 64, 1 + rd() % 1460, 1 + rd() % 60000 };
+  msg.sender->payload.resize( sizes[rd() % 4] );
+  generate( msg.sender->payload.begin(), msg.sender->payload.end(), [&] { return static_cast<char>( rd() ); } );
+
+  if ( coin() ) {
+    msg.receiver->ackno = Wrap32 { static_cast<uint32_t>( rd() ) };
+  }
+  msg.receiver->window_size = static_cast<uint16_t>( rd() );
+  msg.receiver->RST = rd() % 8 == 0;
+  if ( coin() ) {
+    msg.receiver->timestamp_echo = static_cast<uint32_t>( rd() );
+  }
+  return msg;
+}
+
+FourTuple random_flow( default_random_engine& rd )
+{
+  return { .local_address = static_cast<uint32_t>( rd() ),
+           .local_port = static_cast<uint16_t>( rd() ),
+           .remote_address = static_cast<uint32_t>( rd() ),
+           .remote_port = static_cast<uint16_t>( rd() ) };
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    for ( unsigned int i = 0; i < 2000; ++i ) {
+      const TCPMessage msg = random_message( rd );
+      const FourTuple flow = random_flow( rd );
+
+      for ( const bool partial_checksum : { false, true } ) {
+        const string expected = concat( serialize( make_tcp_in_ip( msg, flow, partial_checksum ) ) );
+        const PacketBuffers actual = serialize_tcp_in_ip( msg, flow, partial_checksum );
+
+        // the same bytes as serializing the datagram built by make_tcp_in_ip()...
+        if ( concat( actual ) != expected ) {
+          throw runtime_error( string { "serialize_tcp_in_ip() differs from serialize( make_tcp_in_ip() )" }
+                               + ( partial_checksum ? " with a partial checksum" : "" ) + " (payload of "
+                               + to_string( msg.sender->payload.size() ) + " bytes)" );
+        }
+
+        // ... in one buffer, so that the headers' length (the TUN offload's hdr_len) is its size less the payload
+        test_should_be( actual.size(), uint64_t { 1 } );
+        const TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() } };
+        test_should_be( actual.front()->size() - msg.sender->payload.size(),
+                        uint64_t { IPv4Header::LENGTH } + seg.header_length() );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+#include "common.hh"
+#include "exception.hh"
+#include "helpers.hh"
+#include "ipv4_datagram.hh"
+#include "sharded_tcp_stack.hh"
+#include "socket.hh"
+#include "tcp_listener.hh"
+#include "tcp_over_ip.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A ShardedTCPStack on one end of a Unix-domain datagram socket pair, with the test playing the clients
+// on the other end, one segment at a time. A connection must only be handed to accept() once its
+// handshake has completed, whichever worker owns it.
+
+namespace {
+
+constexpr size_t WORKERS = 4;
+constexpr uint16_t FIRST_PORT = 1024;
+constexpr size_t CONNECTIONS = 8;
+
+const Address SERVER { "10.144.0.1", 80 };
+const Address CLIENT { "10.144.0.2", 0 };
+
+// The connection from a client port, as seen by the client
+FourTuple client_flow( const uint16_t port )
+{
+  return { .local_address = CLIENT.ipv4_numeric(),
+           .local_port = port,
+           .remote_address = SERVER.ipv4_numeric(),
+           .remote_port = SERVER.port() };
+}
+
+Wrap32 client_isn( const uint16_t port )
+{
+  return Wrap32 { 1000U * port };
+}
+
+string message_from( const uint16_t port )
+{
+  return "from port " + to_string( port );
+}
+
+// Read the next TCP segment from the wire, and the connection it belongs to (as seen by the client)
+TCPMessage receive( FileDescriptor& wire, FourTuple& flow )
+{
+  vector<string> buffers( 1 );
+  wire.read( buffers );
+  InternetDatagram dgram;
+  if ( not parse( dgram, move( buffers ) ) ) {
+    throw runtime_error( "the server sent a datagram that does not parse" );
+  }
+  auto msg = parse_tcp_in_ip( move( dgram ), flow );
+  if ( not msg.has_value() ) {
+    throw runtime_error( "the server sent a datagram that is not a TCP segment" );
+  }
+  return move( msg.value() );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    auto [server_wire, wire] = make_socket_pair();
+    ShardedTCPStack server_stack { server_wire.duplicate(), move( server_wire ), WORKERS };
+    TCPListener listener = server_stack.listen( TCPConfig {}, SERVER );
+
+    // the connections are spread over more than one worker
+    set<uint64_t> workers;
+    for ( uint16_t port = FIRST_PORT; port < FIRST_PORT + CONNECTIONS; port++ ) {
+      const FourTuple flow = client_flow( port );
+      const FourTuple server_side { .local_address = flow.remote_address,
+                                    .local_port = flow.remote_port,
+                                    .remote_address = flow.local_address,
+                                    .remote_port = flow.local_port };
+      workers.insert( server_side.hash() % WORKERS );
+    }
+    if ( workers.size() < 2 ) {
+      throw runtime_error( "the test's connections all belong to the same worker" );
+    }
+
+    // send each client's SYN
+    for ( uint16_t port = FIRST_PORT; port < FIRST_PORT + CONNECTIONS; port++ ) {
+      TCPMessage syn;
+      syn.sender->seqno = client_isn( port );
+      syn.sender->SYN = true;
+      syn.receiver->window_size = UINT16_MAX;
+      wire.write( serialize_tcp_in_ip( syn, client_flow( port ) ) );
+    }
+
+    // every SYN is answered with a SYN/ACK for its own connection...
+    map<uint16_t, Wrap32> server_isns;
+    while ( server_isns.size() < CONNECTIONS ) {
+      FourTuple flow;
+      const TCPMessage syn_ack = receive( wire, flow );
+      const uint16_t port = flow.local_port;
+      if ( port < FIRST_PORT or port >= FIRST_PORT + CONNECTIONS or flow != client_flow( port ) ) {
+        throw runtime_error( "the server answered a connection that nobody opened" );
+      }
+      if ( not syn_ack.sender->SYN or syn_ack.receiver->ackno != client_isn( port ) + 1 ) {
+        throw runtime_error( "the server answered a SYN with something other than a SYN/ACK" );
+      }
+      server_isns.emplace( port, syn_ack.sender->seqno );
+    }
+
+    // ... but until the handshakes complete, there is nothing to accept
+    this_thread::sleep_for( chrono::milliseconds( 100 ) );
+    if ( listener.try_accept().has_value() ) {
+      throw runtime_error( "accept() returned a connection whose handshake had not completed" );
+    }
+    if ( server_stack.connection_count() != CONNECTIONS ) {
+      throw runtime_error( "the server has " + to_string( server_stack.connection_count() )
+                           + " half-open connections instead of " + to_string( CONNECTIONS ) );
+    }
+
+    // complete each handshake with an ACK that also carries some data
+    for ( const auto& [port, server_isn] : server_isns ) {
+      TCPMessage ack;
+      ack.sender->seqno = client_isn( port ) + 1;
+      ack.sender->payload = message_from( port );
+      ack.receiver->ackno = server_isn + 1;
+      ack.receiver->window_size = UINT16_MAX;
+      wire.write( serialize_tcp_in_ip( ack, client_flow( port ) ) );
+    }
+
+    // now each connection can be accepted, and carries its own client's data
+    set<string> expected;
+    set<string> received;
+    for ( uint16_t port = FIRST_PORT; port < FIRST_PORT + CONNECTIONS; port++ ) {
+      expected.insert( message_from( port ) );
+
+      LocalStreamSocket server = listener.accept();
+      string data;
+      while ( data.size() < message_from( port ).size() ) {
+        string buffer;
+        server.read( buffer );
+        data += buffer;
+      }
+      received.insert( data );
+    }
+    if ( received != expected ) {
+      throw runtime_error( "the accepted connections did not each carry one client's data" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
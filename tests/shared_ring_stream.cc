@@ -0,0 +1,162 @@
+#include "byte_ring.hh"
+#include "common.hh"
+#include "exception.hh"
+#include "helpers.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_minnow_socket_impl.hh"
+#include "tcp_over_ip.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// ByteRing pushes that straddle the end of the ring, first directly and then end to end: two
+// TCPMinnowSockets in shared-ring mode, joined by a Unix-domain datagram socket pair, carry a stream
+// written in chunks that do not divide the ring's capacity.
+
+namespace {
+
+// Carries each IPv4 datagram in one datagram on a socket
+class DatagramSocketAdapter : public TCPOverIPv4Adapter
+{
+  FileDescriptor socket_;
+
+public:
+  explicit DatagramSocketAdapter( FileDescriptor&& socket ) : socket_( move( socket ) ) {}
+
+  optional<TCPMessage> read()
+  {
+    vector<string> buffers( 1 );
+    socket_.read( buffers );
+    InternetDatagram dgram;
+    if ( not parse( dgram, move( buffers ) ) ) {
+      return {};
+    }
+    return unwrap_tcp_in_ip( move( dgram ) );
+  }
+
+  void write( const TCPMessage& seg ) { socket_.write( serialize_tcp_in_ip( seg ) ); }
+
+  FileDescriptor& fd() { return socket_; }
+};
+
+using RingSocket = TCPMinnowSocket<DatagramSocketAdapter>;
+
+// The stream the client sends: long enough to go around the rings several times
+string stream_contents()
+{
+  string ret( 5 * TCPConfig::DEFAULT_CAPACITY + 123, 0 );
+  for ( size_t i = 0; i < ret.size(); i++ ) {
+    ret[i] = static_cast<char>( 'a' + ( i * 7 + i / 251 ) % 26 );
+  }
+  return ret;
+}
+
+void test_ring_wraps()
+{
+  ByteRing ring { 16 };
+  test_should_be( ring.push( "0123456789" ), uint64_t { 10 } );
+  ring.pop( 10 );
+
+  // twelve bytes from offset 10 of a 16-byte ring: six before the end, six from the start
+  test_should_be( ring.push( "abcdefghijkl" ), uint64_t { 12 } );
+  test_should_be( ring.bytes_buffered(), uint64_t { 12 } );
+  test_should_be( ring.peek() == "abcdef", true );
+  ring.pop( 4 );
+  test_should_be( ring.peek() == "ef", true );
+  ring.pop( 2 );
+  test_should_be( ring.peek() == "ghijkl", true );
+
+  // a push into a ring that is nearly full, wrapping again, copies only what fits
+  test_should_be( ring.push( "mnopqrstuvwxyz" ), uint64_t { 10 } );
+  test_should_be( ring.available_capacity(), uint64_t { 0 } );
+  test_should_be( ring.push( "z" ), uint64_t { 0 } );
+  string contents;
+  while ( ring.bytes_buffered() > 0 ) {
+    contents += ring.peek();
+    ring.pop( ring.peek().size() );
+  }
+  test_should_be( contents == "ghijklmnopqrstuv", true );
+}
+
+void test_stream_wraps()
+{
+  TCPConfig config;
+  config.rt_timeout = 100;
+
+  FdAdapterConfig server_ad;
+  server_ad.source = Address { "10.144.0.1", 80 };
+  FdAdapterConfig client_ad;
+  client_ad.source = Address { "10.144.0.2", 1024 };
+  client_ad.destination = server_ad.source;
+
+  const string sent = stream_contents();
+  string received;
+  string server_error;
+
+  auto [server_wire, client_wire] = make_socket_pair();
+  RingSocket server { DatagramSocketAdapter { move( server_wire ) }, true };
+  RingSocket client { DatagramSocketAdapter { move( client_wire ) }, true };
+
+  thread server_thread { [&] {
+    try {
+      server.listen_and_accept( config, server_ad );
+      SharedRingStream& stream = server.shared_rings();
+      while ( not stream.eof() ) {
+        string buffer;
+        stream.read( buffer );
+        received += buffer;
+      }
+      stream.shutdown_write();
+      server.wait_until_closed();
+    } catch ( const exception& e ) {
+      server_error = e.what();
+    }
+  } };
+
+  client.connect( config, client_ad );
+  SharedRingStream& stream = client.shared_rings();
+  constexpr size_t chunk_size = 999;
+  for ( string_view remaining = sent; not remaining.empty(); ) {
+    remaining.remove_prefix( stream.write( remaining.substr( 0, chunk_size ) ) );
+  }
+  stream.shutdown_write();
+
+  string buffer;
+  stream.read( buffer );
+  test_should_be( stream.eof(), true );
+  client.wait_until_closed();
+  server_thread.join();
+
+  if ( not server_error.empty() ) {
+    throw runtime_error( "server: " + server_error );
+  }
+  test_should_be( received.size(), uint64_t { sent.size() } );
+  test_should_be( received == sent, true );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_ring_wraps();
+    test_stream_wraps();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
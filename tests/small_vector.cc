@@ -0,0 +1,171 @@
+#include "small_vector.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// An element that counts how many of its kind are alive, to catch leaked or doubly-destroyed elements
+class Counted
+{
+  static inline int64_t live_ = 0;
+  string value_;
+
+public:
+  explicit Counted( string value ) : value_( move( value ) ) { ++live_; }
+  Counted( const Counted& other ) : value_( other.value_ ) { ++live_; }
+  Counted( Counted&& other ) noexcept : value_( move( other.value_ ) ) { ++live_; }
+  Counted& operator=( const Counted& other ) = default;
+  Counted& operator=( Counted&& other ) noexcept = default;
+  ~Counted() { --live_; }
+
+  const string& value() const { return value_; }
+  static uint64_t live() { return live_; }
+};
+
+using Vec = SmallVector<Counted, 2>;
+
+Vec make( const size_t n )
+{
+  Vec ret;
+  for ( size_t i = 0; i < n; ++i ) {
+    ret.emplace_back( to_string( i ) + " (long enough not to fit in a short string)" );
+  }
+  return ret;
+}
+
+bool holds( const Vec& v, const size_t n )
+{
+  if ( v.size() != n ) {
+    return false;
+  }
+  for ( size_t i = 0; i < n; ++i ) {
+    if ( v[i].value() != to_string( i ) + " (long enough not to fit in a short string)" ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    // elements stay inline up to N, then move to the heap as the vector grows
+    {
+      Vec v = make( 2 );
+      test_should_be( v.is_inline(), true );
+      test_should_be( v.capacity(), uint64_t { 2 } );
+      const Counted* const first = &v.front();
+      v.emplace_back( "2 (long enough not to fit in a short string)" );
+      test_should_be( v.is_inline(), false );
+      test_should_be( v.capacity() >= 3, true );
+      test_should_be( &v.front() != first, true );
+      test_should_be( holds( v, 3 ), true );
+      for ( size_t i = 3; i < 100; ++i ) {
+        v.emplace_back( to_string( i ) + " (long enough not to fit in a short string)" );
+      }
+      test_should_be( holds( v, 100 ), true );
+      test_should_be( Counted::live(), uint64_t { 100 } );
+    }
+    test_should_be( Counted::live(), uint64_t { 0 } );
+
+    // moving an inline vector moves its elements, leaving the source empty
+    {
+      Vec source = make( 2 );
+      Vec moved { move( source ) };
+      test_should_be( holds( moved, 2 ), true );
+      test_should_be( moved.is_inline(), true );
+      test_should_be( source.empty(), true ); // NOLINT(*-use-after-move)
+      test_should_be( Counted::live(), uint64_t { 2 } );
+
+      Vec assigned = make( 5 );
+      assigned = move( moved );
+      test_should_be( holds( assigned, 2 ), true );
+      test_should_be( assigned.is_inline(), true );
+      test_should_be( Counted::live(), uint64_t { 2 } );
+    }
+    test_should_be( Counted::live(), uint64_t { 0 } );
+
+    // moving a heap vector takes its storage
+    {
+      Vec source = make( 10 );
+      const Counted* const first = &source.front();
+      Vec moved { move( source ) };
+      test_should_be( &moved.front() == first, true );
+      test_should_be( holds( moved, 10 ), true );
+      test_should_be( source.empty(), true ); // NOLINT(*-use-after-move)
+      test_should_be( source.is_inline(), true );
+
+      Vec assigned = make( 1 );
+      assigned = move( moved );
+      test_should_be( &assigned.front() == first, true );
+      test_should_be( holds( assigned, 10 ), true );
+      test_should_be( Counted::live(), uint64_t { 10 } );
+    }
+    test_should_be( Counted::live(), uint64_t { 0 } );
+
+    // copy-assignment replaces the elements, inline or not
+    {
+      const Vec small = make( 1 );
+      const Vec large = make( 7 );
+      Vec v = make( 3 );
+      v = small;
+      test_should_be( holds( v, 1 ), true );
+      v = large;
+      test_should_be( holds( v, 7 ), true );
+      test_should_be( holds( large, 7 ), true );
+      v = small;
+      test_should_be( holds( v, 1 ), true );
+      test_should_be( Counted::live(), uint64_t { 1 + 7 + 1 } );
+
+      const Vec copy { large };
+      test_should_be( holds( copy, 7 ), true );
+    }
+    test_should_be( Counted::live(), uint64_t { 0 } );
+
+    // clear() and pop_back() destroy the elements they remove
+    {
+      Vec v = make( 6 );
+      v.pop_back();
+      test_should_be( holds( v, 5 ), true );
+      test_should_be( Counted::live(), uint64_t { 5 } );
+      v.clear();
+      test_should_be( v.empty(), true );
+      test_should_be( Counted::live(), uint64_t { 0 } );
+      v.emplace_back( "0 (long enough not to fit in a short string)" );
+      test_should_be( holds( v, 1 ), true );
+    }
+    test_should_be( Counted::live(), uint64_t { 0 } );
+
+    // conversions to and from std::vector move the elements
+    {
+      vector<Counted> elements;
+      elements.emplace_back( "0 (long enough not to fit in a short string)" );
+      elements.emplace_back( "1 (long enough not to fit in a short string)" );
+      elements.emplace_back( "2 (long enough not to fit in a short string)" );
+      Vec v { move( elements ) };
+      test_should_be( holds( v, 3 ), true );
+      test_should_be( Counted::live(), uint64_t { 3 } );
+      vector<Counted> back = move( v );
+      test_should_be( back.size(), uint64_t { 3 } );
+      test_should_be( back.at( 2 ).value() == "2 (long enough not to fit in a short string)", true );
+      test_should_be( Counted::live(), uint64_t { 3 } );
+    }
+    test_should_be( Counted::live(), uint64_t { 0 } );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
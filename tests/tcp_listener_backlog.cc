@@ -0,0 +1,88 @@
+#include "common.hh"
+#include "exception.hh"
+#include "socket.hh"
+#include "tcp_listener.hh"
+#include "tcp_stack.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Two TCPStacks joined by a Unix-domain datagram socket pair. More clients
+// connect than the listener's backlog admits: the SYNs beyond it are dropped until accept() makes room,
+// and then the clients' retransmitted SYNs get through.
+
+int main()
+{
+  try {
+    constexpr size_t backlog = 2;
+    constexpr size_t connections = 5;
+
+    auto [server_wire, client_wire] = make_socket_pair();
+    TCPStack server_stack { server_wire.duplicate(), move( server_wire ) };
+    TCPStack client_stack { client_wire.duplicate(), move( client_wire ) };
+
+    TCPConfig config;
+    config.rt_timeout = 100;
+
+    const Address server_address { "10.144.0.1", 80 };
+    TCPListener listener = server_stack.listen( config, server_address, backlog );
+
+    vector<LocalStreamSocket> clients;
+    set<string> messages;
+    for ( size_t i = 0; i < connections; i++ ) {
+      FdAdapterConfig c_ad;
+      c_ad.source = Address { "10.144.0.2", static_cast<uint16_t>( 1024 + i ) };
+      c_ad.destination = server_address;
+      clients.push_back( client_stack.connect( config, c_ad ) );
+
+      const string message = "from " + c_ad.source.to_string();
+      clients.back().write( message );
+      clients.back().shutdown( SHUT_WR );
+      messages.insert( message );
+    }
+
+    // long enough for every client to have sent (and resent) its SYN: only the backlog's worth get a connection
+    this_thread::sleep_for( chrono::milliseconds( 500 ) );
+    if ( server_stack.connection_count() != backlog ) {
+      throw runtime_error( "with nothing accepted yet, the server has "
+                           + to_string( server_stack.connection_count() ) + " connections instead of the backlog's "
+                           + to_string( backlog ) );
+    }
+    if ( client_stack.connection_count() != connections ) {
+      throw runtime_error( to_string( connections - client_stack.connection_count() ) + " clients gave up" );
+    }
+
+    // each accept() makes room in the backlog for another client's retransmitted SYN
+    set<string> received;
+    for ( size_t i = 0; i < connections; i++ ) {
+      LocalStreamSocket server = listener.accept();
+      received.insert( read_all( server ) );
+      server.shutdown( SHUT_WR );
+    }
+    if ( received != messages ) {
+      throw runtime_error( "the server did not receive each client's message once" );
+    }
+
+    for ( auto& client : clients ) {
+      if ( not read_all( client ).empty() ) {
+        throw runtime_error( "a client received bytes from the server" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
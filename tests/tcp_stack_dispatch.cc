@@ -0,0 +1,93 @@
+#include "common.hh"
+#include "exception.hh"
+#include "socket.hh"
+#include "tcp_listener.hh"
+#include "tcp_stack.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Two TCPStacks joined by a Unix-domain datagram socket pair, carrying
+// connections whose four-tuples differ in only one field. Each connection must deliver its own bytes
+// to its own peer, in both directions.
+
+int main()
+{
+  try {
+    auto [server_wire, client_wire] = make_socket_pair();
+    TCPStack server_stack { server_wire.duplicate(), move( server_wire ) };
+    TCPStack client_stack { client_wire.duplicate(), move( client_wire ) };
+
+    TCPConfig config;
+    config.rt_timeout = 100;
+
+    const Address server_80 { "10.144.0.1", 80 };
+    const Address server_81 { "10.144.0.1", 81 };
+    TCPListener listener_80 = server_stack.listen( config, server_80 );
+    TCPListener listener_81 = server_stack.listen( config, server_81 );
+
+    // the first connection, then ones that differ from it in the client port, the client address,
+    // and the server port
+    const vector<pair<Address, Address>> flows { { Address { "10.144.0.2", 1024 }, server_80 },
+                                                 { Address { "10.144.0.2", 1025 }, server_80 },
+                                                 { Address { "10.144.0.3", 1024 }, server_80 },
+                                                 { Address { "10.144.0.2", 1024 }, server_81 } };
+
+    vector<LocalStreamSocket> clients;
+    vector<string> messages;
+    for ( const auto& [source, destination] : flows ) {
+      FdAdapterConfig c_ad;
+      c_ad.source = source;
+      c_ad.destination = destination;
+      clients.push_back( client_stack.connect( config, c_ad ) );
+
+      messages.push_back( "from " + source.to_string() + " to " + destination.to_string() );
+      clients.back().write( messages.back() );
+      clients.back().shutdown( SHUT_WR );
+    }
+
+    // each server connection echoes what its client sent, which says which listener it should have reached
+    map<string, size_t> received;
+    const auto serve = [&]( TCPListener& listener, const Address& local ) {
+      LocalStreamSocket server = listener.accept();
+      const string message = read_all( server );
+      if ( not message.ends_with( " to " + local.to_string() ) ) {
+        throw runtime_error( "listener on " + local.to_string() + " accepted a connection that sent \"" + message
+                             + "\"" );
+      }
+      ++received[message];
+      server.write( "echo: " + message );
+      server.shutdown( SHUT_WR );
+    };
+    for ( size_t i = 0; i < 3; i++ ) {
+      serve( listener_80, server_80 );
+    }
+    serve( listener_81, server_81 );
+
+    for ( size_t i = 0; i < clients.size(); i++ ) {
+      if ( received[messages[i]] != 1 ) {
+        throw runtime_error( "the server received \"" + messages[i] + "\" " + to_string( received[messages[i]] )
+                             + " times" );
+      }
+
+      const string reply = read_all( clients[i] );
+      if ( reply != "echo: " + messages[i] ) {
+        throw runtime_error( "the client that sent \"" + messages[i] + "\" got back \"" + reply + "\"" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
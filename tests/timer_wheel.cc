@@ -0,0 +1,143 @@
+#include "random.hh"
+#include "test_should_be.hh"
+#include "timer_wheel.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Advance `wheel` by `ms`, returning the values of the timers that fired (in the order they fired)
+vector<uint64_t> run_for( TimerWheel<uint64_t>& wheel, const uint64_t ms )
+{
+  vector<uint64_t> fired;
+  wheel.advance( ms, [&]( uint64_t&& value ) { fired.push_back( value ); } );
+  return fired;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    // deadlines more than once around the wheel (1024 slots) fire on time, not when their slot first comes up
+    {
+      TimerWheel<uint64_t> wheel;
+      wheel.schedule_in( 1500, 1500 );
+      wheel.schedule_in( 476, 476 ); // shares a slot with the 1500 ms timer
+      wheel.schedule_in( 5000, 5000 );
+      wheel.schedule_in( 2548, 2548 ); // two revolutions later than 476 and 1500
+
+      vector<pair<uint64_t, uint64_t>> fired; // (time, value)
+      while ( wheel.now() < 6000 ) {
+        for ( const uint64_t value : run_for( wheel, 1 ) ) {
+          fired.emplace_back( wheel.now(), value );
+        }
+      }
+
+      const vector<pair<uint64_t, uint64_t>> expected {
+        { 476, 476 }, { 1500, 1500 }, { 2548, 2548 }, { 5000, 5000 } };
+      test_should_be( fired == expected, true );
+      test_should_be( wheel.pending(), uint64_t { 0 } );
+    }
+
+    // ... including when the clock moves in steps that skip over their slots
+    {
+      TimerWheel<uint64_t> wheel;
+      wheel.schedule_in( 3000, 3000 );
+      test_should_be( run_for( wheel, 1023 ).empty(), true );
+      test_should_be( run_for( wheel, 1500 ).empty(), true );
+      test_should_be( run_for( wheel, 476 ).empty(), true );
+      test_should_be( run_for( wheel, 1 ) == vector<uint64_t> { 3000 }, true );
+    }
+
+    // a cancelled timer never fires, and cancelling a timer that already fired has no effect
+    {
+      TimerWheel<uint64_t> wheel;
+      const auto a = wheel.schedule_in( 10, 1 );
+      const auto b = wheel.schedule_in( 2000, 2 );
+      wheel.schedule_in( 20, 3 );
+      test_should_be( wheel.pending(), uint64_t { 3 } );
+      wheel.cancel( b );
+      test_should_be( wheel.pending(), uint64_t { 2 } );
+      test_should_be( run_for( wheel, 10 ) == vector<uint64_t> { 1 }, true );
+      wheel.cancel( a );
+      test_should_be( wheel.pending(), uint64_t { 1 } );
+      test_should_be( run_for( wheel, 5000 ) == vector<uint64_t> { 3 }, true );
+      test_should_be( wheel.pending(), uint64_t { 0 } );
+    }
+
+    // rescheduling (cancel, then schedule anew) moves a timer earlier or later
+    {
+      TimerWheel<uint64_t> wheel;
+      const auto later = wheel.schedule_in( 100, 1 );
+      const auto earlier = wheel.schedule_in( 3000, 2 );
+      wheel.cancel( later );
+      wheel.schedule_in( 2500, 1 );
+      wheel.cancel( earlier );
+      wheel.schedule_in( 50, 2 );
+
+      test_should_be( run_for( wheel, 50 ) == vector<uint64_t> { 2 }, true );
+      test_should_be( run_for( wheel, 2449 ).empty(), true );
+      test_should_be( run_for( wheel, 1 ) == vector<uint64_t> { 1 }, true );
+      test_should_be( run_for( wheel, 1000 ).empty(), true );
+    }
+
+    // a deadline in the past fires on the next advance, even if that advance is by zero
+    {
+      TimerWheel<uint64_t> wheel;
+      run_for( wheel, 5000 );
+      wheel.schedule_at( 100, 7 );
+      test_should_be( run_for( wheel, 0 ) == vector<uint64_t> { 7 }, true );
+    }
+
+    // one large advance fires every due timer in deadline order (ties in the order they were scheduled)
+    for ( const uint64_t granularity_ms : { 1, 7 } ) {
+      auto rd = get_random_engine();
+      TimerWheel<uint64_t> wheel { granularity_ms, 64 };
+      run_for( wheel, rd() % 1000 );
+
+      vector<pair<uint64_t, uint64_t>> timers; // (deadline, value)
+      for ( uint64_t value = 0; value < 5000; ++value ) {
+        const uint64_t deadline = wheel.now() + rd() % 20000;
+        wheel.schedule_at( deadline, value );
+        timers.emplace_back( deadline, value );
+      }
+      stable_sort(
+        timers.begin(), timers.end(), []( const auto& x, const auto& y ) { return x.first < y.first; } );
+
+      const uint64_t cutoff = wheel.now() + 10000;
+      vector<uint64_t> expected;
+      for ( const auto& [deadline, value] : timers ) {
+        if ( deadline <= cutoff ) {
+          expected.push_back( value );
+        }
+      }
+
+      test_should_be( run_for( wheel, 10000 ) == expected, true );
+      test_should_be( wheel.pending(), uint64_t { timers.size() - expected.size() } );
+
+      expected.clear();
+      for ( const auto& [deadline, value] : timers ) {
+        if ( deadline > cutoff ) {
+          expected.push_back( value );
+        }
+      }
+      test_should_be( run_for( wheel, 10000 ) == expected, true );
+      test_should_be( wheel.pending(), uint64_t { 0 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
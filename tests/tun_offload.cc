@@ -0,0 +1,122 @@
+#include "common.hh"
+#include "exception.hh"
+#include "socket.hh"
+#include "tcp_minnow_socket_impl.hh"
+#include "tuntap_adapter.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+
+using namespace std;
+
+// A TCPMinnowSocket on a TUN device opened with TCP offload (see tun_offload_t.sh, which creates the
+// device) sends a few megabytes to a kernel TCP socket, which then sends back a megabyte of them,
+// scrambled. The kernel sends coalesced segments larger than a read buffer, with checksums left for
+// TunTapFD::read to complete, and is left the checksums of the segments written. (The download is the
+// smaller, as the TCPPeer sends no window update when its application reads, so each window of it waits
+// for one of the kernel's zero-window probes.)
+
+namespace {
+
+constexpr size_t UPLOAD_SIZE = 4 << 20;
+constexpr size_t DOWNLOAD_SIZE = 1 << 20;
+
+// Bytes that differ along the stream (so that a misplaced or corrupted run shows)
+string stream_contents()
+{
+  string ret( UPLOAD_SIZE, 0 );
+  uint32_t x = 1;
+  for ( auto& c : ret ) {
+    x = x * 1664525 + 1013904223;
+    c = static_cast<char>( x >> 24U );
+  }
+  return ret;
+}
+
+// What the server sends back for `data`
+string scrambled( string data )
+{
+  data.resize( min( data.size(), DOWNLOAD_SIZE ) );
+  for ( auto& c : data ) {
+    c = static_cast<char>( c ^ 0x5a );
+  }
+  return data;
+}
+
+void check_stream( const string& what, const string& received, const string& expected )
+{
+  if ( received.size() != expected.size() ) {
+    throw runtime_error( what + " carried " + to_string( received.size() ) + " bytes instead of "
+                         + to_string( expected.size() ) );
+  }
+  const auto [mismatch, unused] = ranges::mismatch( received, expected );
+  if ( mismatch != received.end() ) {
+    throw runtime_error( what + " differs from what was sent, first at byte "
+                         + to_string( mismatch - received.begin() ) );
+  }
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc != 2 ) {
+      cerr << "Usage: " << argv[0] << " TUN_DEVICE\n"; // NOLINT(*-pointer-arithmetic)
+      return EXIT_FAILURE;
+    }
+    const string tun_name = argv[1]; // NOLINT(*-pointer-arithmetic)
+
+    const Address server_address { "169.254.151.1", 8151 };
+    TCPSocket listener;
+    listener.set_reuseaddr();
+    listener.bind( server_address );
+    listener.listen();
+
+    const string upload = stream_contents();
+    string server_received;
+    string server_error;
+    thread server_thread { [&] {
+      try {
+        TCPSocket server = listener.accept();
+        server_received = read_all( server );
+        server.write( scrambled( server_received ) );
+      } catch ( const exception& e ) {
+        server_error = e.what();
+      }
+    } };
+
+    TCPConfig config;
+    config.rt_timeout = 100;
+    FdAdapterConfig c_ad;
+    c_ad.source = Address { "169.254.151.9", 1234 };
+    c_ad.destination = server_address;
+
+    TCPOverIPv4MinnowSocket client { TCPOverIPv4OverTunFdAdapter { TunFD { tun_name, true } } };
+    client.connect( config, c_ad );
+    client.set_blocking( true ); // so that the write below waits, rather than falls short
+    client.write( upload );
+    client.shutdown( SHUT_WR );
+    const string client_received = read_all( client );
+    client.wait_until_closed();
+    server_thread.join();
+
+    if ( not server_error.empty() ) {
+      throw runtime_error( "server: " + server_error );
+    }
+    check_stream( "the upload", server_received, upload );
+    check_stream( "the download", client_received, scrambled( upload ) );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
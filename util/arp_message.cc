@@ -1,6 +1,7 @@
 #include "arp_message.hh"
 
 #include <arpa/inet.h>
+#include <array>
 #include <sstream>
 
 using namespace std;
@@ -31,11 +32,17 @@ string ARPMessage::to_string() const
 
 void ARPMessage::parse( Parser& parser )
 {
-  parser.integer( hardware_type );
-  parser.integer( protocol_type );
-  parser.integer( hardware_address_size );
-  parser.integer( protocol_address_size );
-  parser.integer( opcode );
+  array<char, LENGTH> scratch {};
+  FixedParser fixed { parser.peek_fixed( scratch ) };
+  if ( parser.has_error() ) {
+    return;
+  }
+
+  fixed.integer( hardware_type );
+  fixed.integer( protocol_type );
+  fixed.integer( hardware_address_size );
+  fixed.integer( protocol_address_size );
+  fixed.integer( opcode );
 
   if ( not supported() ) {
     parser.set_error();
@@ -44,15 +51,16 @@ void ARPMessage::parse( Parser& parser )
 
   // read sender addresses (Ethernet and IP)
   for ( auto& b : sender_ethernet_address ) {
-    parser.integer( b );
+    fixed.integer( b );
   }
-  parser.integer( sender_ip_address );
+  fixed.integer( sender_ip_address );
 
   // read target addresses (Ethernet and IP)
   for ( auto& b : target_ethernet_address ) {
-    parser.integer( b );
+    fixed.integer( b );
   }
-  parser.integer( target_ip_address );
+  fixed.integer( target_ip_address );
+  parser.remove_prefix( LENGTH );
 }
 
 void ARPMessage::serialize( Serializer& serializer ) const
@@ -0,0 +1,95 @@
+#include "buffer_pool.hh"
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// set when this thread's pools are destroyed, so later Ref destructors (e.g. of other thread_local
+// objects) free their strings instead
+thread_local bool pools_destroyed = false;
+
+struct Pools
+{
+  vector<string> small {};
+  vector<string> large {};
+  uint64_t misses {};
+
+  Pools()
+  {
+    // reserved up front, so recycling never allocates (or throws)
+    small.reserve( BufferPool::MAX_SMALL_BUFFERS );
+    large.reserve( BufferPool::MAX_LARGE_BUFFERS );
+  }
+
+  ~Pools() { pools_destroyed = true; }
+
+  Pools( const Pools& other ) = delete;
+  Pools& operator=( const Pools& other ) = delete;
+  Pools( Pools&& other ) = delete;
+  Pools& operator=( Pools&& other ) = delete;
+};
+
+Pools& pools()
+{
+  thread_local Pools pools;
+  return pools;
+}
+
+string take( vector<string> Pools::*pool, const size_t capacity )
+{
+  if ( not pools_destroyed ) {
+    Pools& p = pools();
+    if ( not( p.*pool ).empty() ) {
+      string ret = move( ( p.*pool ).back() );
+      ( p.*pool ).pop_back();
+      return ret;
+    }
+    ++p.misses;
+  }
+
+  string ret;
+  ret.reserve( capacity );
+  return ret;
+}
+
+} // namespace
+
+string BufferPool::small()
+{
+  return take( &Pools::small, SMALL_CAPACITY );
+}
+
+string BufferPool::large()
+{
+  return take( &Pools::large, LARGE_CAPACITY );
+}
+
+void BufferPool::recycle( string&& buffer ) noexcept
+{
+  const size_t capacity = buffer.capacity();
+  if ( capacity < SMALL_CAPACITY or pools_destroyed ) {
+    return;
+  }
+
+  // a much larger string would waste memory while pooled
+  Pools& p = pools();
+  if ( capacity >= LARGE_CAPACITY and capacity < 2 * LARGE_CAPACITY ) {
+    if ( p.large.size() < MAX_LARGE_BUFFERS ) {
+      buffer.clear();
+      p.large.push_back( move( buffer ) );
+    }
+  } else if ( capacity < 2 * SMALL_CAPACITY ) {
+    if ( p.small.size() < MAX_SMALL_BUFFERS ) {
+      buffer.clear();
+      p.small.push_back( move( buffer ) );
+    }
+  }
+}
+
+uint64_t BufferPool::misses()
+{
+  return pools_destroyed ? 0 : pools().misses;
+}
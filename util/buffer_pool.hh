@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//! \brief Per-thread pools of packet buffers (std::strings) in two fixed capacities
+//! \details A buffer taken from a pool has room for a packet header (small) or a whole datagram as read
+//! by FileDescriptor::read (large). When an owning Ref<std::string> is destroyed, it gives its string
+//! back to the pool of the thread destroying it, if the string's capacity fits a pool, so buffers
+//! circulate between reading, parsing and serializing without going through malloc. Each pool holds
+//! a bounded number of buffers; the rest are freed as usual.
+class BufferPool
+{
+public:
+  static constexpr size_t SMALL_CAPACITY = 128;   //!< e.g. an Ethernet, IPv4 or TCP header
+  static constexpr size_t LARGE_CAPACITY = 16384; //!< FileDescriptor::kReadBufferSize
+  static constexpr size_t MAX_SMALL_BUFFERS = 1024;
+  static constexpr size_t MAX_LARGE_BUFFERS = 256;
+
+  //! An empty string with a capacity of at least SMALL_CAPACITY bytes
+  static std::string small();
+
+  //! An empty string with a capacity of at least LARGE_CAPACITY bytes
+  static std::string large();
+
+  //! Keep `buffer` for reuse if its capacity fits one of the pools (and that pool is not full)
+  static void recycle( std::string&& buffer ) noexcept;
+
+  //! Number of buffers this thread has allocated because a pool was empty
+  static uint64_t misses();
+};
@@ -0,0 +1,123 @@
+#include "byte_ring.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+ByteRing::ByteRing( size_t capacity )
+  : capacity_( bit_ceil( max<size_t>( capacity, 1 ) ) ), buffer_( make_unique<char[]>( capacity_ ) )
+{}
+
+// The counters are accessed with sequentially consistent operations: each side stores its own counter
+// and then loads the other's, so at least one side sees the other's update and no wake-up is lost.
+
+size_t ByteRing::push( string_view data )
+{
+  const uint64_t pushed = bytes_pushed_.load( memory_order_relaxed );
+  const size_t len = min( data.size(), capacity_ - static_cast<size_t>( pushed - bytes_popped_.load() ) );
+  if ( len == 0 ) {
+    return 0;
+  }
+
+  const size_t index = pushed & ( capacity_ - 1 );
+  const size_t first = min( len, capacity_ - index );
+  memcpy( buffer_.get() + index, data.data(), first );
+  memcpy( buffer_.get(), data.data() + first, len - first );
+  bytes_pushed_.store( pushed + len );
+
+  if ( bytes_popped_.load() == pushed ) {
+    readable_.notify(); // the consumer had caught up, so it may be waiting
+  }
+  return len;
+}
+
+void ByteRing::close()
+{
+  closed_.store( true );
+  readable_.notify();
+}
+
+void ByteRing::set_error()
+{
+  error_.store( true );
+  close();
+  writable_.notify(); // a blocked producer needs to see the error too
+}
+
+size_t ByteRing::available_capacity() const
+{
+  return capacity_ - bytes_buffered();
+}
+
+string_view ByteRing::peek() const
+{
+  const uint64_t popped = bytes_popped_.load( memory_order_relaxed );
+  const size_t index = popped & ( capacity_ - 1 );
+  const size_t len = min( static_cast<size_t>( bytes_pushed_.load() - popped ), capacity_ - index );
+  return { buffer_.get() + index, len };
+}
+
+void ByteRing::pop( size_t len )
+{
+  const uint64_t popped = bytes_popped_.load( memory_order_relaxed );
+  if ( len > bytes_pushed_.load() - popped ) {
+    throw runtime_error( "ByteRing::pop: not enough bytes buffered" );
+  }
+  bytes_popped_.store( popped + len );
+
+  if ( len > 0 and bytes_pushed_.load() - popped >= capacity_ ) {
+    writable_.notify(); // the ring was full, so the producer may be waiting
+  }
+}
+
+size_t ByteRing::bytes_buffered() const
+{
+  return bytes_pushed_.load() - bytes_popped_.load();
+}
+
+SharedRingStream::SharedRingStream( size_t capacity )
+  : outbound_( make_unique<ByteRing>( capacity ) ), inbound_( make_unique<ByteRing>( capacity ) )
+{}
+
+size_t SharedRingStream::write( string_view buffer )
+{
+  while ( not buffer.empty() ) {
+    if ( outbound_->has_error() ) {
+      throw runtime_error( "SharedRingStream: write to a stream that has failed" );
+    }
+    if ( const size_t len = outbound_->push( buffer ) ) {
+      return len;
+    }
+    outbound_->writable().wait();
+  }
+  return 0;
+}
+
+void SharedRingStream::read( string& buffer )
+{
+  if ( buffer.empty() ) {
+    buffer.resize( 16384 );
+  }
+
+  while ( true ) {
+    const string_view available = inbound_->peek();
+    if ( not available.empty() ) {
+      const size_t len = min( buffer.size(), available.size() );
+      memcpy( buffer.data(), available.data(), len );
+      inbound_->pop( len );
+      buffer.resize( len );
+      return;
+    }
+
+    if ( inbound_->is_finished() ) {
+      eof_ = true;
+      buffer.clear();
+      return;
+    }
+
+    inbound_->readable().wait();
+  }
+}
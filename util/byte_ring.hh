@@ -0,0 +1,98 @@
+#pragma once
+
+#include "eventfd.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+//! \brief A lock-free single-producer, single-consumer ring of bytes shared between two threads
+//! \details Pushing is a memcpy plus an atomic store. The eventfds are only written on transitions, so
+//! a steady stream of data costs no system calls:
+//!
+//! - readable() is notified when the ring goes from empty to non-empty, or is closed
+//! - writable() is notified when the ring goes from full to not full
+//!
+//! A consumer that leaves bytes in the ring (e.g. because its destination is full) and then waits
+//! for readable() must call readable().notify() itself, since no transition will do it.
+class ByteRing
+{
+public:
+  //! \param[in] capacity is rounded up to a power of two
+  explicit ByteRing( size_t capacity );
+
+  //! \name Producer side
+  //!@{
+  size_t push( std::string_view data ); //!< Copy as much of `data` as fits; returns the number of bytes copied
+  void close();                         //!< Signal that no more bytes will be pushed
+  void set_error();                     //!< Signal that the stream failed (also closes it)
+  size_t available_capacity() const;
+  //!@}
+
+  //! \name Consumer side
+  //!@{
+  std::string_view peek() const; //!< The next contiguous run of buffered bytes
+  void pop( size_t len );        //!< Remove `len` bytes from the front of the ring
+  size_t bytes_buffered() const;
+  bool is_closed() const { return closed_.load(); }
+  bool is_finished() const { return is_closed() and bytes_buffered() == 0; }
+  bool has_error() const { return error_.load(); }
+  //!@}
+
+  EventFD& readable() { return readable_; }
+  EventFD& writable() { return writable_; }
+
+private:
+  size_t capacity_;
+  std::unique_ptr<char[]> buffer_; // NOLINT(*-avoid-c-arrays)
+
+  // keep the producer's and consumer's counters on separate cache lines
+  alignas( 64 ) std::atomic<uint64_t> bytes_pushed_ { 0 };
+  alignas( 64 ) std::atomic<uint64_t> bytes_popped_ { 0 };
+
+  std::atomic_bool closed_ { false };
+  std::atomic_bool error_ { false };
+
+  EventFD readable_ {};
+  EventFD writable_ {};
+};
+
+//! \brief The application's end of a connection whose byte streams are carried by two ByteRings
+//! \details This is the shared-memory alternative to the LocalStreamSocket that TCPMinnowSocket normally
+//! hands to the application: reads and writes are memcpys that only enter the kernel to block or to
+//! wake the other thread.
+class SharedRingStream
+{
+public:
+  explicit SharedRingStream( size_t capacity );
+
+  //! Write some of `buffer`, blocking until there is room for at least one byte
+  //! \returns the number of bytes written (0 only if `buffer` is empty)
+  size_t write( std::string_view buffer );
+
+  //! Read the available bytes (up to the size of `buffer`, or 16 kB if empty), blocking until there
+  //! are some or the stream has ended; `buffer` is empty at EOF
+  void read( std::string& buffer );
+
+  //! Has the inbound stream ended (and been entirely read)?
+  bool eof() const { return eof_; }
+
+  //! Close the outbound stream, like shutdown(SHUT_WR)
+  void shutdown_write() { outbound_->close(); }
+
+  //! \name
+  //! Rings as seen by the TCPPeer thread
+
+  //!@{
+  ByteRing& outbound() { return *outbound_; } //!< application to network
+  ByteRing& inbound() { return *inbound_; }   //!< network to application
+  //!@}
+
+private:
+  std::unique_ptr<ByteRing> outbound_;
+  std::unique_ptr<ByteRing> inbound_;
+  bool eof_ {};
+};
@@ -0,0 +1,139 @@
+#include "checksum.hh"
+
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Fold a sum of 16-bit words into 16 bits with end-around carry
+uint16_t fold( uint64_t sum )
+{
+  while ( sum > 0xffff ) {
+    sum = ( sum & 0xffff ) + ( sum >> 16 );
+  }
+  return static_cast<uint16_t>( sum );
+}
+
+// Sum the 32-bit words that start at `*data`, in host byte order, leaving fewer than four bytes unsummed.
+// Each word is added to a 64-bit accumulator, so no carries are lost (for any buffer under 16 GiB).
+uint64_t sum_words_scalar( const char*& data, size_t& length )
+{
+  uint64_t a = 0;
+  uint64_t b = 0;
+  for ( ; length >= 8; length -= 8, data += 8 ) { // NOLINT(*-pointer-arithmetic)
+    uint32_t x {};
+    uint32_t y {};
+    memcpy( &x, data, 4 );
+    memcpy( &y, data + 4, 4 ); // NOLINT(*-pointer-arithmetic)
+    a += x;
+    b += y;
+  }
+  for ( ; length >= 4; length -= 4, data += 4 ) { // NOLINT(*-pointer-arithmetic)
+    uint32_t x {};
+    memcpy( &x, data, 4 );
+    a += x;
+  }
+  return a + b;
+}
+
+#if defined( __x86_64__ )
+// NOLINTBEGIN(*-reinterpret-cast, *-pointer-arithmetic)
+
+// 16 bytes at a time: the four 32-bit words are widened into two pairs of 64-bit lanes (SSE2 is part of x86-64)
+uint64_t sum_words_sse2( const char*& data, size_t& length )
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero;
+  __m128i b = zero;
+  for ( ; length >= 16; length -= 16, data += 16 ) {
+    const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );
+    a = _mm_add_epi64( a, _mm_unpacklo_epi32( v, zero ) );
+    b = _mm_add_epi64( b, _mm_unpackhi_epi32( v, zero ) );
+  }
+  a = _mm_add_epi64( a, b );
+  return static_cast<uint64_t>( _mm_cvtsi128_si64( a ) )
+         + static_cast<uint64_t>( _mm_cvtsi128_si64( _mm_unpackhi_epi64( a, a ) ) )
+         + sum_words_scalar( data, length );
+}
+
+// 32 bytes at a time, likewise
+[[gnu::target( "avx2" )]] uint64_t sum_words_avx2( const char*& data, size_t& length )
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i a = zero;
+  __m256i b = zero;
+  for ( ; length >= 32; length -= 32, data += 32 ) {
+    const __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+    a = _mm256_add_epi64( a, _mm256_unpacklo_epi32( v, zero ) );
+    b = _mm256_add_epi64( b, _mm256_unpackhi_epi32( v, zero ) );
+  }
+  a = _mm256_add_epi64( a, b );
+  const __m128i pairs = _mm_add_epi64( _mm256_castsi256_si128( a ), _mm256_extracti128_si256( a, 1 ) );
+  return static_cast<uint64_t>( _mm_cvtsi128_si64( pairs ) )
+         + static_cast<uint64_t>( _mm_cvtsi128_si64( _mm_unpackhi_epi64( pairs, pairs ) ) )
+         + sum_words_scalar( data, length );
+}
+
+// NOLINTEND(*-reinterpret-cast, *-pointer-arithmetic)
+#endif
+
+uint64_t sum_words( const char*& data, size_t& length )
+{
+#if defined( __x86_64__ )
+  static const bool have_avx2 = __builtin_cpu_supports( "avx2" );
+  return have_avx2 ? sum_words_avx2( data, length ) : sum_words_sse2( data, length );
+#else
+  return sum_words_scalar( data, length );
+#endif
+}
+
+} // namespace
+
+void InternetChecksum::add( string_view data )
+{
+  if ( data.empty() ) {
+    return;
+  }
+
+  // a byte at an odd offset is the low byte of its (big-endian) word
+  if ( parity_ ) {
+    sum_ += static_cast<uint8_t>( data.front() );
+    data.remove_prefix( 1 );
+    parity_ = false;
+  }
+
+  const char* next = data.data();
+  size_t length = data.size();
+  words_ += sum_words( next, length );
+
+  if ( length >= 2 ) {
+    uint16_t word {};
+    memcpy( &word, next, 2 );
+    words_ += word;
+    next += 2; // NOLINT(*-pointer-arithmetic)
+    length -= 2;
+  }
+
+  // a trailing byte at an even offset is the high byte of its word
+  if ( length == 1 ) {
+    const auto byte = static_cast<uint8_t>( *next );
+    words_ += endian::native == endian::little ? byte : uint16_t( byte << 8 );
+    parity_ = true;
+  }
+}
+
+uint16_t InternetChecksum::value() const
+{
+  uint16_t words = fold( words_ );
+  if constexpr ( endian::native == endian::little ) {
+    words = static_cast<uint16_t>( words << 8 | words >> 8 );
+  }
+  return static_cast<uint16_t>( ~fold( sum_ + words ) );
+}
@@ -1,41 +1,48 @@
 #pragma once
 
+#include <concepts>
 #include <cstdint>
 #include <ranges>
+#include <string_view>
 
-//! The internet checksum algorithm
+//! \brief The internet checksum algorithm
+//! \details The data is summed a word at a time (with SIMD where the CPU has it), in the host's byte order;
+//! the one's-complement sum of byte-swapped words is the byte-swapped sum, so the order is fixed up once,
+//! in value(). Consecutive calls to add() continue the same sequence, even after an odd number of bytes.
 class InternetChecksum
 {
 private:
-  uint32_t sum_;
-  bool parity_ {};
+  uint64_t sum_;      // the initial value, plus any byte that began an add() at an odd offset
+  uint64_t words_ {}; // host-order sum of the words that began at even offsets
+  bool parity_ {};    // has an odd number of bytes been added so far?
 
 public:
   explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
-  void add( std::string_view data )
+
+  void add( std::string_view data );
+
+  uint16_t value() const;
+
+  //! \brief Adjust `checksum` for one 16-bit word of the data changing from `old_word` to `new_word`
+  //! \details Computed as in [RFC 1624](https://www.rfc-editor.org/rfc/rfc1624) (eqn. 3), without summing
+  //! the rest of the data.
+  static uint16_t update( const uint16_t checksum, const uint16_t old_word, const uint16_t new_word )
   {
-    for ( const uint8_t i : data ) {
-      uint16_t val = i;
-      if ( not parity_ ) {
-        val <<= 8;
-      }
-      sum_ += val;
-      parity_ = !parity_;
-    }
+    uint32_t sum = uint32_t { static_cast<uint16_t>( ~checksum ) } + static_cast<uint16_t>( ~old_word ) + new_word;
+    sum = ( sum & 0xffff ) + ( sum >> 16 );
+    sum = ( sum & 0xffff ) + ( sum >> 16 );
+    return static_cast<uint16_t>( ~sum );
   }
 
-  uint16_t value() const
+  //! Adjust `checksum` for a 32-bit field (two aligned words) changing from `old_value` to `new_value`
+  static uint16_t update32( const uint16_t checksum, const uint32_t old_value, const uint32_t new_value )
   {
-    uint32_t ret = sum_;
-
-    while ( ret > 0xffff ) {
-      ret = ( ret >> 16 ) + static_cast<uint16_t>( ret );
-    }
-
-    return ~ret;
+    const uint16_t high = update( checksum, old_value >> 16, new_value >> 16 );
+    return update( high, static_cast<uint16_t>( old_value ), static_cast<uint16_t>( new_value ) );
   }
 
   void add( std::ranges::range auto&& data )
+    requires( not std::convertible_to<decltype( data ), std::string_view> )
   {
     for ( const auto& x : data ) {
       add( std::string_view { x } );
@@ -8,7 +8,7 @@
 struct EthernetFrame
 {
   EthernetHeader header {};
-  std::vector<Ref<std::string>> payload {};
+  PacketBuffers payload {};
 
   void parse( Parser& parser )
   {
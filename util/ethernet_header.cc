@@ -1,5 +1,6 @@
 #include "ethernet_header.hh"
 
+#include <array>
 #include <iomanip>
 #include <sstream>
 
@@ -43,18 +44,25 @@ string EthernetHeader::to_string() const
 
 void EthernetHeader::parse( Parser& parser )
 {
+  array<char, LENGTH> scratch {};
+  FixedParser fixed { parser.peek_fixed( scratch ) };
+  if ( parser.has_error() ) {
+    return;
+  }
+
   // read destination address
   for ( auto& b : dst ) {
-    parser.integer( b );
+    fixed.integer( b );
   }
 
   // read source address
   for ( auto& b : src ) {
-    parser.integer( b );
+    fixed.integer( b );
   }
 
   // read frame type (e.g. IPv4, ARP, or something else)
-  parser.integer( type );
+  fixed.integer( type );
+  parser.remove_prefix( LENGTH );
 }
 
 void EthernetHeader::serialize( Serializer& serializer ) const
@@ -0,0 +1,32 @@
+#include "eventfd.hh"
+
+#include "exception.hh"
+
+#include <cstdint>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/eventfd.h>
+
+using namespace std;
+
+EventFD::EventFD() : FileDescriptor( ::CheckSystemCall( "eventfd", ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) ) {}
+
+void EventFD::notify()
+{
+  const uint64_t one = 1;
+  write( string_view { reinterpret_cast<const char*>( &one ), sizeof( one ) } ); // NOLINT(*-reinterpret-cast)
+}
+
+void EventFD::consume()
+{
+  string buffer( sizeof( uint64_t ), 0 );
+  read( buffer );
+}
+
+void EventFD::wait()
+{
+  pollfd pfd { fd_num(), POLLIN, 0 };
+  ::CheckSystemCall( "poll", ::poll( &pfd, 1, -1 ) );
+  consume();
+}
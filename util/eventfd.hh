@@ -0,0 +1,20 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+//! A FileDescriptor to a Linux [eventfd](\ref man2::eventfd) counter, used for cross-thread wake-ups
+class EventFD : public FileDescriptor
+{
+public:
+  //! Create a non-blocking eventfd with a counter of zero
+  EventFD();
+
+  //! Add one to the counter, making the eventfd readable
+  void notify();
+
+  //! Reset the counter to zero (no effect if it is already zero)
+  void consume();
+
+  //! Block until the counter is nonzero, then reset it
+  void wait();
+};
@@ -1,17 +1,156 @@
 #include "eventloop.hh"
 #include "exception.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <string_view>
 #include <sys/socket.h>
+#include <unistd.h>
 
 using namespace std;
 
+namespace {
+
+atomic<unsigned> next_loop_id {};
+
+// incremented by the SIGUSR1 handler; each loop that dumps on signal compares it with the count it last saw
+atomic<uint64_t> dump_requests {};
+static_assert( atomic<uint64_t>::is_always_lock_free, "needed for use in a signal handler" );
+
+void request_dump( int /* signal */ )
+{
+  dump_requests.fetch_add( 1, memory_order_relaxed );
+}
+
+// MINNOW_EVENTLOOP_STATS, read (and the SIGUSR1 handler installed) by the first EventLoop
+optional<EventLoop::StatsFormat> stats_format_from_environment()
+{
+  static const optional<EventLoop::StatsFormat> format = [] {
+    const char* const setting = getenv( "MINNOW_EVENTLOOP_STATS" ); // NOLINT(*-mt-unsafe)
+    if ( setting == nullptr or setting[0] == '\0' or setting == "0"sv ) {
+      return optional<EventLoop::StatsFormat> {};
+    }
+
+    struct sigaction action {};
+    action.sa_handler = request_dump;
+    action.sa_flags = SA_RESTART;
+    sigemptyset( &action.sa_mask );
+    CheckSystemCall( "sigaction", sigaction( SIGUSR1, &action, nullptr ) );
+
+    return optional { setting == "json"sv ? EventLoop::StatsFormat::Json : EventLoop::StatsFormat::Text };
+  }();
+  return format;
+}
+
+} // namespace
+
 unsigned int EventLoop::FDRule::service_count() const
 {
   return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
 
+void EventLoop::FDRule::notify_cancel() const
+{
+  if ( cancel ) {
+    cancel();
+  }
+}
+
+void EventLoop::FDRule::notify_error() const
+{
+  if ( error ) {
+    error();
+  }
+}
+
+template<class RuleT>
+RuleT* EventLoop::SlotTable<RuleT>::find( const uint64_t id )
+{
+  const auto index = static_cast<uint32_t>( id );
+  if ( index >= slots.size() ) {
+    return nullptr;
+  }
+  Slot& slot = slots[index];
+  if ( not slot.rule.has_value() or id != SlotTable::id( index, slot.generation ) ) {
+    return nullptr;
+  }
+  return &slot.rule.value();
+}
+
+template<class RuleT>
+RuleT& EventLoop::SlotTable<RuleT>::emplace( RuleT&& rule )
+{
+  uint32_t index {};
+  if ( free_slots.empty() ) {
+    index = static_cast<uint32_t>( slots.size() );
+    slots.emplace_back(); // unlike a vector, this leaves the other rules where they are
+  } else {
+    index = free_slots.back();
+    free_slots.pop_back();
+  }
+
+  Slot& slot = slots[index];
+  RuleT& stored = slot.rule.emplace( move( rule ) );
+  stored.id = id( index, slot.generation );
+  return stored;
+}
+
+template<class RuleT>
+void EventLoop::SlotTable<RuleT>::erase( const RuleT& rule )
+{
+  const auto index = static_cast<uint32_t>( rule.id );
+  Slot& slot = slots[index];
+  slot.rule.reset();
+  ++slot.generation;
+  free_slots.push_back( index );
+}
+
+void EventLoop::RuleTable::request_recheck( const uint64_t id )
+{
+  FDRule* const rule = find( id );
+  if ( rule and rule->backend_fd.has_value() and not rule->recheck_pending ) { // only epoll and io_uring
+    rule->recheck_pending = true;
+    interest_changed.push_back( id );
+  }
+}
+
+EventLoop::EventLoop( const Backend backend ) : _backend( backend ), _loop_id( next_loop_id++ )
+{
+  _rule_categories.reserve( 64 );
+
+  _signal_dump_format = stats_format_from_environment();
+  if ( _signal_dump_format.has_value() ) {
+    _stats_enabled = true;
+    _dump_requests_seen = dump_requests.load( memory_order_relaxed );
+  }
+
+  if ( _backend == Backend::IoUring ) {
+    try {
+      _uring = make_unique<IoUring>( 256 );
+    } catch ( const exception& e ) {
+      cerr << "Warning: " << e.what() << "; EventLoop falling back to epoll\n";
+      _backend = Backend::Epoll;
+    }
+  }
+
+  if ( _backend == Backend::Epoll ) {
+    const int epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+    if ( epoll_fd < 0 ) {
+      cerr << "Warning: epoll_create1 failed (" << strerror( errno ) << "); EventLoop falling back to poll\n";
+      _backend = Backend::Poll;
+    } else {
+      _epoll.emplace( epoll_fd );
+    }
+  }
+}
+
 size_t EventLoop::add_category( const string& name )
 {
   if ( _rule_categories.size() >= _rule_categories.capacity() ) {
@@ -41,39 +180,377 @@ EventLoop::FDRule::FDRule( BasicRule&& base,
 EventLoop::RuleHandle EventLoop::add_rule( size_t category_id,
                                            FileDescriptor& fd,
                                            Direction direction,
-                                           const CallbackT& callback,
-                                           const InterestT& interest,
-                                           const CallbackT& cancel, // NOLINT(*-easily-swappable-*)
-                                           const CallbackT& error )
+                                           CallbackT callback,
+                                           InterestT interest,
+                                           CallbackT cancel, // NOLINT(*-easily-swappable-*)
+                                           CallbackT error )
+{
+  if ( category_id >= _rule_categories.size() ) {
+    throw out_of_range( "bad category_id" );
+  }
+
+  FDRule& rule = _fd_rules->emplace( FDRule { BasicRule { category_id, move( interest ), move( callback ) },
+                                              fd.duplicate(),
+                                              direction,
+                                              move( cancel ),
+                                              move( error ) } );
+  rule.order = _next_rule_order++;
+
+  if ( _backend != Backend::Poll ) {
+    register_rule( rule );
+  }
+
+  return RuleHandle { _fd_rules, rule.id };
+}
+
+EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id, CallbackT callback, InterestT interest )
 {
   if ( category_id >= _rule_categories.size() ) {
     throw out_of_range( "bad category_id" );
   }
 
-  _fd_rules.emplace_back( make_shared<FDRule>(
-    BasicRule { category_id, interest, callback }, fd.duplicate(), direction, cancel, error ) );
+  const BasicRule& rule = _non_fd_rules->emplace( BasicRule { category_id, move( interest ), move( callback ) } );
+  _non_fd_rules->order.push_back( static_cast<uint32_t>( rule.id ) );
 
-  return RuleHandle { _fd_rules.back() };
+  return RuleHandle { _non_fd_rules, rule.id };
 }
 
-EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id,
-                                           const CallbackT& callback,
-                                           const InterestT& interest )
+EventLoop::TimerHandle EventLoop::add_timer( const size_t category_id, CallbackT callback )
 {
   if ( category_id >= _rule_categories.size() ) {
     throw out_of_range( "bad category_id" );
   }
 
-  _non_fd_rules.emplace_back( make_shared<BasicRule>( category_id, interest, callback ) );
+  if ( not _timerfd.has_value() ) {
+    _timerfd.emplace();
+    _timerfd_rule = add_rule(
+      add_category( "run due timers" ),
+      *_timerfd,
+      Direction::In,
+      [&] { run_due_timers(); },
+      [&] { return _timers->scheduled > 0; } );
+  }
 
-  return RuleHandle { _non_fd_rules.back() };
+  const TimerRule& rule = _timers->rules.emplace( TimerRule { category_id, move( callback ) } );
+  return TimerHandle { _timers, rule.id };
+}
+
+EventLoop::TimerRule* EventLoop::TimerQueue::find( const uint64_t id )
+{
+  TimerRule* const rule = rules.find( id );
+  return rule and not rule->cancel_requested ? rule : nullptr;
+}
+
+void EventLoop::TimerQueue::schedule( TimerRule& rule, const TimePoint deadline )
+{
+  if ( rule.deadline == deadline ) {
+    return;
+  }
+  if ( not rule.deadline.has_value() ) {
+    ++scheduled;
+  }
+  rule.deadline = deadline;
+  ++rule.generation;
+
+  // rescheduling leaves stale entries behind; rebuild the heap before they outnumber the live ones
+  if ( heap.size() >= 2 * scheduled + 64 ) {
+    erase_if( heap, [&]( const Entry& e ) {
+      const TimerRule* const r = rules.find( e.id );
+      return not r or r->generation != e.generation;
+    } );
+    ranges::make_heap( heap, greater {}, &Entry::deadline );
+  }
+
+  heap.push_back( { deadline, rule.generation, rule.id } );
+  ranges::push_heap( heap, greater {}, &Entry::deadline );
+  changed = true;
+}
+
+void EventLoop::TimerQueue::unschedule( TimerRule& rule )
+{
+  if ( rule.deadline.has_value() ) {
+    rule.deadline.reset();
+    ++rule.generation;
+    --scheduled;
+    changed = true;
+  }
+}
+
+void EventLoop::TimerQueue::pop_stale()
+{
+  while ( not heap.empty() ) {
+    const TimerRule* const rule = rules.find( heap.front().id );
+    if ( rule and rule->generation == heap.front().generation ) {
+      return;
+    }
+    ranges::pop_heap( heap, greater {}, &Entry::deadline );
+    heap.pop_back();
+  }
+}
+
+void EventLoop::TimerQueue::erase_cancelled()
+{
+  for ( const uint64_t id : cancelled ) {
+    if ( const TimerRule* const rule = rules.find( id ) ) {
+      rules.erase( *rule ); // its heap entries expire with it
+    }
+  }
+  cancelled.clear();
+}
+
+void EventLoop::TimerHandle::set( const TimePoint deadline )
+{
+  if ( const auto queue = queue_.lock() ) {
+    if ( TimerRule* const rule = queue->find( id_ ) ) {
+      queue->schedule( *rule, deadline );
+    }
+  }
+}
+
+void EventLoop::TimerHandle::clear()
+{
+  if ( const auto queue = queue_.lock() ) {
+    if ( TimerRule* const rule = queue->find( id_ ) ) {
+      queue->unschedule( *rule );
+    }
+  }
+}
+
+void EventLoop::TimerHandle::cancel()
+{
+  if ( const auto queue = queue_.lock() ) {
+    if ( TimerRule* const rule = queue->find( id_ ) ) {
+      queue->unschedule( *rule );
+      rule->cancel_requested = true; // the callback may be running, so erase the rule at the next wait
+      queue->cancelled.push_back( id_ );
+    }
+  }
+}
+
+optional<EventLoop::TimePoint> EventLoop::TimerHandle::deadline() const
+{
+  if ( const auto queue = queue_.lock() ) {
+    if ( const TimerRule* const rule = queue->find( id_ ) ) {
+      return rule->deadline;
+    }
+  }
+  return {};
+}
+
+void EventLoop::run_due_timers()
+{
+  _timerfd->consume();
+  _timerfd_deadline.reset(); // a timerfd fires once
+
+  // collect the due timers first, so a callback that sets a deadline in the past cannot starve the loop
+  const auto now = chrono::steady_clock::now();
+  for ( _timers->pop_stale(); not _timers->heap.empty() and _timers->heap.front().deadline <= now;
+        _timers->pop_stale() ) {
+    TimerRule& rule = *_timers->rules.find( _timers->heap.front().id );
+    _timers->unschedule( rule );
+    _due_timers.emplace_back( rule.id, rule.generation );
+  }
+  _timers->changed = true;
+
+  for ( const auto& [id, generation] : _due_timers ) {
+    // an earlier callback may have rescheduled or cancelled this timer (a cancelled one has unscheduled)
+    const TimerRule* const rule = _timers->rules.find( id );
+    if ( rule and rule->generation == generation ) {
+      run_callback( rule->category_id, rule->callback );
+    }
+  }
+  _due_timers.clear();
+}
+
+void EventLoop::arm_timerfd()
+{
+  _timers->erase_cancelled();
+  if ( not _timerfd.has_value() or not _timers->changed ) {
+    return;
+  }
+  _timers->changed = false;
+  _timerfd_rule->interest_changed(); // the number of scheduled timers may have changed
+
+  _timers->pop_stale();
+  const optional<TimePoint> earliest
+    = _timers->heap.empty() ? optional<TimePoint> {} : optional<TimePoint> { _timers->heap.front().deadline };
+  if ( earliest == _timerfd_deadline ) {
+    return;
+  }
+
+  if ( earliest.has_value() ) {
+    _timerfd->set( *earliest );
+  } else {
+    _timerfd->disarm();
+  }
+  _timerfd_deadline = earliest;
 }
 
 void EventLoop::RuleHandle::cancel()
 {
-  const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
-  if ( rule_shared_ptr ) {
-    rule_shared_ptr->cancel_requested = true;
+  if ( const auto non_fd_table = non_fd_table_.lock() ) {
+    if ( BasicRule* const non_fd_rule = non_fd_table->find( id_ ) ) {
+      non_fd_rule->cancel_requested = true; // erased by wait_next_event
+    }
+  }
+
+  const auto table = table_.lock();
+  FDRule* const rule = table ? table->find( id_ ) : nullptr;
+  if ( rule and not rule->cancel_requested ) {
+    rule->cancel_requested = true;
+    table->cancelled.push_back( id_ );
+  }
+}
+
+void EventLoop::RuleHandle::interest_changed()
+{
+  if ( const auto table = table_.lock() ) {
+    table->request_recheck( id_ );
+  }
+}
+
+void EventLoop::report_error( const FDRule& rule ) const
+{
+  /* see if fd is a socket */
+  int socket_error = 0;
+  socklen_t optlen = sizeof( socket_error );
+  const int ret = getsockopt( rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
+  if ( ret == -1 and errno == ENOTSOCK ) {
+    cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( rule.category_id ).name << "\"\n";
+  } else if ( ret == -1 ) {
+    throw unix_error( "getsockopt" );
+  } else if ( optlen != sizeof( socket_error ) ) {
+    throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
+  } else if ( socket_error ) {
+    cerr << "error on polled socket for rule \"" << _rule_categories.at( rule.category_id ).name
+         << "\": " << strerror( socket_error ) << "\n";
+  }
+}
+
+void EventLoop::CategoryStats::record( const chrono::nanoseconds duration )
+{
+  ++callbacks;
+  total_time += duration;
+  max_time = max( max_time, duration );
+
+  // buckets grow by powers of 4 from 1 us
+  const auto us = static_cast<uint64_t>( chrono::duration_cast<chrono::microseconds>( duration ).count() );
+  const size_t bucket = us == 0 ? 0 : 1 + ( bit_width( us ) - 1 ) / 2;
+  ++histogram.at( min( bucket, HISTOGRAM_BUCKETS - 1 ) );
+}
+
+void EventLoop::run_timed_callback( const size_t category_id, const CallbackT& callback )
+{
+  const auto start = chrono::steady_clock::now();
+  callback();
+  _rule_categories[category_id].stats.record( chrono::steady_clock::now() - start );
+}
+
+void EventLoop::count_spurious( const FDRule& rule )
+{
+  if ( _stats_enabled ) {
+    ++_rule_categories[rule.category_id].stats.spurious;
+  }
+}
+
+void EventLoop::wait_finished( const TimePoint started )
+{
+  if ( _stats_enabled ) {
+    ++_stats.waits;
+    _stats.wait_time += chrono::steady_clock::now() - started;
+  }
+}
+
+void EventLoop::check_dump_request()
+{
+  if ( _signal_dump_format.has_value() ) {
+    const uint64_t requests = dump_requests.load( memory_order_relaxed );
+    if ( requests != _dump_requests_seen ) {
+      _dump_requests_seen = requests;
+      dump_stats( cerr, *_signal_dump_format );
+    }
+  }
+}
+
+static string_view backend_name( const EventLoop::Backend backend )
+{
+  switch ( backend ) {
+    case EventLoop::Backend::Epoll:
+      return "epoll";
+    case EventLoop::Backend::IoUring:
+      return "io_uring";
+    default:
+      return "poll";
+  }
+}
+
+// quote a category name for JSON
+static string json_string( const string_view s )
+{
+  string ret = "\"";
+  for ( const char c : s ) {
+    if ( c == '"' or c == '\\' ) {
+      ret += '\\';
+      ret += c;
+    } else if ( static_cast<unsigned char>( c ) < 0x20 ) {
+      ret += "\\u00";
+      ret += "0123456789abcdef"[( c >> 4 ) & 0xf];
+      ret += "0123456789abcdef"[c & 0xf];
+    } else {
+      ret += c;
+    }
+  }
+  return ret + "\"";
+}
+
+void EventLoop::dump_stats( ostream& out, const StatsFormat format ) const
+{
+  constexpr array<string_view, CategoryStats::HISTOGRAM_BUCKETS> bucket_names {
+    "<1us", "<4us", "<16us", "<64us", "<256us", "<1024us", "<4096us", ">=4096us" };
+  const auto ns = []( const chrono::nanoseconds d ) { return d.count(); };
+  const auto ms = []( const chrono::nanoseconds d ) { return chrono::duration<double, milli>( d ).count(); };
+  const auto us = []( const chrono::nanoseconds d ) { return chrono::duration<double, micro>( d ).count(); };
+
+  if ( format == StatsFormat::Json ) {
+    out << R"({"loop":)" << _loop_id << R"(,"backend":")" << backend_name( _backend ) << R"(","waits":)"
+        << _stats.waits << R"(,"wait_ns":)" << ns( _stats.wait_time ) << R"(,"timeouts":)" << _stats.timeouts
+        << R"(,"spurious_wakeups":)" << _stats.spurious_wakeups << R"(,"categories":[)";
+    for ( size_t i = 0; i < _rule_categories.size(); ++i ) {
+      const auto& [name, stats] = _rule_categories[i];
+      out << ( i ? "," : "" ) << R"({"name":)" << json_string( name ) << R"(,"callbacks":)" << stats.callbacks
+          << R"(,"total_ns":)" << ns( stats.total_time ) << R"(,"max_ns":)" << ns( stats.max_time )
+          << R"(,"spurious":)" << stats.spurious << R"(,"histogram":{)";
+      for ( size_t b = 0; b < bucket_names.size(); ++b ) {
+        out << ( b ? "," : "" ) << '"' << bucket_names.at( b ) << R"(":)" << stats.histogram.at( b );
+      }
+      out << "}}";
+    }
+    out << "]}\n";
+    return;
+  }
+
+  out << fixed << setprecision( 2 ) << "EventLoop " << _loop_id << " (" << backend_name( _backend )
+      << "): " << _stats.waits << " waits, " << ms( _stats.wait_time ) << " ms waiting, " << _stats.timeouts
+      << " timeouts, " << _stats.spurious_wakeups << " spurious wakeups\n";
+  for ( const auto& [name, stats] : _rule_categories ) {
+    out << "  \"" << name << "\": " << stats.callbacks << " callbacks, " << ms( stats.total_time )
+        << " ms total, " << us( stats.max_time ) << " us max, " << stats.spurious << " spurious;";
+    for ( size_t b = 0; b < bucket_names.size(); ++b ) {
+      out << " " << bucket_names.at( b ) << ":" << stats.histogram.at( b );
+    }
+    out << "\n";
+  }
+  out << defaultfloat;
+}
+
+void EventLoop::serve( FDRule& rule )
+{
+  const auto count_before = rule.service_count();
+  run_callback( rule.category_id, rule.callback );
+
+  if ( count_before == rule.service_count() and ( not rule.fd.closed() ) and rule.interested() ) {
+    throw runtime_error( "EventLoop: busy wait detected: rule \"" + _rule_categories.at( rule.category_id ).name
+                         + "\" did not read/write fd and is still interested" );
   }
 }
 
@@ -81,19 +558,28 @@ void EventLoop::RuleHandle::cancel()
 // NOLINTBEGIN(*-signed-bitwise)
 EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 {
+  check_dump_request();
+  arm_timerfd();
+  _callbacks_this_wait = 0;
+
+  bool non_fd_rule_fired = false;
+
   // first, handle the non-file-descriptor-related rules
   {
-    for ( auto it = _non_fd_rules.begin(); it != _non_fd_rules.end(); ) {
-      auto& this_rule = **it;
+    // by index: a callback may add a rule
+    vector<uint32_t>& order = _non_fd_rules->order;
+    for ( size_t i = 0; i < order.size(); ) {
+      auto& this_rule = _non_fd_rules->slots[order[i]].rule.value();
       bool rule_fired = false;
 
       if ( this_rule.cancel_requested ) {
-        it = _non_fd_rules.erase( it );
+        _non_fd_rules->erase( this_rule );
+        order.erase( order.begin() + static_cast<ptrdiff_t>( i ) );
         continue;
       }
 
       uint8_t iterations = 0;
-      while ( this_rule.interest() ) {
+      while ( this_rule.interested() ) {
         if ( iterations++ >= 128 ) {
           throw runtime_error( "EventLoop: busy wait detected: rule \""
                                + _rule_categories.at( this_rule.category_id ).name + "\" is still interested after "
@@ -101,56 +587,157 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
         }
 
         rule_fired = true;
-        this_rule.callback();
+        run_callback( this_rule.category_id, this_rule.callback );
       }
 
-      if ( rule_fired ) {
+      if ( rule_fired and _dispatch == Dispatch::One ) {
         return Result::Success; /* only serve one rule on each iteration */
       }
 
-      ++it;
+      non_fd_rule_fired |= rule_fired;
+      ++i;
+    }
+  }
+
+  // now the file-descriptor-related rules (without blocking if a non-fd rule already did some work)
+  const int fd_timeout_ms = non_fd_rule_fired ? 0 : timeout_ms;
+  Result result {};
+  switch ( _backend ) {
+    case Backend::Epoll:
+      result = wait_next_event_epoll( fd_timeout_ms );
+      break;
+    case Backend::IoUring:
+      result = wait_next_event_io_uring( fd_timeout_ms );
+      break;
+    default:
+      result = wait_next_event_poll( fd_timeout_ms );
+  }
+
+  if ( _stats_enabled and not non_fd_rule_fired ) {
+    if ( result == Result::Timeout ) {
+      ++_stats.timeouts;
+    } else if ( result == Result::Success and _callbacks_this_wait == 0 ) {
+      ++_stats.spurious_wakeups;
+    }
+  }
+
+  return non_fd_rule_fired ? Result::Success : result;
+}
+
+void EventLoop::set_dispatch( const Dispatch dispatch, const size_t max_per_round )
+{
+  if ( max_per_round == 0 ) {
+    throw invalid_argument( "EventLoop::set_dispatch: max_per_round must be positive" );
+  }
+  _dispatch = dispatch;
+  _max_per_round = max_per_round;
+  _resume_after.reset();
+}
+
+void EventLoop::sort_and_serve_ready()
+{
+  if ( _dispatch == Dispatch::One and not _ready.empty() ) {
+    // only the earliest matters
+    iter_swap( _ready.begin(), min_element( _ready.begin(), _ready.end(), []( const FDRule* a, const FDRule* b ) {
+                 return a->order < b->order;
+               } ) );
+  } else {
+    sort( _ready.begin(), _ready.end(), []( const FDRule* a, const FDRule* b ) { return a->order < b->order; } );
+  }
+  serve_ready();
+}
+
+void EventLoop::serve_ready()
+{
+  if ( _ready.empty() ) {
+    return;
+  }
+
+  if ( _dispatch == Dispatch::One ) {
+    // a callback run while the wait's results were examined (cancel or error) may have cancelled it
+    if ( not _ready.front()->cancel_requested ) {
+      serve( *_ready.front() ); /* only serve one rule on each iteration */
+    } else {
+      count_spurious( *_ready.front() );
+    }
+    return;
+  }
+
+  // if the last round was cut short, start with the rules it left out
+  if ( _resume_after.has_value() ) {
+    const auto first_left_out = partition_point(
+      _ready.begin(), _ready.end(), [&]( const FDRule* r ) { return r->order <= *_resume_after; } );
+    rotate( _ready.begin(), first_left_out, _ready.end() );
+    _resume_after.reset();
+  }
+
+  size_t served = 0;
+  for ( FDRule* rule : _ready ) {
+    if ( served == _max_per_round ) {
+      break;
+    }
+
+    // an earlier callback may have cancelled this rule, closed its fd or taken away its interest
+    if ( rule->cancel_requested or rule->fd.closed() or not rule->interested() ) {
+      count_spurious( *rule );
+      continue;
+    }
+
+    serve( *rule );
+    ++served;
+    if ( served == _max_per_round and rule != _ready.back() ) {
+      _resume_after = rule->order;
     }
   }
+}
+
+EventLoop::Result EventLoop::wait_next_event_poll( const int timeout_ms )
+{
+  RuleTable& table = *_fd_rules;
+  table.cancelled.clear(); // the scan below finds cancelled rules by itself
 
-  // now the file-descriptor-related rules. poll any "interested" file descriptors
-  vector<pollfd> pollfds {};
-  pollfds.reserve( _fd_rules.size() );
+  // poll any "interested" file descriptors
+  _pollfds.clear();
+  _polled.clear();
   bool something_to_poll = false;
 
-  // set up the pollfd for each rule
-  for ( auto it = _fd_rules.begin(); it != _fd_rules.end(); ) { // NOTE: it gets erased or incremented in loop body
-    auto& this_rule = **it;
+  // set up the pollfd for each rule (by index: a cancellation callback may add a rule)
+  for ( size_t i = 0; i < table.slots.size(); ++i ) {
+    if ( not table.slots[i].rule.has_value() ) {
+      continue;
+    }
+    auto& this_rule = table.slots[i].rule.value();
 
     if ( this_rule.cancel_requested ) {
       //      this_rule.cancel();
       //      if rule is cancelled externally, no need to call the cancellation callback
       //      this makes it easier to cancel rules and delete captured objects right away
-      it = _fd_rules.erase( it );
+      table.erase( this_rule );
       continue;
     }
 
     if ( this_rule.direction == Direction::In && this_rule.fd.eof() ) {
       // no more reading on this rule, it's reached eof
-      this_rule.cancel();
-      it = _fd_rules.erase( it );
+      this_rule.notify_cancel();
+      table.erase( this_rule );
       continue;
     }
 
     if ( this_rule.fd.closed() ) {
-      this_rule.cancel();
-      it = _fd_rules.erase( it );
+      this_rule.notify_cancel();
+      table.erase( this_rule );
       continue;
     }
 
-    if ( this_rule.interest() ) {
-      pollfds.push_back( { this_rule.fd.fd_num(),
-                           static_cast<int16_t>( this_rule.direction == Direction::In ? POLLIN : POLLOUT ),
-                           0 } );
+    if ( this_rule.interested() ) {
+      _pollfds.push_back( { this_rule.fd.fd_num(),
+                            static_cast<int16_t>( this_rule.direction == Direction::In ? POLLIN : POLLOUT ),
+                            0 } );
       something_to_poll = true;
     } else {
-      pollfds.push_back( { this_rule.fd.fd_num(), 0, 0 } ); // placeholder --- we still want errors
+      _pollfds.push_back( { this_rule.fd.fd_num(), 0, 0 } ); // placeholder --- we still want errors
     }
-    ++it;
+    _polled.push_back( &this_rule );
   }
 
   // quit if there is nothing left to poll
@@ -159,36 +746,43 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
   }
 
   // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
-  if ( 0 == CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), timeout_ms ) ) ) {
-    return Result::Timeout;
+  const auto deadline = chrono::steady_clock::now() + chrono::milliseconds( timeout_ms );
+  int remaining_ms = timeout_ms;
+  while ( true ) {
+    const auto started = wait_started();
+    const int ready_count = ::poll( _pollfds.data(), _pollfds.size(), remaining_ms );
+    wait_finished( started );
+
+    if ( ready_count == 0 ) {
+      return Result::Timeout;
+    }
+    if ( ready_count > 0 ) {
+      break;
+    }
+    if ( errno != EINTR ) {
+      throw unix_error( "poll" );
+    }
+
+    // interrupted by a signal (e.g. a request to dump the stats): wait out the rest of the timeout
+    check_dump_request();
+    if ( timeout_ms >= 0 ) {
+      const auto remaining = chrono::ceil<chrono::milliseconds>( deadline - chrono::steady_clock::now() );
+      remaining_ms = static_cast<int>( max<int64_t>( remaining.count(), 0 ) );
+    }
   }
 
   // go through the poll results
-  for ( auto [it, idx] = make_pair( _fd_rules.begin(), static_cast<size_t>( 0 ) ); it != _fd_rules.end(); ++idx ) {
-    const auto& this_pollfd = pollfds.at( idx );
-    auto& this_rule = **it;
+  _ready.clear();
+  for ( size_t idx = 0; idx < _polled.size(); ++idx ) {
+    const auto& this_pollfd = _pollfds[idx];
+    auto& this_rule = *_polled[idx];
 
     const auto poll_error = static_cast<bool>( this_pollfd.revents & ( POLLERR | POLLNVAL ) );
     if ( poll_error ) {
-      /* see if fd is a socket */
-      int socket_error = 0;
-      socklen_t optlen = sizeof( socket_error );
-      const int ret = getsockopt( this_rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
-      if ( ret == -1 and errno == ENOTSOCK ) {
-        cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\"\n";
-      } else if ( ret == -1 ) {
-        throw unix_error( "getsockopt" );
-      } else if ( optlen != sizeof( socket_error ) ) {
-        throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
-      } else if ( socket_error ) {
-        cerr << "error on polled socket for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\": " << strerror( socket_error ) << "\n";
-      }
-
-      this_rule.error();
-      this_rule.cancel();
-      it = _fd_rules.erase( it );
+      report_error( this_rule );
+      this_rule.notify_error();
+      this_rule.notify_cancel();
+      table.erase( this_rule );
       continue;
     }
 
@@ -199,28 +793,347 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
       //   - if it was POLLIN and nothing is readable, no more will ever be readable
       //   - if it was POLLOUT, it will not be writable again
       // additionally, consider FD defunct if rule will only query for Direction::Out
-      this_rule.cancel();
-      it = _fd_rules.erase( it );
+      this_rule.notify_cancel();
+      table.erase( this_rule );
       continue;
     }
 
     if ( poll_ready ) {
       // we only want to call callback if revents includes the event we asked for
-      const auto count_before = this_rule.service_count();
-      this_rule.callback();
+      _ready.push_back( &this_rule );
+    }
+  }
 
-      if ( count_before == this_rule.service_count() and ( not this_rule.fd.closed() ) and this_rule.interest() ) {
-        throw runtime_error( "EventLoop: busy wait detected: rule \""
-                             + _rule_categories.at( this_rule.category_id ).name
-                             + "\" did not read/write fd and is still interested" );
-      }
+  sort_and_serve_ready(); // slots are reused, so sort into the order the rules were added
+  return Result::Success;
+}
+
+static uint32_t epoll_events_for( const Direction direction )
+{
+  return direction == Direction::In ? EPOLLIN : EPOLLOUT;
+}
 
-      return Result::Success; /* only serve one rule on each iteration */
+static uint32_t poll_events_for( const Direction direction )
+{
+  return direction == Direction::In ? POLLIN : POLLOUT;
+}
+
+void EventLoop::register_rule( FDRule& rule )
+{
+  rule.backend_fd.emplace( CheckSystemCall( "dup", ::dup( rule.fd.fd_num() ) ) );
+  rule.armed = true;
+  ++_armed_rules;
+
+  if ( _backend == Backend::IoUring ) {
+    _uring_to_poll.push_back( rule.id );
+  } else {
+    epoll_event event { epoll_events_for( rule.direction ), { .u64 = rule.id } };
+    CheckSystemCall( "epoll_ctl",
+                     epoll_ctl( _epoll->fd_num(), EPOLL_CTL_ADD, rule.backend_fd->fd_num(), &event ) );
+  }
+}
+
+void EventLoop::arm( FDRule& rule )
+{
+  rule.armed = true;
+  ++_armed_rules;
+
+  if ( _backend == Backend::IoUring ) {
+    if ( not rule.poll_pending ) {
+      _uring_to_poll.push_back( rule.id );
     }
+  } else {
+    epoll_event event { epoll_events_for( rule.direction ), { .u64 = rule.id } };
+    CheckSystemCall( "epoll_ctl",
+                     epoll_ctl( _epoll->fd_num(), EPOLL_CTL_MOD, rule.backend_fd->fd_num(), &event ) );
+  }
+}
+
+void EventLoop::park( FDRule& rule )
+{
+  rule.armed = false;
+  --_armed_rules;
+
+  // io_uring: a poll request still in flight is ignored when it completes
+  if ( _backend == Backend::Epoll ) {
+    epoll_event event { 0, { .u64 = rule.id } }; // errors and hangups are still reported
+    CheckSystemCall( "epoll_ctl",
+                     epoll_ctl( _epoll->fd_num(), EPOLL_CTL_MOD, rule.backend_fd->fd_num(), &event ) );
+  }
+}
 
-    ++it; // if we got here, it means we didn't call _fd_rules.erase()
+void EventLoop::forget( FDRule& rule )
+{
+  if ( rule.armed ) {
+    --_armed_rules;
+  }
+
+  if ( _backend == Backend::IoUring ) {
+    if ( rule.poll_pending ) {
+      _uring->prepare_poll_remove( rule.id ); // its completions will not match the slot's next id
+    }
+  } else {
+    CheckSystemCall( "epoll_ctl",
+                     epoll_ctl( _epoll->fd_num(), EPOLL_CTL_DEL, rule.backend_fd->fd_num(), nullptr ) );
+  }
+
+  _fd_rules->erase( rule ); // destroys the rule (and closes the dup)
+}
+
+bool EventLoop::check_defunct( FDRule& rule )
+{
+  if ( rule.cancel_requested ) {
+    forget( rule ); // cancelled externally: no cancellation callback (see poll backend)
+    return true;
+  }
+
+  if ( ( rule.direction == Direction::In and rule.fd.eof() ) or rule.fd.closed() ) {
+    rule.notify_cancel();
+    forget( rule );
+    return true;
+  }
+
+  return false;
+}
+
+bool EventLoop::audit()
+{
+  _last_audit = chrono::steady_clock::now();
+  for ( size_t i = 0; i < _fd_rules->slots.size(); ++i ) {
+    auto& rule = _fd_rules->slots[i].rule;
+    if ( not rule.has_value() or check_defunct( *rule ) ) {
+      continue;
+    }
+    const bool interested = rule->interested();
+    if ( rule->armed and not interested ) {
+      park( *rule );
+    } else if ( not rule->armed and interested ) {
+      arm( *rule );
+    }
+  }
+  return _armed_rules > 0;
+}
+
+bool EventLoop::prepare_wait()
+{
+  // drop rules cancelled through their RuleHandle
+  for ( const uint64_t id : _fd_rules->cancelled ) {
+    if ( FDRule* const rule = _fd_rules->find( id ) ) {
+      forget( *rule );
+    }
+  }
+  _fd_rules->cancelled.clear();
+
+  // re-check the rules whose owners said their interest may have changed (a cancellation callback
+  // run by check_defunct may add to the list, so take it first)
+  swap( _rechecks, _fd_rules->interest_changed );
+  for ( const uint64_t id : _rechecks ) {
+    FDRule* const rule = _fd_rules->find( id );
+    if ( not rule ) {
+      continue;
+    }
+    rule->recheck_pending = false;
+    if ( check_defunct( *rule ) ) {
+      continue;
+    }
+    const bool interested = rule->interested();
+    if ( rule->armed and not interested ) {
+      park( *rule );
+    } else if ( not rule->armed and interested ) {
+      arm( *rule );
+    }
+  }
+  _rechecks.clear();
+
+  // before reporting Result::Exit, make sure no parked rule has become interested unannounced
+  return _armed_rules > 0 or audit();
+}
+
+void EventLoop::queue_polls()
+{
+  // the requests are submitted along with the wait
+  for ( const uint64_t id : _uring_to_poll ) {
+    FDRule* const rule = _fd_rules->find( id );
+    if ( rule and rule->armed and not rule->poll_pending ) {
+      _uring->prepare_poll_add( rule->backend_fd->fd_num(), poll_events_for( rule->direction ), id );
+      rule->poll_pending = true;
+    }
+  }
+  _uring_to_poll.clear();
+}
+
+optional<EventLoop::Result> EventLoop::wait_in_slices( const int timeout_ms,
+                                                      const SmallFunction<bool( int )>& wait_slice )
+{
+  const auto deadline = chrono::steady_clock::now() + chrono::milliseconds( timeout_ms );
+  while ( true ) {
+    int slice_ms = EPOLL_AUDIT_INTERVAL_ms;
+    if ( timeout_ms >= 0 ) {
+      // round up, so the last partial millisecond is slept through rather than spun on with 0-ms waits
+      const auto remaining = chrono::ceil<chrono::milliseconds>( deadline - chrono::steady_clock::now() );
+      slice_ms = static_cast<int>( clamp<int64_t>( remaining.count(), 0, EPOLL_AUDIT_INTERVAL_ms ) );
+    }
+
+    const auto started = wait_started();
+    const bool events = wait_slice( slice_ms );
+    wait_finished( started );
+
+    // a slice without events lasts the interval (unless the timeout is nearer), but a busy loop's are
+    // cut short, so go by the time since the last audit (rules it erases or parks are skipped when the
+    // events are served)
+    if ( chrono::steady_clock::now() - _last_audit >= chrono::milliseconds( EPOLL_AUDIT_INTERVAL_ms ) ) {
+      audit();
+    }
+    if ( events ) {
+      return {};
+    }
+
+    check_dump_request();
+
+    if ( _armed_rules == 0 ) {
+      return Result::Exit;
+    }
+
+    if ( timeout_ms >= 0 and chrono::steady_clock::now() >= deadline ) {
+      return Result::Timeout;
+    }
+  }
+}
+
+EventLoop::Readiness EventLoop::on_event( FDRule& rule, const bool error, const bool hup, const bool ready_bits )
+{
+  if ( rule.cancel_requested ) {
+    forget( rule );
+    return Readiness::Erased;
+  }
+
+  if ( error ) {
+    report_error( rule );
+    rule.notify_error();
+    rule.notify_cancel();
+    forget( rule );
+    return Readiness::Erased;
+  }
+
+  const bool ready = rule.armed and ready_bits;
+  if ( hup and ( ( rule.armed and not ready ) or rule.direction == Direction::Out ) ) {
+    // same conditions as the poll backend: this fd is defunct
+    rule.notify_cancel();
+    forget( rule );
+    return Readiness::Erased;
+  }
+
+  if ( not ready ) {
+    return Readiness::Idle;
+  }
+
+  if ( check_defunct( rule ) ) {
+    return Readiness::Erased;
+  }
+
+  if ( not rule.interested() ) {
+    count_spurious( rule );
+    park( rule );
+    return Readiness::Idle;
+  }
+
+  return Readiness::Ready;
+}
+
+EventLoop::Result EventLoop::wait_next_event_epoll( const int timeout_ms )
+{
+  if ( not prepare_wait() ) {
+    return Result::Exit; // nothing left to wait for
+  }
+
+  // collect every ready rule, so the earliest-added one can be found (as poll would)
+  _epoll_events.resize( max( _epoll_events.size(), _armed_rules ) );
+  int event_count = 0;
+
+  // wait in slices, auditing the rules every EPOLL_AUDIT_INTERVAL_ms
+  const auto result = wait_in_slices( timeout_ms, [&]( const int slice_ms ) {
+    event_count
+      = epoll_wait( _epoll->fd_num(), _epoll_events.data(), static_cast<int>( _epoll_events.size() ), slice_ms );
+    if ( event_count < 0 and errno != EINTR ) { // a signal merely ends the slice
+      throw unix_error( "epoll_wait" );
+    }
+    return event_count > 0;
+  } );
+  if ( result.has_value() ) {
+    return result.value();
+  }
+
+  // like the poll backend, serve ready rules in the order they were added (e.g. a stack's ingress
+  // before its connections); any left unserved stay ready and are reported again by the next epoll_wait
+  _ready.clear();
+  for ( int i = 0; i < event_count; ++i ) {
+    const auto& event = _epoll_events.at( i );
+    FDRule* const rule = _fd_rules->find( event.data.u64 );
+    if ( not rule ) {
+      continue; // forgotten while this batch was examined
+    }
+    FDRule& this_rule = *rule;
+
+    const auto readiness = on_event( this_rule,
+                                     event.events & EPOLLERR,
+                                     event.events & EPOLLHUP,
+                                     event.events & epoll_events_for( this_rule.direction ) );
+    if ( readiness == Readiness::Ready ) {
+      _ready.push_back( &this_rule );
+    }
+  }
+
+  sort_and_serve_ready();
+  return Result::Success;
+}
+
+EventLoop::Result EventLoop::wait_next_event_io_uring( const int timeout_ms )
+{
+  if ( not prepare_wait() ) {
+    return Result::Exit; // nothing left to wait for
+  }
+
+  _uring_completions.clear();
+  const auto result = wait_in_slices( timeout_ms, [&]( const int slice_ms ) {
+    queue_polls(); // including for rules re-armed by an audit after the last slice
+    _uring->submit_and_wait( slice_ms );
+    _uring->for_each_completion(
+      [&]( const uint64_t user_data, const int32_t res ) { _uring_completions.emplace_back( user_data, res ); } );
+    return not _uring_completions.empty();
+  } );
+  if ( result.has_value() ) {
+    return result.value();
+  }
+
+  // as with epoll, serve ready rules in the order they were added
+  _ready.clear();
+  for ( const auto& [id, res] : _uring_completions ) {
+    FDRule* const rule = _fd_rules->find( id );
+    if ( not rule ) {
+      continue; // the poll of a forgotten rule, or its removal
+    }
+    FDRule& this_rule = *rule;
+    this_rule.poll_pending = false;
+
+    const uint32_t revents = res < 0 ? POLLERR : static_cast<uint32_t>( res );
+    const auto readiness = on_event( this_rule,
+                                     revents & ( POLLERR | POLLNVAL ),
+                                     revents & POLLHUP,
+                                     revents & poll_events_for( this_rule.direction ) );
+    if ( readiness == Readiness::Erased ) {
+      continue;
+    }
+
+    // the poll requests are one-shot: ask again, which completes at once if the fd is still ready
+    if ( this_rule.armed ) {
+      _uring_to_poll.push_back( id );
+    }
+    if ( readiness == Readiness::Ready ) {
+      _ready.push_back( &this_rule );
+    }
   }
 
+  sort_and_serve_ready();
   return Result::Success;
 }
 // NOLINTEND(*-signed-bitwise)
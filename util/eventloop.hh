@@ -1,11 +1,21 @@
 #pragma once
 
-#include <functional>
-#include <list>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <optional>
+#include <ostream>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <utility>
+#include <vector>
 
 #include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "small_function.hh"
+#include "timerfd.hh"
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop
@@ -18,13 +28,60 @@ public:
     Out // Callback will be triggered when Rule::fd is writable.
   };
 
+  //! How the EventLoop waits for its file descriptors.
+  enum class Backend : uint8_t
+  {
+    Poll,   //!< Rebuild a pollfd array from every rule and call poll(2) on each iteration.
+    Epoll,  //!< Keep a persistent epoll(7) registration per rule; see EventLoop::EventLoop.
+    IoUring //!< Keep a one-shot poll request per rule in flight on an io_uring(7); see EventLoop::EventLoop.
+  };
+
+  //! How many ready rules one call to EventLoop::wait_next_event serves.
+  enum class Dispatch : uint8_t
+  {
+    One,     //!< Serve the first ready rule (in the order the rules were added), then return.
+    AllReady //!< Serve every rule found ready by one wait, up to a limit; see EventLoop::set_dispatch.
+  };
+
+  //! Output format of EventLoop::dump_stats.
+  enum class StatsFormat : uint8_t
+  {
+    Text, //!< One line for the loop and one per rule category
+    Json  //!< One JSON object
+  };
+
 private:
-  using CallbackT = std::function<void( void )>;
-  using InterestT = std::function<bool( void )>;
+  // small callables (e.g. lambdas capturing a few references) are stored without allocating
+  using CallbackT = SmallFunction<void( void )>;
+  using InterestT = SmallFunction<bool( void )>; // an empty InterestT means "always interested"
+
+  //! What the rules of one category have cost (counted only while stats are enabled)
+  struct CategoryStats
+  {
+    static constexpr size_t HISTOGRAM_BUCKETS = 8; //!< callback durations <1us, <4us, <16us, ... >=4096us
+
+    uint64_t callbacks {};
+    uint64_t spurious {}; //!< times a rule's fd was reported ready but its callback was not run
+    std::chrono::nanoseconds total_time {};
+    std::chrono::nanoseconds max_time {};
+    std::array<uint64_t, HISTOGRAM_BUCKETS> histogram {};
+
+    void record( std::chrono::nanoseconds duration );
+  };
 
   struct RuleCategory
   {
     std::string name;
+    CategoryStats stats {};
+  };
+
+  //! What waiting has cost the loop (counted only while stats are enabled)
+  struct LoopStats
+  {
+    uint64_t waits {};            //!< calls to poll(2), epoll_wait(2) or io_uring_enter(2)
+    uint64_t timeouts {};         //!< calls to wait_next_event that returned Result::Timeout
+    uint64_t spurious_wakeups {}; //!< calls to wait_next_event woken by events that ran no callback
+    std::chrono::nanoseconds wait_time {};
   };
 
   struct BasicRule
@@ -33,8 +90,11 @@ private:
     InterestT interest;
     CallbackT callback;
     bool cancel_requested {};
+    uint64_t id {}; //!< This rule's slot in its SlotTable and the slot's generation (see SlotTable::id)
 
     BasicRule( size_t s_category_id, InterestT s_interest, CallbackT s_callback );
+
+    bool interested() const { return not interest or interest(); }
   };
 
   struct FDRule : public BasicRule
@@ -49,14 +109,182 @@ private:
     //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
     //! \details This function is used internally by EventLoop; you will not need to call it
     unsigned int service_count() const;
+
+    void notify_cancel() const;
+    void notify_error() const;
+
+    //! \name
+    //! Epoll and io_uring backend state
+
+    //!@{
+    std::optional<FileDescriptor> backend_fd {}; //!< A dup of fd, so each rule has its own registration.
+    bool armed {}; //!< Is the registration waiting for Rule::direction (or only for errors)?
+    bool poll_pending {}; //!< io_uring: is a poll request for this rule in flight?
+    bool recheck_pending {}; //!< Is the rule's id in RuleTable::interest_changed?
+    uint64_t order {}; //!< When ready together, rules added earlier are served first (as with poll).
+    //!@}
+  };
+
+  //! \brief Rules of one kind, stored in place in reusable slots and shared with their handles
+  //! \details A rule is named by its id: the index of its slot and the slot's generation, which changes
+  //! whenever a rule is erased, so a stale id (in a handle, a timer's heap entry, or an epoll or io_uring
+  //! request) finds nothing. A std::deque keeps each rule at a fixed address when a callback adds another.
+  template<class RuleT>
+  struct SlotTable
+  {
+    struct Slot
+    {
+      uint32_t generation {};
+      std::optional<RuleT> rule {};
+    };
+
+    std::deque<Slot> slots {};
+    std::vector<uint32_t> free_slots {};
+
+    static uint64_t id( uint32_t index, uint32_t generation ) { return ( uint64_t { generation } << 32U ) | index; }
+
+    RuleT* find( uint64_t id );
+    RuleT& emplace( RuleT&& rule ); //!< Store the rule in a free slot and assign its id
+    void erase( const RuleT& rule ); //!< Destroy the rule and free its slot
+  };
+
+  //! The FD rules
+  struct RuleTable : SlotTable<FDRule>
+  {
+    std::vector<uint64_t> cancelled {}; //!< rules cancelled through their RuleHandle, so the epoll and
+                                        //!< io_uring backends can drop them without a scan
+    std::vector<uint64_t> interest_changed {}; //!< rules whose interest is to be checked before the next
+                                               //!< wait (see RuleHandle::interest_changed)
+
+    void request_recheck( uint64_t id ); //!< Add a registered rule to interest_changed (once)
+  };
+
+  //! The non-fd rules
+  struct NonFDRuleTable : SlotTable<BasicRule>
+  {
+    std::vector<uint32_t> order {}; //!< Slots of the rules, in the order they were added (and are served)
+  };
+
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  //! A rule whose callback runs once the steady clock reaches its deadline
+  struct TimerRule
+  {
+    size_t category_id;
+    CallbackT callback;
+    std::optional<TimePoint> deadline {};
+    uint64_t generation {}; //!< Changed with each new deadline, so stale heap entries can be recognized
+    bool cancel_requested {};
+    uint64_t id {}; //!< See SlotTable::id
+  };
+
+  //! The timer rules, shared with their TimerHandles
+  struct TimerQueue
+  {
+    struct Entry
+    {
+      TimePoint deadline;
+      uint64_t generation;
+      uint64_t id;
+    };
+
+    SlotTable<TimerRule> rules {};
+    std::vector<uint64_t> cancelled {}; //!< Erased at the next wait, in case one is running its callback
+    std::vector<Entry> heap {}; //!< Min-heap of deadlines; entries for changed or cancelled timers are skipped
+    size_t scheduled {};        //!< Number of timer rules with a deadline
+    bool changed {};            //!< Has a deadline been set since the timerfd was last armed?
+
+    TimerRule* find( uint64_t id ); //!< The timer, unless it has been cancelled
+    void schedule( TimerRule& rule, TimePoint deadline );
+    void unschedule( TimerRule& rule );
+    void pop_stale(); //!< Remove entries from the top of the heap that no longer match their rule
+    void erase_cancelled();
   };
 
   std::vector<RuleCategory> _rule_categories {};
-  std::list<std::shared_ptr<FDRule>> _fd_rules {};
-  std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
+  std::shared_ptr<RuleTable> _fd_rules { std::make_shared<RuleTable>() };
+  std::shared_ptr<NonFDRuleTable> _non_fd_rules { std::make_shared<NonFDRuleTable>() };
+
+  Backend _backend;
+  std::vector<pollfd> _pollfds {}; //!< poll: the array passed to poll(2)
+  std::vector<FDRule*> _polled {}; //!< poll: the rule behind each entry of _pollfds
+  std::optional<FileDescriptor> _epoll {};
+  size_t _armed_rules {};                    //!< number of rules whose registration is armed
+  uint64_t _next_rule_order {};              //!< FDRule::order for the next rule added
+  std::vector<epoll_event> _epoll_events {}; //!< epoll: room for an event from every armed rule
+  std::vector<uint64_t> _rechecks {};        //!< RuleTable::interest_changed, taken by prepare_wait
+  TimePoint _last_audit {};                  //!< When audit() last ran
+
+  Dispatch _dispatch { Dispatch::One };
+  size_t _max_per_round { SIZE_MAX };
+  std::optional<uint64_t> _resume_after {}; //!< FDRule::order of the last rule served by a round cut short
+  std::vector<FDRule*> _ready {};           //!< Rules found ready by the current wait
+
+  std::shared_ptr<TimerQueue> _timers { std::make_shared<TimerQueue>() };
+  std::optional<TimerFD> _timerfd {};            //!< Created with the first timer rule
+  std::optional<TimePoint> _timerfd_deadline {}; //!< When the timerfd is set to fire, if it is armed
+  std::vector<std::pair<uint64_t, uint64_t>> _due_timers {}; //!< (TimerRule::id, generation)
+
+  std::unique_ptr<IoUring> _uring {};
+  std::vector<uint64_t> _uring_to_poll {};                         //!< io_uring: ids of rules that need a poll
+  std::vector<std::pair<uint64_t, int32_t>> _uring_completions {}; //!< io_uring: (FDRule::id, revents)
+
+  unsigned _loop_id;                                //!< Numbers the loops of a process in stats dumps
+  bool _stats_enabled {};
+  LoopStats _stats {};
+  uint64_t _callbacks_this_wait {};                 //!< Callbacks run by the current wait_next_event
+  std::optional<StatsFormat> _signal_dump_format {}; //!< Set if SIGUSR1 requests a dump of the stats
+  uint64_t _dump_requests_seen {};
 
 public:
-  EventLoop() { _rule_categories.reserve( 64 ); }
+  //! \details With Backend::Epoll, only rules whose fd fires, or whose owners have called
+  //! RuleHandle::interest_changed, are examined on each iteration, so dispatch costs O(ready + changed)
+  //! rather than O(rules). An armed rule's interest is checked when its fd becomes ready; if it is
+  //! uninterested, it is parked (its registration then only reports errors) until its interest is
+  //! found to have returned. Whatever can make a parked rule interested again should call
+  //! RuleHandle::interest_changed; as a fallback, every rule is audited by the first wait to end at
+  //! least EPOLL_AUDIT_INTERVAL_ms after the last audit (whether or not events arrived, so a busy loop
+  //! is audited as often as an idle one), and before the loop reports Result::Exit. A rule whose
+  //! interest lapses without a call to RuleHandle::interest_changed (or an event on its fd) keeps the
+  //! loop from reporting Result::Exit until the next audit. If epoll is unavailable, the loop falls back
+  //! to Backend::Poll.
+  //!
+  //! Backend::IoUring does the same bookkeeping, but an armed rule has a one-shot poll request in flight
+  //! instead of an epoll registration. The requests queued by an iteration are submitted by the same
+  //! [io_uring_enter(2)](\ref man2::io_uring_enter) that waits for completions. A parked rule has no
+  //! request in flight, so errors on its fd are only seen once it is re-armed. If io_uring is
+  //! unavailable, the loop falls back to Backend::Epoll.
+  explicit EventLoop( Backend backend = Backend::Poll );
+
+  Backend backend() const { return _backend; }
+
+  static constexpr int EPOLL_AUDIT_INTERVAL_ms = 100;
+
+  //! \brief Choose how many ready rules each call to wait_next_event serves (Dispatch::One by default)
+  //! \details With Dispatch::AllReady, every interested non-fd rule runs, and then every fd rule found
+  //! ready by a single poll/epoll_wait/io_uring_enter is served once, in the order the rules were
+  //! added, saving a system call per extra ready rule. Before each callback the rule's interest is
+  //! checked again, since an earlier callback may have changed it. At most `max_per_round` fd rules
+  //! are served per call; when that cuts a round short, the next call starts with the rules it left out.
+  void set_dispatch( Dispatch dispatch, size_t max_per_round = SIZE_MAX );
+
+  Dispatch dispatch() const { return _dispatch; }
+
+  //! \brief Count the callbacks run for each rule category and the time they take (off by default)
+  //! \details Besides each category's callback count, total and maximum callback time, histogram of
+  //! callback durations and spurious wakeups (its fd was reported ready, but the rule was no longer
+  //! interested or had been cancelled), the loop counts its waits, the time spent in them, timeouts and
+  //! wakeups that ran no callback. This costs two clock reads per callback and per wait.
+  //!
+  //! Setting the environment variable MINNOW_EVENTLOOP_STATS to `text` or `json` enables stats in every
+  //! EventLoop, and makes SIGUSR1 dump each loop's stats to stderr in that format. A loop dumps when it
+  //! next begins or is interrupted in a wait (the epoll and io_uring backends also check every
+  //! EPOLL_AUDIT_INTERVAL_ms while they wait).
+  void set_stats( bool enabled ) { _stats_enabled = enabled; }
+
+  bool stats_enabled() const { return _stats_enabled; }
+
+  void dump_stats( std::ostream& out, StatsFormat format = StatsFormat::Text ) const;
 
   //! Returned by each call to EventLoop::wait_next_event.
   enum class Result : uint8_t
@@ -71,29 +299,70 @@ public:
 
   class RuleHandle
   {
-    std::weak_ptr<BasicRule> rule_weak_ptr_;
+    std::weak_ptr<NonFDRuleTable> non_fd_table_ {}; // a non-fd rule's table
+    std::weak_ptr<RuleTable> table_ {};             // or an FD rule's table
+    uint64_t id_ {};                                // and the rule's id
+
+  public:
+    RuleHandle( const std::shared_ptr<NonFDRuleTable>& table, uint64_t id ) : non_fd_table_( table ), id_( id ) {}
+
+    RuleHandle( const std::shared_ptr<RuleTable>& table, uint64_t id ) : table_( table ), id_( id ) {}
+
+    void cancel();
+
+    //! \brief Tell the loop that the rule's interest may have changed (e.g. returned) since it was last checked
+    //! \details The epoll and io_uring backends check the rule's interest before the next wait, re-arming
+    //! it if it was parked and is interested again, or parking it if it is armed and no longer interested.
+    //! The poll backend checks every rule's interest on each wait anyway.
+    void interest_changed();
+  };
+
+  //! Handle to a timer rule, used to set its deadline or cancel it
+  class TimerHandle
+  {
+    std::weak_ptr<TimerQueue> queue_;
+    uint64_t id_;
 
   public:
-    template<class RuleType>
-    explicit RuleHandle( const std::shared_ptr<RuleType> x ) : rule_weak_ptr_( x )
-    {}
+    TimerHandle( const std::shared_ptr<TimerQueue>& queue, uint64_t id ) : queue_( queue ), id_( id ) {}
+
+    //! Run the callback once at `deadline` (or as soon as possible if it has passed), replacing any
+    //! earlier deadline; the callback may set a new one
+    void set( TimePoint deadline );
+    void set_after( std::chrono::steady_clock::duration delay ) { set( std::chrono::steady_clock::now() + delay ); }
+
+    //! Unschedule the callback (the rule remains and can be set again)
+    void clear();
 
+    //! Remove the rule
     void cancel();
+
+    std::optional<TimePoint> deadline() const;
   };
 
-  RuleHandle add_rule(
-    size_t category_id,
-    FileDescriptor& fd,
-    Direction direction,
-    const CallbackT& callback,
-    const InterestT& interest = [] { return true; },
-    const CallbackT& cancel = [] {},
-    const CallbackT& error = [] {} );
+  //! \details The callables may be any lambdas or function objects; those of up to SmallFunction's
+  //! inline capacity are stored in the rule itself, so adding and dispatching rules does not allocate.
+  //! Leaving out `interest` means the rule is always interested.
+  RuleHandle add_rule( size_t category_id,
+                       FileDescriptor& fd,
+                       Direction direction,
+                       CallbackT callback,
+                       InterestT interest = {},
+                       CallbackT cancel = {},
+                       CallbackT error = {} );
+
+  RuleHandle add_rule( size_t category_id, CallbackT callback, InterestT interest = {} );
 
-  RuleHandle
-  add_rule( size_t category_id, const CallbackT& callback, const InterestT& interest = [] { return true; } );
+  //! \brief Add a timer rule, initially unscheduled (see TimerHandle::set)
+  //! \details The loop keeps one [timerfd](\ref man2::timerfd_create) set to the earliest deadline, and
+  //! a min-heap of the rest, so deadlines have nanosecond resolution and a loop with nothing else to do
+  //! sleeps until the next one rather than waking at a fixed interval. Due timers are run, earliest
+  //! first, by an fd rule on the timerfd (which is served like any other rule). A scheduled timer keeps
+  //! the loop from reporting Result::Exit.
+  TimerHandle add_timer( size_t category_id, CallbackT callback );
 
-  //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+  //! Calls [poll(2)](\ref man2::poll), [epoll_wait(2)](\ref man2::epoll_wait) or io_uring_enter(2)
+  //! and then executes the callback for one ready fd (or, with Dispatch::AllReady, for each of them).
   Result wait_next_event( int timeout_ms );
 
   // convenience function to add category and rule at the same time
@@ -102,6 +371,85 @@ public:
   {
     return add_rule( add_category( name ), std::forward<Targs>( Fargs )... );
   }
+
+  TimerHandle add_timer( const std::string& name, CallbackT callback )
+  {
+    return add_timer( add_category( name ), std::move( callback ) );
+  }
+
+private:
+  std::optional<RuleHandle> _timerfd_rule {}; //!< The rule that runs the due timers
+
+  //! Print the error pending on a rule's file descriptor (after POLLERR or EPOLLERR)
+  void report_error( const FDRule& rule ) const;
+
+  //! Run a rule's callback, recording its duration if stats are enabled
+  void run_callback( size_t category_id, const CallbackT& callback )
+  {
+    ++_callbacks_this_wait;
+    if ( _stats_enabled ) {
+      run_timed_callback( category_id, callback );
+    } else {
+      callback();
+    }
+  }
+  void run_timed_callback( size_t category_id, const CallbackT& callback );
+
+  //! Count a ready rule whose callback was not run (if stats are enabled)
+  void count_spurious( const FDRule& rule );
+
+  //! Start timing a wait (if stats are enabled)
+  TimePoint wait_started() const { return _stats_enabled ? std::chrono::steady_clock::now() : TimePoint {}; }
+  void wait_finished( TimePoint started );
+
+  //! Dump the stats if SIGUSR1 has been received since the last check
+  void check_dump_request();
+
+  //! Run the timer rules whose deadlines have passed
+  void run_due_timers();
+
+  //! Point the timerfd at the earliest deadline, if it has changed
+  void arm_timerfd();
+
+  //! Run a ready rule's callback, and check that it made progress
+  void serve( FDRule& rule );
+
+  //! Serve the rules in _ready (sorted by FDRule::order) according to the dispatch policy
+  void serve_ready();
+  void sort_and_serve_ready(); //!< Sort _ready first (only the earliest rule is needed for Dispatch::One)
+
+  Result wait_next_event_poll( int timeout_ms );
+  Result wait_next_event_epoll( int timeout_ms );
+  Result wait_next_event_io_uring( int timeout_ms );
+
+  //! \name
+  //! Registration changes for the epoll and io_uring backends
+
+  //!@{
+  void register_rule( FDRule& rule );
+  void arm( FDRule& rule );
+  void park( FDRule& rule );
+  void forget( FDRule& rule );        //!< Drop the rule's registration and erase it
+  bool check_defunct( FDRule& rule ); //!< Erase the rule if cancelled, at EOF or closed; true if erased
+  bool audit(); //!< Park uninterested armed rules, re-arm interested parked ones; false if none are armed
+  bool prepare_wait(); //!< Drop cancelled rules and re-check changed ones; false if none are armed
+  void queue_polls();  //!< io_uring: queue a poll request for each armed rule without one
+
+  //! Call `wait_slice` (which returns whether events arrived) with slices of the timeout, auditing
+  //! after any that ends EPOLL_AUDIT_INTERVAL_ms or more after the last audit; returns the result if no
+  //! events arrived
+  std::optional<Result> wait_in_slices( int timeout_ms, const SmallFunction<bool( int )>& wait_slice );
+
+  //! What became of a rule after an event on its fd
+  enum class Readiness : uint8_t
+  {
+    Erased, //!< The rule was defunct and has been erased
+    Idle,   //!< The rule is not ready, or was parked
+    Ready   //!< The rule is ready and interested
+  };
+
+  Readiness on_event( FDRule& rule, bool error, bool hup, bool ready_bits );
+  //!@}
 };
 
 using Direction = EventLoop::Direction;
@@ -2,6 +2,28 @@
 
 #include "tcp_config.hh"
 
+#include <cstdint>
+#include <stdexcept>
+
+//! \brief Checksum offload settings of an adapter (each an explicit opt-in, off by default)
+//! \details Modeled on the kernel's CHECKSUM_UNNECESSARY (for received packets) and CHECKSUM_PARTIAL
+//! (for sent ones).
+struct ChecksumOffload
+{
+  bool skip_verify = false;      //!< accept received datagrams without verifying checksums (a trusted link)
+  bool partial_transmit = false; //!< leave the TCP checksums of sent segments for the device to complete
+                                 //!< (only for an adapter whose device does, see set_checksum_offload)
+};
+
+//! How the checksums of an adapter's datagrams were handled
+struct ChecksumCounters
+{
+  uint64_t verified {}; //!< received datagrams whose checksums were verified
+  uint64_t skipped {};  //!< received datagrams accepted unverified (trusted link, or vouched for by the device)
+  uint64_t computed {}; //!< sent segments with a complete checksum
+  uint64_t deferred {}; //!< sent segments with a partial checksum, for the device to complete
+};
+
 //! \brief Basic functionality for file descriptor adaptors
 //! \details See TCPOverIPv4OverTunFdAdapter for more information.
 class FdAdapterBase
@@ -9,9 +31,16 @@ class FdAdapterBase
 private:
   FdAdapterConfig _cfg {}; //!< Configuration values
   bool _listen = false;    //!< Is the connected TCP FSM in listen state?
+  ChecksumOffload _checksum_offload {};
+  ChecksumCounters _checksum_counters {};
+  bool _device_completes_checksums = false; //!< Does the device complete a partial TCP checksum?
 
 protected:
   FdAdapterConfig& config_mutable() { return _cfg; }
+  ChecksumCounters& checksum_counters_mutable() { return _checksum_counters; }
+
+  //! Declare that the device completes partial checksums (e.g. a TUN device with TCP offload)
+  void set_device_completes_checksums( const bool completes ) { _device_completes_checksums = completes; }
 
 public:
   //! \brief Set the listening flag
@@ -30,6 +59,23 @@ public:
   //! \returns a mutable reference
   FdAdapterConfig& config_mut() { return _cfg; }
 
+  //! Get the checksum offload settings
+  const ChecksumOffload& checksum_offload() const { return _checksum_offload; }
+
+  //! \brief Opt in to (or out of) checksum offloads
+  //! \throws std::invalid_argument for ChecksumOffload::partial_transmit if nothing would complete the
+  //!         checksums, so that the peer would drop every segment
+  void set_checksum_offload( const ChecksumOffload& offload )
+  {
+    if ( offload.partial_transmit and not _device_completes_checksums ) {
+      throw std::invalid_argument( "partial_transmit needs a device that completes TCP checksums" );
+    }
+    _checksum_offload = offload;
+  }
+
+  //! Get the counts of checksums verified, skipped, computed and deferred
+  const ChecksumCounters& checksum_counters() const { return _checksum_counters; }
+
   //! Called periodically when time elapses
   void tick( const size_t unused [[maybe_unused]] ) {}
 };
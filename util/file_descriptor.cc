@@ -1,6 +1,8 @@
 #include "file_descriptor.hh"
 
+#include "buffer_pool.hh"
 #include "exception.hh"
+#include "small_vector.hh"
 
 #include <fcntl.h>
 #include <iostream>
@@ -80,7 +82,12 @@ FileDescriptor FileDescriptor::duplicate() const
 // buffer is the string to be read into
 void FileDescriptor::read( string& buffer )
 {
+  static_assert( BufferPool::LARGE_CAPACITY == kReadBufferSize );
+
   if ( buffer.empty() ) {
+    if ( buffer.capacity() < kReadBufferSize ) {
+      buffer = BufferPool::large();
+    }
     buffer.resize( kReadBufferSize );
   }
 
@@ -112,6 +119,9 @@ void FileDescriptor::read( vector<string>& buffers )
     return;
   }
 
+  if ( buffers.back().capacity() < kReadBufferSize ) {
+    buffers.back() = BufferPool::large();
+  }
   buffers.back().clear();
   buffers.back().resize( kReadBufferSize );
 
@@ -151,12 +161,12 @@ void FileDescriptor::read( vector<string>& buffers )
 
 size_t FileDescriptor::write( string_view buffer )
 {
-  return write( vector<string_view> { buffer } );
+  return write( span { &buffer, 1 } );
 }
 
-size_t FileDescriptor::write( const vector<Ref<string>>& buffers )
+size_t FileDescriptor::write( const span<const Ref<string>> buffers )
 {
-  vector<string_view> views;
+  SmallVector<string_view, 8> views;
   views.reserve( buffers.size() );
   for ( const auto& x : buffers ) {
     views.emplace_back( x.get() );
@@ -164,9 +174,9 @@ size_t FileDescriptor::write( const vector<Ref<string>>& buffers )
   return write( views );
 }
 
-size_t FileDescriptor::write( const vector<string_view>& buffers )
+size_t FileDescriptor::write( const span<const string_view> buffers )
 {
-  vector<iovec> iovecs;
+  SmallVector<iovec, 8> iovecs; // a packet's few buffers are written without allocating
   iovecs.reserve( buffers.size() );
   size_t total_size = 0;
   for ( const auto x : buffers ) {
@@ -176,6 +186,11 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
 
   const ssize_t bytes_written
     = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
+
+  if ( bytes_written == 0 and total_size != 0 and internal_fd_->non_blocking_ ) {
+    return 0; // would have blocked
+  }
+
   register_write();
 
   if ( bytes_written == 0 and total_size != 0 ) {
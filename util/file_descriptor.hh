@@ -3,6 +3,7 @@
 #include "ref.hh"
 #include <cstddef>
 #include <memory>
+#include <span>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -50,6 +51,7 @@ protected:
   void set_eof() { internal_fd_->eof_ = true; }
   void register_read() { ++internal_fd_->read_count_; }   // increment read count
   void register_write() { ++internal_fd_->write_count_; } // increment write count
+  bool non_blocking() const { return internal_fd_->non_blocking_; }
 
   template<typename T>
   T CheckSystemCall( std::string_view s_attempt, T return_value ) const;
@@ -66,10 +68,10 @@ public:
   void read( std::vector<std::string>& buffers );
 
   // Attempt to write a buffer
-  // returns number of bytes written
+  // returns number of bytes written (0 if a non-blocking FileDescriptor would have blocked)
   size_t write( std::string_view buffer );
-  size_t write( const std::vector<std::string_view>& buffers );
-  size_t write( const std::vector<Ref<std::string>>& buffers );
+  size_t write( std::span<const std::string_view> buffers );
+  size_t write( std::span<const Ref<std::string>> buffers );
 
   // Close the underlying file descriptor
   void close() { internal_fd_->close(); }
@@ -13,7 +13,7 @@
 // Helper to serialize any object (without constructing a Serializer of the caller's own)
 // example: ```ethernet_frame.payload = serialize( internet_datagram );```
 template<class T>
-std::vector<Ref<std::string>> serialize( const T& obj )
+PacketBuffers serialize( const T& obj )
 {
   Serializer s;
   obj.serialize( s );
@@ -52,15 +52,44 @@ std::string pretty_print( std::string_view str, size_t max_length = 32 );
 // Summarize an Ethernet frame into a string
 std::string summary( const EthernetFrame& frame );
 
-// Explicitly copy ("clone") a frame or datagram
-inline EthernetFrame clone( const EthernetFrame& x )
+// Explicitly copy ("clone") a buffer: a shared one is shared with the copy, and others are copied
+inline Ref<std::string> clone( const Ref<std::string>& x )
 {
-  auto duplicate_payload = x.payload | std::views::transform( []( auto& i ) { return i.get(); } );
+  return x.is_shared() ? Ref { x } : Ref { std::string { x.get() } };
+}
+
+// ... but an owned buffer that may be changed is shared instead (see Ref::share), so that later clones of
+// it copy nothing either
+inline Ref<std::string> clone( Ref<std::string>& x )
+{
+  return x.is_borrowed() ? Ref { std::string { x.get() } } : x.share();
+}
+
+// Explicitly copy ("clone") a frame or datagram, buffer by buffer (sharing the owned buffers of a
+// non-const one)
+template<class Packet>
+Packet clone_packet( auto& x )
+{
+  auto duplicate_payload = x.payload | std::views::transform( []( auto& i ) { return clone( i ); } );
   return { x.header, { duplicate_payload.begin(), duplicate_payload.end() } };
 }
 
+inline EthernetFrame clone( const EthernetFrame& x )
+{
+  return clone_packet<EthernetFrame>( x );
+}
+
+inline EthernetFrame clone( EthernetFrame& x )
+{
+  return clone_packet<EthernetFrame>( x );
+}
+
 inline InternetDatagram clone( const InternetDatagram& x )
 {
-  auto duplicate_payload = x.payload | std::views::transform( []( auto& i ) { return i.get(); } );
-  return { x.header, { duplicate_payload.begin(), duplicate_payload.end() } };
+  return clone_packet<InternetDatagram>( x );
+}
+
+inline InternetDatagram clone( InternetDatagram& x )
+{
+  return clone_packet<InternetDatagram>( x );
 }
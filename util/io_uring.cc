@@ -0,0 +1,206 @@
+#include "io_uring.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+int io_uring_setup( const unsigned entries, io_uring_params& params )
+{
+  return static_cast<int>( ::syscall( __NR_io_uring_setup, entries, &params ) );
+}
+
+io_uring_params setup_params()
+{
+  io_uring_params params {};
+  memset( &params, 0, sizeof( params ) );
+  return params;
+}
+
+} // namespace
+
+IoUring::Mapping::Mapping( const FileDescriptor& ring, const size_t s_length, const off_t offset )
+  : addr( ::mmap( nullptr, s_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd_num(), offset ) )
+  , length( s_length )
+{
+  if ( addr == MAP_FAILED ) { // NOLINT(*-cstyle-cast, *-int-to-ptr)
+    throw unix_error( "mmap io_uring" );
+  }
+}
+
+IoUring::Mapping::~Mapping()
+{
+  ::munmap( addr, length );
+}
+
+IoUring::IoUring( const unsigned entries )
+  : params_( setup_params() )
+  , ring_( CheckSystemCall( "io_uring_setup", io_uring_setup( entries, params_ ) ) )
+  , rings_( ring_,
+            max( params_.sq_off.array + params_.sq_entries * sizeof( uint32_t ),
+                 params_.cq_off.cqes + params_.cq_entries * sizeof( io_uring_cqe ) ),
+            IORING_OFF_SQ_RING )
+  , sqes_( ring_, params_.sq_entries * sizeof( io_uring_sqe ), IORING_OFF_SQES )
+{
+  // a timeout on io_uring_enter needs EXT_ARG (Linux 5.11); the rest of the features are older
+  const uint32_t needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+  if ( ( params_.features & needed ) != needed ) {
+    throw runtime_error( "io_uring lacks SINGLE_MMAP, NODROP or EXT_ARG" );
+  }
+
+  // entry i of the submission array always names submission queue entry i
+  uint32_t* array = rings_.at<uint32_t>( params_.sq_off.array );
+  for ( uint32_t i = 0; i < params_.sq_entries; ++i ) {
+    array[i] = i; // NOLINT(*-pointer-arithmetic)
+  }
+  sq_tail_ = shared( *rings_.at<uint32_t>( params_.sq_off.tail ) ).load( memory_order_relaxed );
+}
+
+IoUring::~IoUring() = default;
+
+io_uring_sqe& IoUring::next_sqe()
+{
+  const uint32_t head = shared( *rings_.at<uint32_t>( params_.sq_off.head ) ).load( memory_order_acquire );
+  if ( sq_tail_ - head >= params_.sq_entries ) {
+    enter( 0, 0, nullptr, 0 ); // the ring is full: hand the queued entries to the kernel now
+  }
+
+  const uint32_t mask = *rings_.at<uint32_t>( params_.sq_off.ring_mask );
+  io_uring_sqe& sqe = sqes_.at<io_uring_sqe>( 0 )[sq_tail_ & mask]; // NOLINT(*-pointer-arithmetic)
+  memset( &sqe, 0, sizeof( sqe ) );
+  return sqe;
+}
+
+void IoUring::queue_sqe()
+{
+  shared( *rings_.at<uint32_t>( params_.sq_off.tail ) ).store( ++sq_tail_, memory_order_release );
+  ++to_submit_;
+}
+
+void IoUring::prepare_poll_add( const int fd, const uint32_t poll_events, const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_POLL_ADD;
+  sqe.fd = fd;
+  sqe.poll32_events = poll_events;
+  sqe.user_data = user_data;
+
+  queue_sqe();
+}
+
+void IoUring::prepare_poll_remove( const uint64_t target_user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_POLL_REMOVE;
+  sqe.fd = -1;
+  sqe.addr = target_user_data;
+  sqe.user_data = target_user_data;
+
+  queue_sqe();
+}
+
+void IoUring::prepare_read( const int fd,
+                            const uint16_t buffer_group,
+                            const uint32_t length,
+                            const bool multishot,
+                            const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = multishot ? OP_READ_MULTISHOT : static_cast<uint8_t>( IORING_OP_READ );
+  sqe.fd = fd;
+  sqe.flags = IOSQE_BUFFER_SELECT;
+  sqe.buf_group = buffer_group;
+  sqe.len = multishot ? 0 : length; // a multishot read takes the whole of each buffer
+  sqe.off = UINT64_MAX;             // the current position, as for read(2)
+  sqe.user_data = user_data;
+  queue_sqe();
+}
+
+void IoUring::prepare_write( const int fd, const string_view data, const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_WRITE;
+  sqe.fd = fd;
+  sqe.addr = reinterpret_cast<uint64_t>( data.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = static_cast<uint32_t>( data.size() );
+  sqe.off = UINT64_MAX;
+  sqe.user_data = user_data;
+  queue_sqe();
+}
+
+void IoUring::prepare_cancel( const uint64_t target_user_data, const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = target_user_data;
+  sqe.user_data = user_data;
+  queue_sqe();
+}
+
+void IoUring::register_buffer_ring( const void* ring, const uint32_t entries, const uint16_t buffer_group )
+{
+  io_uring_buf_reg reg {};
+  reg.ring_addr = reinterpret_cast<uint64_t>( ring ); // NOLINT(*-reinterpret-cast)
+  reg.ring_entries = entries;
+  reg.bgid = buffer_group;
+  CheckSystemCall( "io_uring_register",
+                   static_cast<int>( ::syscall(
+                     __NR_io_uring_register, ring_.fd_num(), IORING_REGISTER_PBUF_RING, &reg, 1 ) ) );
+}
+
+void IoUring::submit()
+{
+  if ( to_submit_ > 0 ) {
+    enter( 0, 0, nullptr, 0 );
+  }
+}
+
+void IoUring::submit_and_wait( const int timeout_ms )
+{
+  __kernel_timespec timeout { .tv_sec = timeout_ms / 1000, .tv_nsec = ( timeout_ms % 1000 ) * 1000000LL };
+  io_uring_getevents_arg arg {};
+  arg.sigmask_sz = _NSIG / 8;
+  arg.ts = timeout_ms < 0 ? 0 : reinterpret_cast<uint64_t>( &timeout ); // NOLINT(*-reinterpret-cast)
+  enter( timeout_ms == 0 ? 0 : 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof( arg ) );
+}
+
+void IoUring::enter( const uint32_t min_complete, const uint32_t flags, const void* arg, const size_t arg_size )
+{
+  const long ret = ::syscall( __NR_io_uring_enter, ring_.fd_num(), to_submit_, min_complete, flags, arg, arg_size );
+  if ( ret < 0 ) {
+    // a timeout or a signal merely ends the wait
+    if ( errno == ETIME or errno == EINTR ) {
+      return;
+    }
+    throw unix_error( "io_uring_enter" );
+  }
+
+  // with GETEVENTS, the return value counts submissions only if there were some
+  to_submit_ -= min<uint32_t>( to_submit_, static_cast<uint32_t>( ret ) );
+}
+
+optional<IoUring::Completion> IoUring::next_completion()
+{
+  uint32_t& head = *rings_.at<uint32_t>( params_.cq_off.head );
+  if ( head == shared( *rings_.at<uint32_t>( params_.cq_off.tail ) ).load( memory_order_acquire ) ) {
+    return {};
+  }
+
+  const uint32_t mask = *rings_.at<uint32_t>( params_.cq_off.ring_mask );
+  const io_uring_cqe* cqes = rings_.at<io_uring_cqe>( params_.cq_off.cqes );
+  const io_uring_cqe& cqe = cqes[head & mask]; // NOLINT(*-pointer-arithmetic)
+  const Completion ret { cqe.user_data, cqe.res, cqe.flags };
+  shared( head ).store( head + 1, memory_order_release );
+  return ret;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <optional>
+#include <string_view>
+#include <sys/types.h>
+
+//! \brief A minimal Linux [io_uring](\ref man7::io_uring) instance, driven by raw system calls
+//! \details Requests are queued in the shared submission ring and handed to the kernel by the next
+//! submit_and_wait(), which also waits for completions, so a loop iteration costs one system call
+//! (unless it queues more requests than the ring holds). Only the operations EventLoop and IoUringPacketIO
+//! need are provided.
+class IoUring
+{
+public:
+  //! IORING_OP_READ_MULTISHOT (Linux 6.7), which older headers lack
+  static constexpr uint8_t OP_READ_MULTISHOT = IORING_OP_SENDMSG_ZC + 1;
+
+  //! \param[in] entries is the size of the submission ring (the completion ring is twice as large)
+  //! \throws unix_error if io_uring is unavailable (e.g. ENOSYS, or EPERM under a seccomp filter),
+  //!         or runtime_error if the kernel lacks a needed feature
+  explicit IoUring( unsigned entries );
+  ~IoUring();
+
+  //! Queue a one-shot [poll](\ref man2::poll) for `poll_events` on `fd`; it completes with the revents
+  void prepare_poll_add( int fd, uint32_t poll_events, uint64_t user_data );
+
+  //! Queue the cancellation of the poll queued with `target_user_data`
+  void prepare_poll_remove( uint64_t target_user_data );
+
+  //! \brief Queue a read from `fd` into a buffer the kernel picks from the provided-buffer ring `buffer_group`
+  //! \details The completion's flags carry the buffer's id (see register_buffer_ring). A `multishot` read
+  //! stays in flight, completing once per read, until it fails (e.g. with ENOBUFS when the buffers run out)
+  //! or the kernel does not know it (EINVAL); the last completion lacks IORING_CQE_F_MORE.
+  void prepare_read( int fd, uint16_t buffer_group, uint32_t length, bool multishot, uint64_t user_data );
+
+  //! Queue a write of `data` to `fd`; `data` must stay valid until the write completes
+  void prepare_write( int fd, std::string_view data, uint64_t user_data );
+
+  //! Queue the cancellation of the request queued with `target_user_data`
+  void prepare_cancel( uint64_t target_user_data, uint64_t user_data );
+
+  //! \brief Register a ring of provided buffers (Linux 5.19) as `buffer_group`
+  //! \param[in] ring is page-aligned memory for `entries` (a power of two) io_uring_buf entries, which must
+  //!            stay mapped for the life of the IoUring
+  void register_buffer_ring( const void* ring, uint32_t entries, uint16_t buffer_group );
+
+  //! Submit the queued requests without waiting (no system call if there are none)
+  void submit();
+
+  //! Submit the queued requests, then wait for at least one completion or until `timeout_ms` passes
+  //! (-1 waits indefinitely, 0 only submits)
+  void submit_and_wait( int timeout_ms );
+
+  //! Call `f( user_data, result )` for each completion that has arrived, and consume them
+  template<typename F>
+  void for_each_completion( F&& f );
+
+  //! A completion, as io_uring_cqe has it
+  struct Completion
+  {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+  };
+
+  //! Consume the oldest completion that has arrived, if any
+  std::optional<Completion> next_completion();
+
+  //! The ring's file descriptor, readable while completions are waiting
+  class RingFD : public FileDescriptor
+  {
+  public:
+    using FileDescriptor::FileDescriptor;
+    using FileDescriptor::register_read; //!< for the consumer of completions (see EventLoop's busy-wait check)
+  };
+
+  RingFD& fd() { return ring_; }
+
+  IoUring( const IoUring& other ) = delete;
+  IoUring& operator=( const IoUring& other ) = delete;
+  IoUring( IoUring&& other ) = delete;
+  IoUring& operator=( IoUring&& other ) = delete;
+
+private:
+  //! A shared memory region mapped from the io_uring file descriptor
+  struct Mapping
+  {
+    void* addr;
+    size_t length;
+
+    Mapping( const FileDescriptor& ring, size_t s_length, off_t offset );
+    ~Mapping();
+
+    template<typename T>
+    T* at( uint32_t offset ) const
+    {
+      return reinterpret_cast<T*>( static_cast<char*>( addr ) + offset ); // NOLINT(*-reinterpret-cast)
+    }
+
+    Mapping( const Mapping& other ) = delete;
+    Mapping& operator=( const Mapping& other ) = delete;
+    Mapping( Mapping&& other ) = delete;
+    Mapping& operator=( Mapping&& other ) = delete;
+  };
+
+  io_uring_params params_;
+  RingFD ring_;
+  Mapping rings_;                  // submission and completion rings (IORING_FEAT_SINGLE_MMAP)
+  Mapping sqes_;                   // submission queue entries
+  uint32_t sq_tail_ {};            // our copy of the submission tail
+  uint32_t to_submit_ {};          // entries queued since the last io_uring_enter
+  io_uring_sqe& next_sqe();        // the next free entry, submitting the queued ones if the ring is full
+  void queue_sqe();                // hand the entry from next_sqe() to the kernel with the next submission
+  void enter( uint32_t min_complete, uint32_t flags, const void* arg, size_t arg_size );
+
+  static std::atomic_ref<uint32_t> shared( uint32_t& x ) { return std::atomic_ref<uint32_t> { x }; }
+};
+
+template<typename F>
+void IoUring::for_each_completion( F&& f )
+{
+  uint32_t& head = *rings_.at<uint32_t>( params_.cq_off.head );
+  const uint32_t tail = shared( *rings_.at<uint32_t>( params_.cq_off.tail ) ).load( std::memory_order_acquire );
+  const uint32_t mask = *rings_.at<uint32_t>( params_.cq_off.ring_mask );
+  const io_uring_cqe* cqes = rings_.at<io_uring_cqe>( params_.cq_off.cqes );
+
+  for ( uint32_t i = head; i != tail; ++i ) {
+    const io_uring_cqe& cqe = cqes[i & mask]; // NOLINT(*-pointer-arithmetic)
+    f( cqe.user_data, cqe.res );
+  }
+  shared( head ).store( tail, std::memory_order_release );
+}
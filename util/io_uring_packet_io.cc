@@ -0,0 +1,158 @@
+#include "io_uring_packet_io.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace {
+
+constexpr uint16_t BUFFER_GROUP = 0;
+
+} // namespace
+
+IoUringPacketIO::RingMemory::RingMemory( const size_t s_length )
+  : addr( ::mmap( nullptr, s_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) )
+  , length( s_length )
+{
+  if ( addr == MAP_FAILED ) { // NOLINT(*-cstyle-cast, *-int-to-ptr)
+    throw unix_error( "mmap provided-buffer ring" );
+  }
+}
+
+IoUringPacketIO::RingMemory::~RingMemory()
+{
+  ::munmap( addr, length );
+}
+
+IoUringPacketIO::IoUringPacketIO( const FileDescriptor& fd, const uint16_t buffer_count, const size_t buffer_size )
+  : fd_( fd.fd_num() )
+  , buffer_count_( buffer_count )
+  , buffer_size_( buffer_size )
+  , buffers_( buffer_count * buffer_size, 0 )
+  , ring_memory_( buffer_count * sizeof( io_uring_buf ) )
+  , uring_( 256 )
+{
+  if ( buffer_count == 0 or ( buffer_count & ( buffer_count - 1 ) ) != 0 ) {
+    throw runtime_error( "IoUringPacketIO: the buffer count must be a power of two" );
+  }
+
+  uring_.register_buffer_ring( ring_memory_.addr, buffer_count_, BUFFER_GROUP );
+  for ( uint16_t id = 0; id < buffer_count_; ++id ) {
+    provide_buffer( id );
+  }
+  queue_read();
+  flush();
+}
+
+IoUringPacketIO::~IoUringPacketIO()
+{
+  // the kernel may still read into the buffers, or write from the queued packets: wait until it is done
+  try {
+    if ( read_in_flight_ ) {
+      uring_.prepare_cancel( READ_REQUEST, CANCEL_REQUEST );
+    }
+    while ( read_in_flight_ or free_writes_.size() < writes_.size() ) {
+      uring_.submit_and_wait( -1 );
+      while ( const auto cqe = uring_.next_completion() ) {
+        if ( cqe->user_data == READ_REQUEST ) {
+          read_in_flight_ = cqe->flags & IORING_CQE_F_MORE;
+        } else if ( cqe->user_data != CANCEL_REQUEST ) {
+          free_writes_.push_back( cqe->user_data );
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    // don't throw an exception from the destructor
+    cerr << "Exception destructing IoUringPacketIO: " << e.what() << "\n";
+  }
+}
+
+void IoUringPacketIO::queue_read()
+{
+  uring_.prepare_read( fd_, BUFFER_GROUP, buffer_size_, multishot_, READ_REQUEST );
+  read_in_flight_ = true;
+}
+
+void IoUringPacketIO::provide_buffer( const uint16_t id )
+{
+  // the ring's tail overlays the reserved field of entry 0, which is left alone here
+  io_uring_buf& entry
+    = static_cast<io_uring_buf*>( ring_memory_.addr )[ring_tail_ & ( buffer_count_ - 1 )]; // NOLINT(*-arithmetic)
+  entry.addr = reinterpret_cast<uint64_t>( buffers_.data() + id * buffer_size_ ); // NOLINT(*-reinterpret-cast)
+  entry.len = static_cast<uint32_t>( buffer_size_ );
+  entry.bid = id;
+
+  auto* ring = static_cast<io_uring_buf_ring*>( ring_memory_.addr );
+  atomic_ref<uint16_t> { ring->tail }.store( ++ring_tail_, memory_order_release );
+}
+
+bool IoUringPacketIO::read( string& packet )
+{
+  uring_.fd().register_read();
+
+  while ( const auto cqe = uring_.next_completion() ) {
+    if ( cqe->user_data == CANCEL_REQUEST ) {
+      continue;
+    }
+
+    if ( cqe->user_data != READ_REQUEST ) {
+      free_writes_.push_back( cqe->user_data );
+      if ( cqe->res < 0 ) {
+        throw unix_error( "io_uring write", -cqe->res );
+      }
+      continue;
+    }
+
+    read_in_flight_ = cqe->flags & IORING_CQE_F_MORE;
+    bool got_packet = false;
+    bool failed = false;
+    if ( cqe->flags & IORING_CQE_F_BUFFER ) {
+      const auto id = static_cast<uint16_t>( cqe->flags >> IORING_CQE_BUFFER_SHIFT );
+      packet.assign( buffers_, id * buffer_size_, static_cast<size_t>( max( cqe->res, 0 ) ) );
+      provide_buffer( id );
+      got_packet = cqe->res > 0;
+    } else if ( cqe->res == -EINVAL and multishot_ ) {
+      multishot_ = false; // the kernel predates multishot reads
+    } else {
+      failed = cqe->res < 0 and cqe->res != -ENOBUFS;
+    }
+
+    // the read ends when it fails, or when the buffers run out (ENOBUFS), which were all given back above
+    if ( not read_in_flight_ ) {
+      queue_read();
+    }
+    if ( failed ) {
+      throw unix_error( "io_uring read", -cqe->res );
+    }
+    if ( got_packet ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void IoUringPacketIO::write( const span<const Ref<string>> buffers )
+{
+  if ( free_writes_.empty() ) {
+    free_writes_.push_back( writes_.size() );
+    writes_.emplace_back();
+  }
+  const uint64_t slot = free_writes_.back();
+  free_writes_.pop_back();
+
+  string& packet = writes_[slot];
+  packet.clear();
+  for ( const auto& buffer : buffers ) {
+    packet.append( buffer.get() );
+  }
+  uring_.prepare_write( fd_, packet, slot );
+}
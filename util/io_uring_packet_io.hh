@@ -0,0 +1,87 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "ref.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <vector>
+
+//! \brief Reads and writes whole packets on a packet-oriented fd (a TUN device, or a datagram socket)
+//! through an io_uring
+//! \details One multishot read request stays in flight, and the kernel completes it into a ring of
+//! provided buffers as packets arrive, so reading a packet costs no system call. (Before Linux 6.7,
+//! which added multishot reads, a one-shot read is re-queued after each packet instead.) Each write is
+//! copied into a buffer of its own and queued; flush() hands the queued writes to the kernel with one
+//! [io_uring_enter(2)](\ref man2::io_uring_enter), so a loop that flushes before each wait makes one system
+//! call per iteration however many packets it writes. fd() is the ring's file descriptor, which is
+//! readable while completions are waiting, so it stands in for the device's in an EventLoop.
+class IoUringPacketIO
+{
+public:
+  //! \param[in] fd is the device or socket, which must outlive the IoUringPacketIO
+  //! \param[in] buffer_count is the number of provided buffers (a power of two) that packets are read into
+  //! \param[in] buffer_size is the size of each, which bounds the packets read
+  //! \throws unix_error if io_uring or provided-buffer rings (Linux 5.19) are unavailable
+  explicit IoUringPacketIO( const FileDescriptor& fd, uint16_t buffer_count = 64, size_t buffer_size = 2048 );
+
+  //! Cancels the read and waits for the writes in flight
+  ~IoUringPacketIO();
+
+  //! \brief Consume completions until one is a packet read, and copy that packet into `packet`
+  //! \returns false if no packet has arrived
+  //! \throws unix_error if a read or an earlier write failed
+  bool read( std::string& packet );
+
+  //! Queue a write of one packet, gathered from `buffers`, until the next flush()
+  void write( std::span<const Ref<std::string>> buffers );
+
+  //! Hand the queued writes (and a re-queued read) to the kernel, with at most one system call
+  void flush() { uring_.submit(); }
+
+  //! The ring's file descriptor, readable while completions are waiting
+  FileDescriptor& fd() { return uring_.fd(); }
+
+  IoUringPacketIO( const IoUringPacketIO& other ) = delete;
+  IoUringPacketIO& operator=( const IoUringPacketIO& other ) = delete;
+  IoUringPacketIO( IoUringPacketIO&& other ) = delete;
+  IoUringPacketIO& operator=( IoUringPacketIO&& other ) = delete;
+
+private:
+  static constexpr uint64_t READ_REQUEST = UINT64_MAX;       // user_data of the read (writes use their slot)
+  static constexpr uint64_t CANCEL_REQUEST = UINT64_MAX - 1; // user_data of the destructor's cancellation
+
+  //! Anonymous memory for the provided-buffer ring, which the kernel needs page-aligned
+  struct RingMemory
+  {
+    void* addr;
+    size_t length;
+
+    explicit RingMemory( size_t s_length );
+    ~RingMemory();
+
+    RingMemory( const RingMemory& other ) = delete;
+    RingMemory& operator=( const RingMemory& other ) = delete;
+    RingMemory( RingMemory&& other ) = delete;
+    RingMemory& operator=( RingMemory&& other ) = delete;
+  };
+
+  int fd_;
+  uint16_t buffer_count_;
+  size_t buffer_size_;
+  std::string buffers_;                  // buffer_count_ buffers of buffer_size_ bytes, provided to the kernel
+  uint16_t ring_tail_ {};                // our copy of the provided-buffer ring's tail
+  std::deque<std::string> writes_ {};    // slot i holds the packet of the write with user_data i
+  std::vector<uint64_t> free_writes_ {}; // slots not in flight
+  bool multishot_ { true };              // until the kernel turns down a multishot read
+  bool read_in_flight_ {};               // queued or in flight, until a completion lacks IORING_CQE_F_MORE
+  RingMemory ring_memory_;
+  IoUring uring_; // declared last, so that the buffers outlive it
+
+  void queue_read();
+  void provide_buffer( uint16_t id ); // give buffer `id` (back) to the kernel
+};
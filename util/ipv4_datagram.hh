@@ -11,11 +11,11 @@
 struct IPv4Datagram
 {
   IPv4Header header {};
-  std::vector<Ref<std::string>> payload {};
+  PacketBuffers payload {};
 
-  void parse( Parser& parser )
+  void parse( Parser& parser, const bool verify_checksum = true )
   {
-    header.parse( parser );
+    header.parse( parser, verify_checksum );
     parser.truncate( header.payload_length() );
     parser.all_remaining( payload );
   }
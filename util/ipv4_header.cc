@@ -2,32 +2,40 @@
 #include "checksum.hh"
 
 #include <arpa/inet.h>
+#include <array>
 #include <sstream>
 
 using namespace std;
 
-// Parse from string.
-void IPv4Header::parse( Parser& parser )
+// Parse from string (the fixed-layout header is decoded in one piece, see Parser::peek_fixed).
+void IPv4Header::parse( Parser& parser, const bool verify_checksum )
 {
+  array<char, LENGTH> scratch {};
+  FixedParser fixed { parser.peek_fixed( scratch ) };
+  if ( parser.has_error() ) {
+    return;
+  }
+
   uint8_t first_byte {};
-  parser.integer( first_byte );
+  fixed.integer( first_byte );
   ver = first_byte >> 4;    // version
   hlen = first_byte & 0x0f; // header length
-  parser.integer( tos );    // type of service
-  parser.integer( len );
-  parser.integer( id );
+  fixed.integer( tos );     // type of service
+  fixed.integer( len );
+  fixed.integer( id );
 
   uint16_t fo_val {};
-  parser.integer( fo_val );
+  fixed.integer( fo_val );
   df = static_cast<bool>( fo_val & 0x4000 ); // don't fragment
   mf = static_cast<bool>( fo_val & 0x2000 ); // more fragments
   offset = fo_val & 0x1fff;                  // offset
 
-  parser.integer( ttl );
-  parser.integer( proto );
-  parser.integer( cksum );
-  parser.integer( src );
-  parser.integer( dst );
+  fixed.integer( ttl );
+  fixed.integer( proto );
+  fixed.integer( cksum );
+  fixed.integer( src );
+  fixed.integer( dst );
+  parser.remove_prefix( LENGTH );
 
   if ( ver != 4 ) {
     parser.set_error();
@@ -43,6 +51,10 @@ void IPv4Header::parse( Parser& parser )
 
   parser.remove_prefix( static_cast<uint64_t>( hlen ) * 4 - IPv4Header::LENGTH );
 
+  if ( not verify_checksum ) {
+    return;
+  }
+
   // Verify checksum
   const uint16_t given_cksum = cksum;
   compute_checksum();
@@ -102,16 +114,40 @@ uint32_t IPv4Header::pseudo_checksum() const
   return pcksum;
 }
 
+// The header's words are summed from its fields, without serializing it
 void IPv4Header::compute_checksum()
 {
-  cksum = 0;
-  Serializer s;
-  serialize( s );
-
-  // calculate checksum -- taken over header only
-  InternetChecksum check;
-  check.add( s.finish() );
-  cksum = check.value();
+  const uint8_t first_byte = ( static_cast<uint32_t>( ver ) << 4 ) | ( hlen & 0xfU );
+  const uint16_t fo_val = ( df ? 0x4000U : 0 ) | ( mf ? 0x2000U : 0 ) | ( offset & 0x1fffU );
+  uint32_t sum = ( static_cast<uint32_t>( first_byte ) << 8 ) | tos;
+  sum += len;
+  sum += id;
+  sum += fo_val;
+  sum += ( static_cast<uint32_t>( ttl ) << 8 ) | proto;
+  sum += ( src >> 16 ) + static_cast<uint16_t>( src );
+  sum += ( dst >> 16 ) + static_cast<uint16_t>( dst );
+
+  cksum = InternetChecksum { sum }.value();
+}
+
+void IPv4Header::set_ttl( const uint8_t new_ttl )
+{
+  // TTL shares its header word with the protocol
+  cksum = InternetChecksum::update(
+    cksum, static_cast<uint16_t>( ttl << 8 | proto ), static_cast<uint16_t>( new_ttl << 8 | proto ) );
+  ttl = new_ttl;
+}
+
+void IPv4Header::set_src( const uint32_t new_src )
+{
+  cksum = InternetChecksum::update32( cksum, src, new_src );
+  src = new_src;
+}
+
+void IPv4Header::set_dst( const uint32_t new_dst )
+{
+  cksum = InternetChecksum::update32( cksum, dst, new_dst );
+  dst = new_dst;
 }
 
 string IPv4Header::to_string() const
@@ -57,9 +57,15 @@ struct IPv4Header
   // Set checksum to correct value
   void compute_checksum();
 
+  // Change a field and adjust the checksum to match, without summing the whole header (RFC 1624)
+  void set_ttl( uint8_t new_ttl );
+  void set_src( uint32_t new_src );
+  void set_dst( uint32_t new_dst );
+
   // Return a string containing a header in human-readable format
   std::string to_string() const;
 
-  void parse( Parser& parser );
+  // (with `verify_checksum` false, the checksum is trusted: see ChecksumOffload)
+  void parse( Parser& parser, bool verify_checksum = true );
   void serialize( Serializer& serializer ) const;
 };
@@ -66,4 +66,11 @@ public:
   const FdAdapterConfig& config() const { return _adapter.config(); } //!< FdAdapterBase::config passthrough
   FdAdapterConfig& config_mut() { return _adapter.config_mut(); }     //!< FdAdapterBase::config_mut passthrough
   void tick( const size_t ms_since_last_tick ) { _adapter.tick( ms_since_last_tick ); }
+
+  //! AdapterT::flush passthrough, for adapters that queue their writes
+  void flush()
+    requires requires( AdapterT a ) { a.flush(); }
+  {
+    _adapter.flush();
+  }
 };
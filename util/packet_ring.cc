@@ -0,0 +1,150 @@
+#include "packet_ring.hh"
+
+#include "buffer_pool.hh"
+#include "exception.hh"
+#include "helpers.hh"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <cerrno>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <stdexcept>
+#include <sys/mman.h>
+
+using namespace std;
+
+PacketRingSocket::Mapping::Mapping( const FileDescriptor& socket, const size_t s_length )
+  : addr( static_cast<char*>(
+    ::mmap( nullptr, s_length, PROT_READ | PROT_WRITE, MAP_SHARED, socket.fd_num(), 0 ) ) )
+  , length( s_length )
+{
+  if ( addr == MAP_FAILED ) { // NOLINT(*-cstyle-cast, *-int-to-ptr)
+    throw unix_error( "mmap packet ring" );
+  }
+}
+
+PacketRingSocket::Mapping::~Mapping()
+{
+  ::munmap( addr, length );
+}
+
+//! \param[in] ifname is the network interface to send and receive frames on
+//! \param[in] config gives the sizes of the rings
+PacketRingSocket::PacketRingSocket( const string& ifname, const PacketRingConfig& config )
+  : PacketSocket( SOCK_RAW, htons( ETH_P_ALL ) ), config_( config ), rings_( *this, set_up_rings() )
+{
+  const unsigned int ifindex = if_nametoindex( ifname.c_str() );
+  if ( ifindex == 0 ) {
+    throw unix_error( "if_nametoindex(" + ifname + ")" );
+  }
+
+  sockaddr_ll address {};
+  address.sll_family = AF_PACKET;
+  address.sll_protocol = htons( ETH_P_ALL );
+  address.sll_ifindex = static_cast<int>( ifindex );
+  bind( { reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) } ); // NOLINT(*-reinterpret-cast)
+}
+
+size_t PacketRingSocket::set_up_rings()
+{
+  if ( config_.block_count == 0 or config_.frame_size <= TX_DATA_OFFSET
+       or config_.block_size % config_.frame_size
+       or ( size_t { config_.tx_frame_count } * config_.frame_size ) % config_.block_size ) {
+    throw runtime_error( "PacketRingSocket: frame size must divide the block size, and the transmit slots "
+                         "must fill whole blocks" );
+  }
+
+  setsockopt( SOL_PACKET, PACKET_VERSION, int { TPACKET_V3 } );
+
+  const uint32_t frames_per_block = config_.block_size / config_.frame_size;
+
+  tpacket_req3 rx {};
+  rx.tp_block_size = config_.block_size;
+  rx.tp_block_nr = config_.block_count;
+  rx.tp_frame_size = config_.frame_size;
+  rx.tp_frame_nr = frames_per_block * config_.block_count;
+  rx.tp_retire_blk_tov = config_.retire_timeout_ms;
+  setsockopt( SOL_PACKET, PACKET_RX_RING, rx );
+
+  // (a V3 transmit ring is a ring of fixed-size slots: the block options apply only to receiving)
+  tpacket_req3 tx {};
+  tx.tp_block_size = config_.block_size;
+  tx.tp_block_nr = config_.tx_frame_count / frames_per_block;
+  tx.tp_frame_size = config_.frame_size;
+  tx.tp_frame_nr = config_.tx_frame_count;
+  setsockopt( SOL_PACKET, PACKET_TX_RING, tx );
+
+  return size_t { config_.block_size } * ( rx.tp_block_nr + tx.tp_block_nr );
+}
+
+size_t PacketRingSocket::receive( vector<EthernetFrame>& frames )
+{
+  frames.clear();
+  return for_each_frame( [&]( const string_view raw ) {
+    // split off the header, so the payload buffer is handed over whole instead of copied again by Parser
+    const size_t header_length = min<size_t>( raw.size(), EthernetHeader::LENGTH );
+    const string_view payload = raw.substr( header_length );
+    array<string, 2> buffers {
+      BufferPool::small(), payload.size() <= BufferPool::LARGE_CAPACITY ? BufferPool::large() : string {} };
+    buffers[0].assign( raw.substr( 0, header_length ) );
+    buffers[1].assign( payload );
+
+    EthernetFrame frame;
+    if ( parse( frame, buffers ) ) {
+      frames.push_back( move( frame ) );
+    }
+  } );
+}
+
+bool PacketRingSocket::queue( const span<const Ref<string>> frame )
+{
+  size_t length = 0;
+  for ( const auto& buffer : frame ) {
+    length += buffer->size();
+  }
+  if ( length > config_.frame_size - TX_DATA_OFFSET ) {
+    throw runtime_error( "PacketRingSocket: frame of " + to_string( length ) + " bytes does not fit a slot" );
+  }
+
+  tpacket3_hdr& slot = tx_slot( tx_slot_ );
+  const uint32_t status = shared( slot.tp_status ).load( memory_order_acquire );
+  if ( status & TP_STATUS_WRONG_FORMAT ) {
+    throw runtime_error( "PacketRingSocket: kernel rejected a queued frame" );
+  }
+  if ( status != TP_STATUS_AVAILABLE ) {
+    return false;
+  }
+
+  char* data = reinterpret_cast<char*>( &slot ) + TX_DATA_OFFSET; // NOLINT(*-reinterpret-cast)
+  for ( const auto& buffer : frame ) {
+    data = ranges::copy( buffer.get(), data ).out;
+  }
+  slot.tp_len = static_cast<uint32_t>( length );
+  shared( slot.tp_status ).store( TP_STATUS_SEND_REQUEST, memory_order_release );
+
+  tx_slot_ = ( tx_slot_ + 1 ) % config_.tx_frame_count;
+  ++tx_queued_;
+  return true;
+}
+
+bool PacketRingSocket::queue( const EthernetFrame& frame )
+{
+  return queue( serialize( frame ) );
+}
+
+void PacketRingSocket::flush()
+{
+  if ( tx_queued_ == 0 ) {
+    return;
+  }
+  if ( ::send( fd_num(), nullptr, 0, MSG_DONTWAIT ) < 0 ) {
+    if ( errno == EAGAIN or errno == ENOBUFS ) {
+      return; // the interface is busy: the frames stay queued for the next flush
+    }
+    throw unix_error( "send" );
+  }
+  register_write();
+  tx_queued_ = 0;
+}
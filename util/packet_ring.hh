@@ -0,0 +1,154 @@
+#pragma once
+
+#include "ethernet_frame.hh"
+#include "ref.hh"
+#include "socket.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <linux/if_packet.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! Sizes of the rings of a PacketRingSocket
+struct PacketRingConfig
+{
+  uint32_t block_size = 1 << 18;  //!< bytes per block of either ring (a multiple of the page size)
+  uint32_t block_count = 16;      //!< blocks in the receive ring
+  uint32_t retire_timeout_ms = 1; //!< how long the kernel waits to fill a receive block before handing it over
+  uint32_t frame_size = 2048;     //!< bytes per transmit slot, including its header (divides block_size)
+  uint32_t tx_frame_count = 1024; //!< slots in the transmit ring (a whole number of blocks)
+};
+
+//! \brief A [packet socket](\ref man7::packet) that exchanges frames with the kernel through TPACKET_V3 rings
+//! \details The kernel writes received frames into blocks of a ring mapped into our memory, and hands
+//! over a block of many frames at a time; the frames are read in place, without a system call or copy
+//! each ([PACKET_MMAP](https://docs.kernel.org/networking/packet_mmap.html)). Frames to send are copied
+//! into the slots of a transmit ring and handed to the kernel together by one send(2).
+//!
+//! The socket is readable (e.g. for an EventLoop rule) once a receive block is ready.
+class PacketRingSocket : public PacketSocket
+{
+public:
+  //! Open a socket for the frames of every protocol on interface `ifname`
+  explicit PacketRingSocket( const std::string& ifname, const PacketRingConfig& config = {} );
+
+  //! \brief Call `f( frame )` for each frame received, with `frame` a std::string_view into the ring
+  //! \details The view is only valid during the call: each block goes back to the kernel once its
+  //! frames have been visited. If `f` throws, the block goes back with the frames not yet visited.
+  //! \returns the number of frames (0 if no block was ready)
+  template<typename F>
+  size_t for_each_frame( F&& f );
+
+  //! \brief Receive the frames that are ready, parsed into `frames` (whose earlier contents are cleared)
+  //! \details A parsed payload outlives the ring's block, so each frame is copied once, into buffers from
+  //! the BufferPool. Frames that do not parse are skipped.
+  //! \returns the number of frames received, including those skipped
+  size_t receive( std::vector<EthernetFrame>& frames );
+
+  //! Copy a frame into the next transmit slot, returning false if the kernel has not yet sent the slot's
+  //! previous frame (flush() sends the queued frames)
+  bool queue( std::span<const Ref<std::string>> frame );
+  bool queue( const EthernetFrame& frame );
+
+  //! Hand the queued frames to the kernel with one send(2), without waiting for them to be sent
+  void flush();
+
+  PacketRingSocket( const PacketRingSocket& other ) = delete;
+  PacketRingSocket& operator=( const PacketRingSocket& other ) = delete;
+  PacketRingSocket( PacketRingSocket&& other ) = delete;
+  PacketRingSocket& operator=( PacketRingSocket&& other ) = delete;
+  ~PacketRingSocket() = default;
+
+private:
+  //! Both rings, mapped from the socket (receive ring first)
+  struct Mapping
+  {
+    char* addr;
+    size_t length;
+
+    Mapping( const FileDescriptor& socket, size_t s_length );
+    ~Mapping();
+
+    Mapping( const Mapping& other ) = delete;
+    Mapping& operator=( const Mapping& other ) = delete;
+    Mapping( Mapping&& other ) = delete;
+    Mapping& operator=( Mapping&& other ) = delete;
+  };
+
+  //! Where a frame's data starts in its transmit slot
+  static constexpr size_t TX_DATA_OFFSET = TPACKET_ALIGN( sizeof( tpacket3_hdr ) );
+
+  PacketRingConfig config_;
+  Mapping rings_;
+  uint32_t rx_block_ {}; //!< next receive block to look at
+  uint32_t tx_slot_ {};  //!< next transmit slot to fill
+  size_t tx_queued_ {};  //!< frames queued since the last flush
+
+  //! Switch the socket to TPACKET_V3 and create its rings, returning the length of their mapping
+  size_t set_up_rings();
+
+  tpacket_block_desc& rx_block( uint32_t index ) const
+  {
+    // NOLINTNEXTLINE(*-reinterpret-cast, *-pointer-arithmetic)
+    return *reinterpret_cast<tpacket_block_desc*>( rings_.addr + size_t { index } * config_.block_size );
+  }
+
+  tpacket3_hdr& tx_slot( uint32_t index ) const
+  {
+    const size_t rx_length = size_t { config_.block_size } * config_.block_count;
+    // NOLINTNEXTLINE(*-reinterpret-cast, *-pointer-arithmetic)
+    return *reinterpret_cast<tpacket3_hdr*>( rings_.addr + rx_length + size_t { index } * config_.frame_size );
+  }
+
+  static std::atomic_ref<uint32_t> shared( uint32_t& x ) { return std::atomic_ref<uint32_t> { x }; }
+};
+
+template<typename F>
+size_t PacketRingSocket::for_each_frame( F&& f )
+{
+  // hands a block back to the kernel when its frames have been visited, or when f throws (dropping the
+  // block's remaining frames), so that the ring never stalls on a block
+  struct BlockRelease
+  {
+    PacketRingSocket& socket;
+    tpacket_hdr_v1& header;
+
+    BlockRelease( PacketRingSocket& s_socket, tpacket_hdr_v1& s_header ) : socket( s_socket ), header( s_header ) {}
+    BlockRelease( const BlockRelease& other ) = delete;
+    BlockRelease& operator=( const BlockRelease& other ) = delete;
+    BlockRelease( BlockRelease&& other ) = delete;
+    BlockRelease& operator=( BlockRelease&& other ) = delete;
+
+    ~BlockRelease()
+    {
+      shared( header.block_status ).store( TP_STATUS_KERNEL, std::memory_order_release );
+      socket.rx_block_ = ( socket.rx_block_ + 1 ) % socket.config_.block_count;
+      socket.register_read();
+    }
+  };
+
+  size_t frames = 0;
+  for ( uint32_t n = 0; n < config_.block_count; ++n ) {
+    tpacket_block_desc& block = rx_block( rx_block_ );
+    tpacket_hdr_v1& header = block.hdr.bh1;
+    if ( not( shared( header.block_status ).load( std::memory_order_acquire ) & TP_STATUS_USER ) ) {
+      break;
+    }
+    const BlockRelease release { *this, header };
+
+    // NOLINTBEGIN(*-reinterpret-cast, *-pointer-arithmetic)
+    const char* frame = reinterpret_cast<const char*>( &block ) + header.offset_to_first_pkt;
+    for ( uint32_t i = 0; i < header.num_pkts; ++i ) {
+      const auto& frame_header = *reinterpret_cast<const tpacket3_hdr*>( frame );
+      f( std::string_view { frame + frame_header.tp_mac, frame_header.tp_snaplen } );
+      frame += frame_header.tp_next_offset;
+    }
+    // NOLINTEND(*-reinterpret-cast, *-pointer-arithmetic)
+    frames += header.num_pkts;
+  }
+  return frames;
+}
@@ -13,6 +13,17 @@ string_view Parser::BufferList::peek() const
   return string_view { buffer_.front().get() }.substr( skip_ );
 }
 
+void Parser::BufferList::copy_prefix( span<char> out ) const
+{
+  auto next = out.begin();
+  auto tmp_skip = skip_;
+  for ( auto it = buffer_.begin(); next != out.end() and it != buffer_.end(); ++it ) {
+    const auto view = string_view { it->get() }.substr( tmp_skip, out.end() - next );
+    next = copy( view.begin(), view.end(), next );
+    tmp_skip = 0;
+  }
+}
+
 void Parser::BufferList::remove_prefix( uint64_t len )
 {
   while ( len and not buffer_.empty() ) {
@@ -20,7 +31,7 @@ void Parser::BufferList::remove_prefix( uint64_t len )
     skip_ += to_pop_now;
     len -= to_pop_now;
     size_ -= to_pop_now;
-    if ( skip_ == buffer_.front()->size() ) {
+    if ( skip_ == buffer_.front().get().size() ) {
       buffer_.pop_front();
       skip_ = 0;
     }
@@ -67,14 +78,14 @@ void Parser::BufferList::truncate( size_t len )
   size_ = len;
 }
 
-void Parser::BufferList::dump_all( vector<Ref<std::string>>& out )
+void Parser::BufferList::dump_all( PacketBuffers& out )
 {
   out.clear();
   if ( empty() ) {
     return;
   }
   if ( skip_ ) {
-    out.emplace_back( buffer_.front()->substr( skip_ ) );
+    out.emplace_back( buffer_.front().get().substr( skip_ ) );
   } else {
     out.push_back( move( buffer_.front() ) );
   }
@@ -114,9 +125,25 @@ void Parser::string( span<char> out )
   }
 }
 
+string_view Parser::peek_fixed( span<char> scratch )
+{
+  check_size( scratch.size() );
+  if ( has_error() ) {
+    return {};
+  }
+
+  const string_view current = input_.peek();
+  if ( current.size() >= scratch.size() ) {
+    return current.substr( 0, scratch.size() );
+  }
+
+  input_.copy_prefix( scratch );
+  return { scratch.data(), scratch.size() };
+}
+
 void Parser::concatenate_all_remaining( std::string& out )
 {
-  vector<Ref<std::string>> concat;
+  PacketBuffers concat;
   all_remaining( concat );
   if ( concat.empty() ) {
     out.clear();
@@ -138,6 +165,28 @@ void Serializer::flush()
   }
 }
 
+void Serializer::reserve( const size_t length )
+{
+  const size_t needed = buffer_.size() + length;
+  if ( buffer_.capacity() >= needed and buffer_.capacity() >= BufferPool::SMALL_CAPACITY ) {
+    return;
+  }
+
+  string bigger = needed <= BufferPool::SMALL_CAPACITY   ? BufferPool::small()
+                  : needed <= BufferPool::LARGE_CAPACITY ? BufferPool::large()
+                                                         : string {};
+  bigger.reserve( needed );
+  bigger.append( buffer_ );
+  BufferPool::recycle( move( buffer_ ) );
+  buffer_ = move( bigger );
+}
+
+void Serializer::append( const string_view bytes )
+{
+  reserve( bytes.size() );
+  buffer_.append( bytes );
+}
+
 void Serializer::buffer( string buf )
 {
   if ( not buf.empty() ) {
@@ -154,14 +203,14 @@ void Serializer::buffer( Ref<string> buf )
   }
 }
 
-void Serializer::buffer( const vector<Ref<string>>& bufs )
+void Serializer::buffer( const span<const Ref<string>> bufs )
 {
   for ( const auto& b : bufs ) {
     buffer( b.borrow() );
   }
 }
 
-vector<Ref<string>> Serializer::finish()
+PacketBuffers Serializer::finish()
 {
   flush();
   return move( output_ );
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "ref.hh"
 
+#include <bit>
 #include <concepts>
 #include <cstdint>
+#include <cstring>
 #include <deque>
 #include <ranges>
 #include <span>
@@ -12,6 +15,21 @@
 #include <string_view>
 #include <vector>
 
+// Convert an integer between big-endian (network) and host byte order
+template<std::unsigned_integral T>
+constexpr T big_endian( const T val )
+{
+  if constexpr ( sizeof( T ) == 1 or std::endian::native == std::endian::big ) {
+    return val;
+  } else if constexpr ( sizeof( T ) == 2 ) {
+    return __builtin_bswap16( val );
+  } else if constexpr ( sizeof( T ) == 4 ) {
+    return __builtin_bswap32( val );
+  } else {
+    return __builtin_bswap64( val );
+  }
+}
+
 class Parser
 {
   class BufferList
@@ -29,7 +47,7 @@ class Parser
         if ( buffer_.back().is_borrowed() ) {
           throw std::runtime_error( "cannot parse borrowed string" );
         }
-        size_ += buffer_.back()->size();
+        size_ += buffer_.back().get().size();
       }
     }
 
@@ -39,9 +57,10 @@ class Parser
     size_t buffer_segment_count() const { return buffer_.size(); }
 
     std::string_view peek() const;
+    void copy_prefix( std::span<char> out ) const;
     void remove_prefix( uint64_t len );
     void truncate( size_t len );
-    void dump_all( std::vector<Ref<std::string>>& out );
+    void dump_all( PacketBuffers& out );
     std::vector<std::string_view> buffer() const;
   };
 
@@ -63,12 +82,16 @@ public:
   void remove_prefix( size_t n ) { input_.remove_prefix( n ); }
   void truncate( size_t len ) { input_.truncate( len ); }
 
-  void all_remaining( std::vector<Ref<std::string>>& out ) { input_.dump_all( out ); }
+  void all_remaining( PacketBuffers& out ) { input_.dump_all( out ); }
   std::vector<std::string_view> buffer() const { return input_.buffer(); }
 
   void string( std::span<char> out );
   void concatenate_all_remaining( std::string& out );
 
+  // The next `scratch.size()` bytes, without advancing past them: a view into the current buffer if they are
+  // contiguous there, or else copied into `scratch` (for a fixed-layout header; see FixedParser)
+  std::string_view peek_fixed( std::span<char> scratch );
+
   template<std::unsigned_integral T>
   void integer( T& out )
   {
@@ -77,6 +100,13 @@ public:
       return;
     }
 
+    if ( const std::string_view current = input_.peek(); current.size() >= sizeof( T ) ) {
+      std::memcpy( &out, current.data(), sizeof( T ) );
+      out = big_endian( out );
+      input_.remove_prefix( sizeof( T ) );
+      return;
+    }
+
     if constexpr ( sizeof( T ) == 1 ) {
       out = static_cast<uint8_t>( input_.peek().front() );
       input_.remove_prefix( 1 );
@@ -92,9 +122,29 @@ public:
   }
 };
 
+// Decodes the fields of a fixed-layout header from one contiguous view (see Parser::peek_fixed)
+class FixedParser
+{
+  std::string_view input_;
+
+public:
+  explicit FixedParser( const std::string_view input ) : input_( input ) {}
+
+  template<std::unsigned_integral T>
+  void integer( T& out )
+  {
+    if ( input_.size() < sizeof( T ) ) {
+      throw std::out_of_range( "FixedParser::integer() past the end of the header" );
+    }
+    std::memcpy( &out, input_.data(), sizeof( T ) );
+    out = big_endian( out );
+    input_.remove_prefix( sizeof( T ) );
+  }
+};
+
 class Serializer
 {
-  std::vector<Ref<std::string>> output_ {};
+  PacketBuffers output_ {};
   std::string buffer_ {};
 
   void flush();
@@ -103,16 +153,38 @@ public:
   template<std::unsigned_integral T>
   void integer( const T val )
   {
-    constexpr uint64_t len = sizeof( T );
+    if ( buffer_.capacity() < BufferPool::SMALL_CAPACITY ) {
+      reserve( sizeof( T ) ); // the finished buffer (a Ref) returns to the pool once written
+    }
+
+    const T big_endian_val = big_endian( val );
+    buffer_.append( reinterpret_cast<const char*>( &big_endian_val ), sizeof( T ) ); // NOLINT(*-reinterpret-cast)
+  }
+
+  // Make room for `length` more pending bytes in one buffer (from the BufferPool if it fits), so that a
+  // packet's headers and the payload append()ed after them are written contiguously, without reallocating
+  void reserve( size_t length );
+
+  // Copy bytes into the pending buffer, after the integers written so far
+  void append( std::string_view bytes );
+
+  // The bytes written by integer() and append() since the last buffer (not yet part of the output)
+  std::string_view pending() const { return buffer_; }
 
-    for ( uint64_t i = 0; i < len; ++i ) {
-      const uint8_t byte_val = val >> ( ( len - i - 1 ) * 8 );
-      buffer_.push_back( byte_val );
+  // Overwrite an integer written earlier, at `offset` bytes into pending() (e.g. to fill in a checksum)
+  template<std::unsigned_integral T>
+  void patch_integer( const size_t offset, const T val )
+  {
+    constexpr uint64_t len = sizeof( T );
+    if ( offset + len > buffer_.size() ) {
+      throw std::out_of_range( "Serializer::patch_integer() past the pending bytes" );
     }
+    const T big_endian_val = big_endian( val );
+    std::memcpy( buffer_.data() + offset, &big_endian_val, len ); // NOLINT(*-pointer-arithmetic)
   }
 
   void buffer( std::string buf );
   void buffer( Ref<std::string> buf );
-  void buffer( const std::vector<Ref<std::string>>& bufs );
-  std::vector<Ref<std::string>> finish();
+  void buffer( std::span<const Ref<std::string>> bufs );
+  PacketBuffers finish();
 };
@@ -1,12 +1,24 @@
 #pragma once
 
+#include "buffer_pool.hh"
+#include "small_vector.hh"
+
+#include <atomic>
+#include <cstdint>
 #include <optional>
 #include <stdexcept>
+#include <string>
+#include <utility>
 
 /*
  * A Ref<T> represents a "borrowed"-or-"owned" reference to an object of type T.
  * Whether "borrowed" or "owned", the Ref exposes a constant reference to the inner T.
  * If "owned", the inner T can also be accessed by non-const reference (and mutated).
+ *
+ * An owned Ref becomes "shared" when it is first duplicated with share(): the object moves into refcounted
+ * storage, and from then on duplicating the Ref only increments the count, instead of copying the object.
+ * A shared object is immutable while more than one Ref shares it; mutating it through one of them copies
+ * it first.
  */
 template<typename T>
 class Ref
@@ -24,11 +36,24 @@ public:
   // construct from rvalue reference -> owned reference (moved from original)
   Ref( T&& obj ) : obj_( std::move( obj ) ) {} // NOLINT(*-explicit-*)
 
-  // move constructor: move from original (owned or borrowed)
-  Ref( Ref&& other ) noexcept = default;
+  // move constructor: move from original (owned, borrowed or shared)
+  Ref( Ref&& other ) noexcept
+    : borrowed_obj_( other.borrowed_obj_ )
+    , obj_( std::move( other.obj_ ) )
+    , shared_( std::exchange( other.shared_, nullptr ) )
+  {}
 
-  // move-assignment: move from original (owned or borrowed)
-  Ref& operator=( Ref&& other ) noexcept = default;
+  // move-assignment: move from original (owned, borrowed or shared)
+  Ref& operator=( Ref&& other ) noexcept
+  {
+    if ( this != &other ) {
+      Shared* const previous = std::exchange( shared_, std::exchange( other.shared_, nullptr ) );
+      borrowed_obj_ = other.borrowed_obj_;
+      obj_ = std::move( other.obj_ );
+      release_shared( previous );
+    }
+    return *this;
+  }
 
   // borrow from const reference: borrowed reference (points to original)
   static Ref borrow( const T& obj )
@@ -46,16 +71,38 @@ public:
     return ret;
   }
 
+  // duplicate Ref by producing shared reference to same object. An owned object first moves into
+  // refcounted storage (so this Ref becomes shared as well): its value is unchanged, but references to the
+  // object from an earlier get() (or views of a short string's characters, which live inside it) are not.
+  // That changes this Ref, so a const Ref can only be shared if it already is (by copying it).
+  Ref share()
+  {
+    if ( obj_.has_value() ) {
+      shared_ = new Shared { std::move( *obj_ ) }; // NOLINT(*-owning-memory)
+      obj_.reset();
+      borrowed_obj_ = &shared_->value;
+    } else if ( not shared_ ) {
+      throw std::runtime_error( "attempt to share borrowed Ref" );
+    }
+
+    return add_reference();
+  }
+
 #ifndef DISALLOW_REF_IMPLICIT_COPY
-  // implicit copy via copy constructor -> owned reference (copied from original)
-  Ref( const Ref& other ) : obj_( other.get() ) {}
+  // implicit copy via copy constructor -> shared reference if original is shared, else owned (copied)
+  Ref( const Ref& other ) : Ref( other.is_shared() ? other.add_reference() : Ref { T { other.get() } } ) {}
 
-  // implicit copy via copy-assignment -> owned reference (copied from original)
+  // implicit copy via copy-assignment -> shared reference if original is shared, else owned (copied)
   Ref& operator=( const Ref& other )
   {
     if ( this != &other ) {
-      obj_ = other.get();
-      borrowed_obj_ = nullptr;
+      if ( other.is_shared() ) {
+        *this = other.add_reference();
+      } else {
+        obj_ = other.get();
+        borrowed_obj_ = nullptr;
+        release_shared( std::exchange( shared_, nullptr ) );
+      }
     }
     return *this;
   }
@@ -65,19 +112,38 @@ public:
   Ref& operator=( const Ref& other ) = delete;
 #endif
 
-  ~Ref() = default;
+  // an owned string (or the last reference to a shared one) goes back to the packet buffer pool (see BufferPool)
+  ~Ref()
+  {
+    if constexpr ( std::is_same_v<T, std::string> ) {
+      if ( obj_.has_value() ) {
+        BufferPool::recycle( std::move( *obj_ ) );
+      }
+    }
+    release_shared( shared_ );
+  }
 
   bool is_owned() const { return obj_.has_value(); }
-  bool is_borrowed() const { return not is_owned(); }
+  bool is_shared() const { return shared_ != nullptr; }
+  bool is_borrowed() const { return not is_owned() and not is_shared(); }
 
   // accessors
 
   // const reference to object (owned or borrowed)
   const T& get() const { return obj_.has_value() ? *obj_ : *borrowed_obj_; }
 
-  // mutable reference to object (owned only)
+  // mutable reference to object (owned, or shared: copied first unless this is the only reference)
   T& get_mut()
   {
+    if ( shared_ ) {
+      if ( shared_->refs.load( std::memory_order_acquire ) == 1 ) {
+        return shared_->value;
+      }
+      obj_.emplace( shared_->value );
+      borrowed_obj_ = nullptr;
+      release_shared( std::exchange( shared_, nullptr ) );
+    }
+
     if ( not obj_.has_value() ) {
       throw std::runtime_error( "attempt to mutate borrowed Ref" );
     }
@@ -101,6 +167,10 @@ public:
       return std::move( *obj_ );
     }
 
+    if ( shared_ ) {
+      return std::move( get_mut() );
+    }
+
 #ifndef DISALLOW_REF_IMPLICIT_COPY
     return get();
 #else
@@ -109,8 +179,36 @@ public:
   }
 
 private:
-  const T* borrowed_obj_ {};
+  // an intrusively refcounted object, shared by the Refs that point to it
+  struct Shared
+  {
+    T value;
+    std::atomic<uint32_t> refs { 1 };
+  };
+
+  const T* borrowed_obj_ {}; // also points to the shared object, if any
   std::optional<T> obj_ {};
+  Shared* shared_ {};
+
+  // another reference to the shared object (which this Ref must already be sharing)
+  Ref add_reference() const
+  {
+    shared_->refs.fetch_add( 1, std::memory_order_relaxed );
+    Ref ret { uninitialized };
+    ret.borrowed_obj_ = borrowed_obj_;
+    ret.shared_ = shared_;
+    return ret;
+  }
+
+  static void release_shared( Shared* const shared ) noexcept
+  {
+    if ( shared and shared->refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+      if constexpr ( std::is_same_v<T, std::string> ) {
+        BufferPool::recycle( std::move( shared->value ) );
+      }
+      delete shared; // NOLINT(*-owning-memory)
+    }
+  }
 
   struct uninitialized_t
   {};
@@ -124,3 +222,7 @@ static Ref<T> borrow( const T& obj )
 {
   return Ref<T>::borrow( obj );
 }
+
+// The buffers of one packet (typically a header or two and a payload), kept inline so that building,
+// moving and cloning a frame or datagram does not allocate
+using PacketBuffers = SmallVector<Ref<std::string>, 4>;
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_listener.hh"
+#include "tcp_stack.hh"
+#include "tun.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//! \brief A TCP stack that spreads its connections across several TCPStack worker threads
+//! \details Each worker owns a disjoint set of connections, chosen by the hash of their FourTuple, so
+//! no per-connection state is shared between threads. An ingress thread reads every datagram from the
+//! interface, looks only at its addresses and ports, and forwards it to the worker that owns the
+//! connection (in the manner of receive-side scaling). Workers write outgoing datagrams straight to
+//! the interface.
+//!
+//! Given the queues of a multiqueue TUN device, there is one ingress thread per queue, and each worker
+//! writes to its own queue. Since the kernel delivers a flow's datagrams to the queue that last wrote
+//! one of its datagrams, a connection's ingress usually lands on its worker's queue, and no single
+//! thread reads every datagram.
+//!
+//! A listener is registered with every worker and they share one accept queue.
+class ShardedTCPStack
+{
+public:
+  //! Construct from the TUN device that carries IPv4 datagrams in both directions (opened without
+  //! tcp_offload, or this throws)
+  ShardedTCPStack( TunFD&& tun, size_t workers );
+
+  //! Construct from separate ingress and egress file descriptors (see TCPStack)
+  ShardedTCPStack( FileDescriptor&& ingress, FileDescriptor&& egress, size_t workers );
+
+  //! Construct from the queues of a multiqueue TUN device (see TunFD::open_queues), with one worker
+  //! and one ingress thread per queue (the queues must be opened without tcp_offload, or this throws)
+  explicit ShardedTCPStack( std::vector<TunFD>&& queues );
+
+  //! Open a connection on the worker that owns its four-tuple (see TCPStack::connect)
+  LocalStreamSocket connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+
+  //! Listen on every worker, with one shared backlog (see TCPStack::listen)
+  TCPListener listen( const TCPConfig& c_tcp, const Address& local, size_t backlog = TCPStack::DEFAULT_BACKLOG );
+
+  //! Number of connections currently served by all workers
+  size_t connection_count() const;
+
+  size_t worker_count() const { return workers_.size(); }
+
+  //! Stop the ingress and worker threads; any open connections are abandoned
+  ~ShardedTCPStack();
+
+  ShardedTCPStack( const ShardedTCPStack& ) = delete;
+  ShardedTCPStack( ShardedTCPStack&& ) = delete;
+  ShardedTCPStack& operator=( const ShardedTCPStack& ) = delete;
+  ShardedTCPStack& operator=( ShardedTCPStack&& ) = delete;
+
+private:
+  //! Interfaces read by the ingress threads (one each)
+  std::vector<FileDescriptor> ingress_;
+
+  //! Worker stacks, and the sockets each ingress thread uses to hand each worker its datagrams
+  //! (indexed by ingress thread, then by worker)
+  std::vector<std::unique_ptr<TCPStack>> workers_ {};
+  std::vector<std::vector<FileDescriptor>> worker_ingress_ {};
+
+  //! Written to stop the ingress threads (which each read it through their own dup)
+  LocalStreamSocket stop_sender_;
+  LocalStreamSocket stop_receiver_;
+
+  std::atomic_bool stop_ { false };
+  std::vector<std::thread> ingress_threads_ {};
+
+  //! Index of the worker that owns a connection
+  size_t worker_for( const FourTuple& flow ) const { return flow.hash() % workers_.size(); }
+
+  //! Main loop of an ingress thread
+  void steer_loop( size_t ingress_index );
+
+  ShardedTCPStack( std::vector<FileDescriptor>&& ingress,
+                   std::vector<FileDescriptor>&& egress,
+                   size_t workers,
+                   std::pair<LocalStreamSocket, LocalStreamSocket> stop_pair );
+};
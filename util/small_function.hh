@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template<typename Signature, size_t Capacity = 4 * sizeof( void* )>
+class SmallFunction;
+
+//! \brief A move-only std::function that keeps small callables inline
+//! \details A callable of up to `Capacity` bytes (e.g. a lambda capturing a few references) is stored in
+//! the object itself, so constructing, moving and calling it never allocates; a larger one (or one
+//! whose move constructor may throw) is stored on the heap. Calling an empty SmallFunction throws
+//! std::bad_function_call.
+template<typename R, typename... Args, size_t Capacity>
+class SmallFunction<R( Args... ), Capacity>
+{
+public:
+  SmallFunction() = default;
+  SmallFunction( std::nullptr_t ) {} // NOLINT(*-explicit-*)
+
+  template<typename F>
+    requires( not std::is_same_v<std::remove_cvref_t<F>, SmallFunction>
+              and std::is_invocable_r_v<R, std::decay_t<F>&, Args...> )
+  SmallFunction( F&& f ) // NOLINT(*-explicit-*, *-forwarding-reference-overload)
+  {
+    using T = std::decay_t<F>;
+    if constexpr ( fits_inline<T> ) {
+      ::new ( static_cast<void*>( storage_ ) ) T( std::forward<F>( f ) );
+    } else {
+      ::new ( static_cast<void*>( storage_ ) ) T*( new T( std::forward<F>( f ) ) );
+    }
+    ops_ = &ops_for<T>;
+  }
+
+  SmallFunction( SmallFunction&& other ) noexcept : ops_( other.ops_ )
+  {
+    if ( ops_ ) {
+      ops_->relocate( storage_, other.storage_ );
+      other.ops_ = nullptr;
+    }
+  }
+
+  SmallFunction& operator=( SmallFunction&& other ) noexcept
+  {
+    if ( this != &other ) {
+      reset();
+      if ( other.ops_ ) {
+        other.ops_->relocate( storage_, other.storage_ );
+        std::swap( ops_, other.ops_ );
+      }
+    }
+    return *this;
+  }
+
+  SmallFunction( const SmallFunction& other ) = delete;
+  SmallFunction& operator=( const SmallFunction& other ) = delete;
+
+  ~SmallFunction() { reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  R operator()( Args... args ) const
+  {
+    if ( not ops_ ) {
+      throw std::bad_function_call();
+    }
+    return ops_->invoke( storage_, std::forward<Args>( args )... );
+  }
+
+  //! Destroy the callable, leaving the SmallFunction empty
+  void reset()
+  {
+    if ( ops_ ) {
+      ops_->destroy( storage_ );
+      ops_ = nullptr;
+    }
+  }
+
+private:
+  template<typename T>
+  static constexpr bool fits_inline = sizeof( T ) <= Capacity and alignof( T ) <= alignof( std::max_align_t )
+                                      and std::is_nothrow_move_constructible_v<T>;
+
+  struct Ops
+  {
+    R ( *invoke )( void* storage, Args&&... args );
+    void ( *relocate )( void* to, void* from ) noexcept; // move-construct at `to`, then destroy `from`
+    void ( *destroy )( void* storage ) noexcept;
+  };
+
+  template<typename T>
+  static T& target( void* storage )
+  {
+    if constexpr ( fits_inline<T> ) {
+      return *std::launder( static_cast<T*>( storage ) );
+    } else {
+      return **std::launder( static_cast<T**>( storage ) );
+    }
+  }
+
+  template<typename T>
+  static constexpr Ops ops_for {
+    []( void* storage, Args&&... args ) -> R {
+      return std::invoke( target<T>( storage ), std::forward<Args>( args )... );
+    },
+    []( void* to, void* from ) noexcept {
+      if constexpr ( fits_inline<T> ) {
+        T& source = target<T>( from );
+        ::new ( to ) T( std::move( source ) );
+        source.~T();
+      } else {
+        ::new ( to ) T*( *std::launder( static_cast<T**>( from ) ) );
+      }
+    },
+    []( void* storage ) noexcept {
+      if constexpr ( fits_inline<T> ) {
+        target<T>( storage ).~T();
+      } else {
+        delete *std::launder( static_cast<T**>( storage ) );
+      }
+    } };
+
+  alignas( std::max_align_t ) mutable std::byte storage_[Capacity] {}; // NOLINT(*-c-arrays)
+  const Ops* ops_ {};
+};
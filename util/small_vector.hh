@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! \brief A std::vector-like sequence that keeps its first `N` elements inline
+//! \details Up to `N` elements are stored in the object itself, so constructing, filling and moving a
+//! SmallVector of that many never allocates; growing beyond `N` moves the elements to the heap, as a
+//! std::vector would. Moving an inline SmallVector moves its elements one by one (so `T` should be
+//! cheap to move), and leaves the source empty.
+template<typename T, size_t N>
+class SmallVector
+{
+  static_assert( N > 0 );
+  static_assert( std::is_nothrow_move_constructible_v<T> );
+
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector() = default;
+
+  SmallVector( std::initializer_list<T> init )
+    requires std::is_copy_constructible_v<T>
+    : SmallVector( init.begin(), init.end() )
+  {}
+
+  template<std::input_iterator It, std::sentinel_for<It> S>
+  SmallVector( It first, S last )
+  {
+    for ( ; first != last; ++first ) {
+      emplace_back( *first );
+    }
+  }
+
+  //! Take the elements of a std::vector
+  SmallVector( std::vector<T>&& other ) // NOLINT(*-explicit-*)
+  {
+    reserve( other.size() );
+    for ( auto& x : other ) {
+      emplace_back( std::move( x ) );
+    }
+    other.clear();
+  }
+
+  //! Hand the elements over to a std::vector
+  operator std::vector<T>() && // NOLINT(*-explicit-*)
+  {
+    std::vector<T> ret;
+    ret.reserve( size_ );
+    for ( auto& x : *this ) {
+      ret.push_back( std::move( x ) );
+    }
+    clear();
+    return ret;
+  }
+
+  SmallVector( const SmallVector& other )
+    requires std::is_copy_constructible_v<T>
+    : SmallVector( other.begin(), other.end() )
+  {}
+
+  SmallVector& operator=( const SmallVector& other )
+    requires std::is_copy_constructible_v<T>
+  {
+    if ( this != &other ) {
+      clear();
+      reserve( other.size() );
+      for ( const auto& x : other ) {
+        emplace_back( x );
+      }
+    }
+    return *this;
+  }
+
+  SmallVector( SmallVector&& other ) noexcept { take( std::move( other ) ); }
+
+  SmallVector& operator=( SmallVector&& other ) noexcept
+  {
+    if ( this != &other ) {
+      release();
+      take( std::move( other ) );
+    }
+    return *this;
+  }
+
+  ~SmallVector() { release(); }
+
+  // element access
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+  T& operator[]( const size_t i ) { return data_[i]; }             // NOLINT(*-pointer-arithmetic)
+  const T& operator[]( const size_t i ) const { return data_[i]; } // NOLINT(*-pointer-arithmetic)
+  T& front() { return data_[0]; }
+  const T& front() const { return data_[0]; }
+  T& back() { return data_[size_ - 1]; }             // NOLINT(*-pointer-arithmetic)
+  const T& back() const { return data_[size_ - 1]; } // NOLINT(*-pointer-arithmetic)
+
+  T& at( const size_t i ) { return ( check( i ), data_[i] ); }             // NOLINT(*-pointer-arithmetic)
+  const T& at( const size_t i ) const { return ( check( i ), data_[i] ); } // NOLINT(*-pointer-arithmetic)
+
+  // iterators
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; } // NOLINT(*-pointer-arithmetic)
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; } // NOLINT(*-pointer-arithmetic)
+
+  // capacity
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool is_inline() const { return data_ == inline_data(); }
+
+  void reserve( const size_t new_capacity )
+  {
+    if ( new_capacity > capacity_ ) {
+      reallocate( new_capacity );
+    }
+  }
+
+  // modifiers
+
+  template<typename... Args>
+  T& emplace_back( Args&&... args )
+  {
+    if ( size_ == capacity_ ) {
+      reallocate( 2 * capacity_ );
+    }
+    T* slot = std::construct_at( data_ + size_, std::forward<Args>( args )... ); // NOLINT(*-pointer-arithmetic)
+    ++size_;
+    return *slot;
+  }
+
+  void push_back( const T& x ) { emplace_back( x ); }
+  void push_back( T&& x ) { emplace_back( std::move( x ) ); }
+
+  void pop_back()
+  {
+    --size_;
+    std::destroy_at( data_ + size_ ); // NOLINT(*-pointer-arithmetic)
+  }
+
+  void clear()
+  {
+    std::destroy( begin(), end() );
+    size_ = 0;
+  }
+
+private:
+  T* data_ { inline_data() };
+  size_t size_ {};
+  size_t capacity_ { N };
+  alignas( T ) std::byte inline_[N * sizeof( T )] {};
+
+  T* inline_data() { return reinterpret_cast<T*>( inline_ ); } // NOLINT(*-reinterpret-cast)
+  const T* inline_data() const
+  {
+    return reinterpret_cast<const T*>( inline_ ); // NOLINT(*-reinterpret-cast)
+  }
+
+  void check( const size_t i ) const
+  {
+    if ( i >= size_ ) {
+      throw std::out_of_range( "SmallVector::at()" );
+    }
+  }
+
+  // Move the elements to a heap array of `new_capacity`
+  void reallocate( const size_t new_capacity )
+  {
+    T* const fresh = std::allocator<T> {}.allocate( new_capacity );
+    std::uninitialized_move( begin(), end(), fresh );
+    std::destroy( begin(), end() );
+    if ( not is_inline() ) {
+      std::allocator<T> {}.deallocate( data_, capacity_ );
+    }
+    data_ = fresh;
+    capacity_ = new_capacity;
+  }
+
+  // Destroy the elements and free any heap array, leaving the vector empty and inline
+  void release()
+  {
+    clear();
+    if ( not is_inline() ) {
+      std::allocator<T> {}.deallocate( data_, capacity_ );
+      data_ = inline_data();
+      capacity_ = N;
+    }
+  }
+
+  // Take the elements of `other` (this vector being empty and inline), leaving `other` empty
+  void take( SmallVector&& other ) noexcept
+  {
+    if ( other.is_inline() ) {
+      std::uninitialized_move( other.begin(), other.end(), inline_data() );
+      size_ = other.size_;
+      other.clear();
+    } else {
+      data_ = std::exchange( other.data_, other.inline_data() );
+      size_ = std::exchange( other.size_, 0 );
+      capacity_ = std::exchange( other.capacity_, N );
+    }
+  }
+};
@@ -1,12 +1,39 @@
 #include "socket.hh"
 
+#include "buffer_pool.hh"
 #include "exception.hh"
 
+#include <algorithm>
 #include <linux/if_packet.h>
 #include <stdexcept>
+#include <sys/uio.h>
 
 using namespace std;
 
+namespace {
+
+// headers for recvmmsg and sendmmsg, kept per thread so that batches do not allocate once warmed up
+struct BatchScratch
+{
+  vector<mmsghdr> headers {};
+  vector<iovec> iovecs {};
+  vector<Address::Raw> addresses {};
+};
+
+thread_local BatchScratch batch_scratch {};
+
+string_view view_of( const string_view buffer )
+{
+  return buffer;
+}
+
+string_view view_of( const Ref<string>& buffer )
+{
+  return buffer.get();
+}
+
+} // namespace
+
 // default constructor for socket of (subclassed) domain and type
 //! \param[in] domain is as described in [socket(7)](\ref man7::socket), probably `AF_INET` or `AF_UNIX`
 //! \param[in] type is as described in [socket(7)](\ref man7::socket)
@@ -118,6 +145,9 @@ void DatagramSocket::recv( Address& source_address, string& payload )
   Address::Raw datagram_source_address;
   socklen_t fromlen = sizeof( datagram_source_address );
 
+  if ( payload.capacity() < kReadBufferSize ) {
+    payload = BufferPool::large();
+  }
   payload.clear();
   payload.resize( kReadBufferSize );
 
@@ -147,6 +177,112 @@ void DatagramSocket::send( const string_view payload )
   register_write();
 }
 
+size_t DatagramSocket::recv_batch( vector<string>& payloads, vector<Address>* sources )
+{
+  auto& [headers, iovecs, addresses] = batch_scratch;
+  const size_t count = min<size_t>( payloads.size(), UIO_MAXIOV );
+  headers.assign( count, {} );
+  iovecs.resize( count );
+  addresses.resize( count );
+
+  for ( size_t i = 0; i < count; ++i ) {
+    if ( payloads[i].capacity() < kReadBufferSize ) {
+      payloads[i] = BufferPool::large(); // e.g. the last payload was moved into a Parser
+    }
+    payloads[i].resize( kReadBufferSize );
+    iovecs[i] = { payloads[i].data(), payloads[i].size() };
+    headers[i].msg_hdr.msg_iov = &iovecs[i];
+    headers[i].msg_hdr.msg_iovlen = 1;
+    headers[i].msg_hdr.msg_name = &addresses[i].storage;
+    headers[i].msg_hdr.msg_namelen = sizeof( addresses[i].storage );
+  }
+
+  // block (if the socket does) for the first datagram only
+  int received = ::recvmmsg( fd_num(), headers.data(), count, MSG_WAITFORONE, nullptr );
+  if ( received < 0 ) {
+    if ( not non_blocking() or errno != EAGAIN ) {
+      throw unix_error { "recvmmsg" };
+    }
+    received = 0;
+  }
+
+  if ( sources ) {
+    sources->clear();
+  }
+  for ( size_t i = 0; i < payloads.size(); ++i ) {
+    if ( i >= static_cast<size_t>( received ) ) {
+      payloads[i].clear();
+      continue;
+    }
+
+    if ( headers[i].msg_hdr.msg_flags & MSG_TRUNC ) {
+      throw runtime_error( "recvmmsg (oversized datagram)" );
+    }
+    register_read();
+    payloads[i].resize( headers[i].msg_len );
+    if ( sources ) {
+      sources->emplace_back( addresses[i], headers[i].msg_hdr.msg_namelen );
+    }
+  }
+
+  return received;
+}
+
+template<typename Datagram>
+size_t DatagramSocket::send_datagrams( const Address* destination, const vector<Datagram>& datagrams )
+{
+  auto& [headers, iovecs, addresses] = batch_scratch;
+  const size_t count = min<size_t>( datagrams.size(), UIO_MAXIOV );
+  headers.assign( count, {} );
+  iovecs.clear();
+  for ( size_t i = 0; i < count; ++i ) {
+    for ( const auto& buffer : datagrams[i] ) {
+      const string_view view = view_of( buffer );
+      iovecs.push_back( { const_cast<char*>( view.data() ), view.size() } ); // NOLINT(*-const-cast)
+    }
+  }
+
+  // point each header at its buffers (only now that iovecs has stopped growing)
+  size_t first_iovec = 0;
+  for ( size_t i = 0; i < count; ++i ) {
+    headers[i].msg_hdr.msg_iov = iovecs.data() + first_iovec; // NOLINT(*-pointer-arithmetic)
+    headers[i].msg_hdr.msg_iovlen = datagrams[i].size();
+    if ( destination ) {
+      headers[i].msg_hdr.msg_name = const_cast<sockaddr*>( destination->raw() ); // NOLINT(*-const-cast)
+      headers[i].msg_hdr.msg_namelen = destination->size();
+    }
+    first_iovec += datagrams[i].size();
+  }
+
+  const int sent = ::sendmmsg( fd_num(), headers.data(), count, 0 );
+  if ( sent < 0 ) {
+    if ( non_blocking() and errno == EAGAIN ) {
+      return 0;
+    }
+    throw unix_error { "sendmmsg" };
+  }
+
+  for ( int i = 0; i < sent; ++i ) {
+    register_write();
+  }
+  return sent;
+}
+
+size_t DatagramSocket::send_batch( const vector<vector<string_view>>& datagrams )
+{
+  return send_datagrams( nullptr, datagrams );
+}
+
+size_t DatagramSocket::send_batch( const vector<PacketBuffers>& datagrams )
+{
+  return send_datagrams( nullptr, datagrams );
+}
+
+size_t DatagramSocket::sendto_batch( const Address& destination, const vector<vector<string_view>>& datagrams )
+{
+  return send_datagrams( &destination, datagrams );
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen( const int backlog )
@@ -183,6 +319,9 @@ void Socket::setsockopt( const int level, const int option, const option_type& o
   CheckSystemCall( "setsockopt", ::setsockopt( fd_num(), level, option, &option_value, sizeof( option_value ) ) );
 }
 
+// the ring options are set by PacketRingSocket (see packet_ring.cc)
+template void Socket::setsockopt( int level, int option, const tpacket_req3& option_value );
+
 // setsockopt with size only known at runtime
 void Socket::setsockopt( const int level, const int option, const string_view option_val )
 {
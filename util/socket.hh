@@ -4,7 +4,9 @@
 #include "file_descriptor.hh"
 
 #include <functional>
+#include <string>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -69,6 +71,22 @@ public:
   //! Send datagram to the socket's connected address (must call connect() first)
   void send( std::string_view payload );
 
+  //! \brief Receive up to `payloads.size()` datagrams with one [recvmmsg(2)](\ref man2::recvmmsg)
+  //! \details Waits only for the first datagram (as recv would), then takes whatever else is queued.
+  //! The payload strings keep their storage from call to call; those beyond the returned count are
+  //! left empty. If `sources` is given, it is filled with the sender of each datagram received.
+  //! \returns the number of datagrams received (0 if a non-blocking socket had none)
+  size_t recv_batch( std::vector<std::string>& payloads, std::vector<Address>* sources = nullptr );
+
+  //! \brief Send datagrams to the connected address with one [sendmmsg(2)](\ref man2::sendmmsg)
+  //! \details Each datagram is the concatenation of its buffers.
+  //! \returns the number of datagrams sent (fewer than given if a non-blocking socket's buffer fills)
+  size_t send_batch( const std::vector<std::vector<std::string_view>>& datagrams );
+  size_t send_batch( const std::vector<PacketBuffers>& datagrams );
+
+  //! Send datagrams to specified Address with one sendmmsg(2) (see send_batch)
+  size_t sendto_batch( const Address& destination, const std::vector<std::vector<std::string_view>>& datagrams );
+
 protected:
   DatagramSocket( int domain, int type, int protocol = 0 ) : Socket( domain, type, protocol ) {}
 
@@ -76,6 +94,10 @@ protected:
   DatagramSocket( FileDescriptor&& fd, int domain, int type, int protocol = 0 )
     : Socket( std::move( fd ), domain, type, protocol )
   {}
+
+private:
+  template<typename Datagram>
+  size_t send_datagrams( const Address* destination, const std::vector<Datagram>& datagrams );
 };
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
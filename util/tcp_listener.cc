@@ -0,0 +1,94 @@
+#include "tcp_listener.hh"
+
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+bool AcceptQueue::reserve()
+{
+  const lock_guard lock { mutex_ };
+  if ( closed_ or half_open_ + ready_.size() >= backlog_ ) {
+    return false;
+  }
+  ++half_open_;
+  return true;
+}
+
+void AcceptQueue::release()
+{
+  const lock_guard lock { mutex_ };
+  if ( half_open_ > 0 ) {
+    --half_open_;
+  }
+}
+
+void AcceptQueue::push( LocalStreamSocket&& socket )
+{
+  {
+    const lock_guard lock { mutex_ };
+    if ( half_open_ > 0 ) {
+      --half_open_;
+    }
+    if ( closed_ ) {
+      return; // nobody will accept it; destroying the socket shows EOF to the stack
+    }
+    ready_.push_back( move( socket ) );
+  }
+  ready_cv_.notify_one();
+}
+
+optional<LocalStreamSocket> AcceptQueue::pop()
+{
+  unique_lock lock { mutex_ };
+  ready_cv_.wait( lock, [&] { return closed_ or not ready_.empty(); } );
+  if ( ready_.empty() ) {
+    return {};
+  }
+  optional<LocalStreamSocket> ret { move( ready_.front() ) };
+  ready_.pop_front();
+  return ret;
+}
+
+optional<LocalStreamSocket> AcceptQueue::try_pop()
+{
+  const lock_guard lock { mutex_ };
+  if ( ready_.empty() ) {
+    return {};
+  }
+  optional<LocalStreamSocket> ret { move( ready_.front() ) };
+  ready_.pop_front();
+  return ret;
+}
+
+void AcceptQueue::close()
+{
+  {
+    const lock_guard lock { mutex_ };
+    closed_ = true;
+    ready_.clear();
+  }
+  ready_cv_.notify_all();
+}
+
+bool AcceptQueue::closed() const
+{
+  const lock_guard lock { mutex_ };
+  return closed_;
+}
+
+LocalStreamSocket TCPListener::accept()
+{
+  auto socket = queue_->pop();
+  if ( not socket.has_value() ) {
+    throw runtime_error( "accept() on a listener that has been shut down" );
+  }
+  return move( socket.value() );
+}
+
+TCPListener::~TCPListener()
+{
+  if ( queue_ ) {
+    queue_->close();
+  }
+}
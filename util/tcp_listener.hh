@@ -0,0 +1,76 @@
+#pragma once
+
+#include "socket.hh"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+//! \brief Thread-safe backlog of passively opened connections, shared by a TCPListener and the stack
+//! thread(s) that complete handshakes on its behalf
+//! \details The backlog bounds the sum of half-open connections (SYN received, handshake not yet
+//! complete) and established connections waiting for accept(). SYNs beyond it are dropped, so the
+//! peer will retransmit them later.
+class AcceptQueue
+{
+public:
+  explicit AcceptQueue( size_t backlog ) : backlog_( backlog ) {}
+
+  //! Stack side: make room for a new half-open connection; false if the backlog is full or closed
+  bool reserve();
+
+  //! Stack side: a half-open connection failed before its handshake completed
+  void release();
+
+  //! Stack side: a half-open connection completed its handshake and is ready for accept()
+  void push( LocalStreamSocket&& socket );
+
+  //! Listener side: wait for an established connection; empty once the queue has been closed
+  std::optional<LocalStreamSocket> pop();
+
+  //! Listener side: an established connection if one is waiting, otherwise empty
+  std::optional<LocalStreamSocket> try_pop();
+
+  //! Stop accepting connections, drop the ones not yet accepted, and wake any waiting pop()
+  void close();
+
+  bool closed() const;
+
+private:
+  mutable std::mutex mutex_ {};
+  std::condition_variable ready_cv_ {};
+  std::deque<LocalStreamSocket> ready_ {};
+  size_t backlog_;
+  size_t half_open_ {};
+  bool closed_ {};
+};
+
+//! \brief A listening TCP endpoint on a TCPStack that yields one connected socket per peer
+//! \details Unlike TCPMinnowSocket::listen_and_accept, the listener keeps listening while the
+//! connections it has produced are running. Destroying it stops listening; connections already
+//! accepted are unaffected.
+class TCPListener
+{
+public:
+  explicit TCPListener( std::shared_ptr<AcceptQueue> queue ) : queue_( std::move( queue ) ) {}
+
+  //! Block until a peer has connected, and return the application's end of the connection's byte stream
+  //! \throws std::runtime_error if the listener has been shut down (e.g. because its stack stopped)
+  LocalStreamSocket accept();
+
+  //! A connected socket if a peer is waiting to be accepted, otherwise empty
+  std::optional<LocalStreamSocket> try_accept() { return queue_->try_pop(); }
+
+  ~TCPListener();
+
+  TCPListener( const TCPListener& ) = delete;
+  TCPListener& operator=( const TCPListener& ) = delete;
+  TCPListener( TCPListener&& ) = default;
+  TCPListener& operator=( TCPListener&& ) = default;
+
+private:
+  std::shared_ptr<AcceptQueue> queue_;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "byte_ring.hh"
 #include "eventloop.hh"
 #include "file_descriptor.hh"
 #include "socket.hh"
@@ -9,6 +10,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <thread>
 
@@ -18,7 +20,14 @@ class TCPMinnowSocket : public LocalStreamSocket
 {
 public:
   //! Construct from the interface that the TCPPeer thread will use to read and write datagrams
-  explicit TCPMinnowSocket( AdaptT&& datagram_interface );
+  //! \param[in] shared_rings selects the shared-memory data path (see shared_rings()) instead of the
+  //! socket pair
+  explicit TCPMinnowSocket( AdaptT&& datagram_interface, bool shared_rings = false );
+
+  //! The application's end of the byte streams, in shared-ring mode
+  //! \details Reads and writes on the returned object are memcpys into rings shared with the TCPPeer
+  //! thread, rather than system calls on this socket. In this mode, do not read or write the socket itself.
+  SharedRingStream& shared_rings();
 
   //! Close socket, and wait for TCPPeer to finish
   //! \note Calling this function is only advisable if the socket has reached EOF,
@@ -64,9 +73,15 @@ private:
   //! Stream socket for reads and writes between owner and TCP thread
   LocalStreamSocket _thread_data;
 
+  //! Shared-memory rings carrying the byte streams instead of _thread_data (if enabled)
+  std::unique_ptr<SharedRingStream> _rings {};
+
   //! Set up the TCPPeer and the event loop
   void _initialize_TCP( const TCPConfig& config );
 
+  //! Add the event-loop rules that move bytes between TCPPeer and the shared rings
+  void _initialize_ring_rules();
+
   //! TCP state machine
   std::optional<TCPPeer> _tcp {};
 
@@ -76,6 +91,12 @@ private:
   //! Process events while specified condition is true
   void _tcp_loop( const std::function<bool()>& condition );
 
+  //! Tick the TCPPeer up to the present
+  void _advance_clock();
+
+  //! Time (per timestamp_ms()) up to which the TCPPeer has been ticked
+  uint64_t _clock_ms {};
+
   //! Main loop of TCPPeer thread
   void _tcp_main();
 
@@ -83,9 +104,15 @@ private:
   std::thread _tcp_thread {};
 
   //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
-  TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT&& datagram_interface );
+  TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair,
+                   AdaptT&& datagram_interface,
+                   bool shared_rings );
 
   std::atomic_bool _abort { false }; //!< Flag used by the owner to force the TCPPeer thread to shut down
+  EventFD _abort_event {};           //!< Notified by the owner, after setting _abort, to wake the TCPPeer thread
+
+  //! Fires at the TCPPeer's next timeout, so an idle connection sleeps until then
+  std::optional<EventLoop::TimerHandle> _tcp_timer {};
 
   bool _inbound_shutdown { false }; //!< Has TCPMinnowSocket shut down the incoming data to the owner?
 
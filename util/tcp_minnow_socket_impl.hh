@@ -2,11 +2,14 @@
 
 #include "exception.hh"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <exception>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <sys/socket.h>
 #include <utility>
 
@@ -23,43 +26,86 @@ inline uint64_t timestamp_ms()
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition )
 {
-  auto base_time = timestamp_ms();
+  if ( not _tcp.has_value() ) {
+    throw std::runtime_error( "_tcp_loop entered before TCPPeer initialized" );
+  }
+
+  // an adapter that queues its writes (e.g. through an io_uring) hands them over once per iteration
+  const auto flush = [&] {
+    if constexpr ( requires { _datagram_adapter.flush(); } ) {
+      _datagram_adapter.flush();
+    }
+  };
+
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    flush();
+
+    // sleep until an event or the TCPPeer's next timeout, rather than waking at a fixed interval
+    const auto ms_until_next_tick = _tcp->ms_until_next_tick();
+    if ( _tcp->active() and ms_until_next_tick.has_value() ) {
+      _tcp_timer->set( std::chrono::steady_clock::time_point {
+        std::chrono::milliseconds { _clock_ms + ms_until_next_tick.value() } } );
+    } else {
+      _tcp_timer->clear();
+    }
+
+    auto ret = _eventloop.wait_next_event( -1 );
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
 
-    if ( not _tcp.has_value() ) {
-      throw std::runtime_error( "_tcp_loop entered before TCPPeer initialized" );
-    }
+    _advance_clock();
+  }
+  flush();
+}
 
-    if ( _tcp.value().active() ) {
-      const auto next_time = timestamp_ms();
-      _tcp.value().tick( next_time - base_time, [&]( auto x ) { _datagram_adapter.write( x ); } );
-      _datagram_adapter.tick( next_time - base_time );
-      base_time = next_time;
-    }
+//! \details The loop sleeps for as long as the connection is idle, so each rule that hands the TCPPeer
+//! a segment or bytes calls this first: otherwise the TCPPeer would act (e.g. stamp a TSval, or take an
+//! RTT sample from an echoed one) with a clock as old as the last wake-up.
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_advance_clock()
+{
+  const uint64_t now = timestamp_ms();
+  if ( _tcp->active() and now > _clock_ms ) {
+    _tcp->tick( now - _clock_ms, [&]( auto x ) { _datagram_adapter.write( x ); } );
+    _datagram_adapter.tick( now - _clock_ms );
   }
+  _clock_ms = now;
 }
 
 //! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
 //! \param[in] datagram_interface is the interface for reading and writing datagrams
+//! \param[in] shared_rings selects the shared-memory data path
 template<TCPDatagramAdapter AdaptT>
 TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair,
-                                          AdaptT&& datagram_interface )
+                                          AdaptT&& datagram_interface,
+                                          bool shared_rings )
   : LocalStreamSocket( std::move( data_socket_pair.first ) )
   , _datagram_adapter( std::move( datagram_interface ) )
   , _thread_data( std::move( data_socket_pair.second ) )
 {
   _thread_data.set_blocking( false );
   set_blocking( false );
+
+  if ( shared_rings ) {
+    _rings = std::make_unique<SharedRingStream>( TCPConfig::DEFAULT_CAPACITY );
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+SharedRingStream& TCPMinnowSocket<AdaptT>::shared_rings()
+{
+  if ( not _rings ) {
+    throw std::runtime_error( "TCPMinnowSocket was not constructed in shared-ring mode" );
+  }
+  return *_rings;
 }
 
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
+  _clock_ms = timestamp_ms();
 
   // Set up the event loop
 
@@ -82,11 +128,12 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     Direction::In,
     [&] {
       if ( auto seg = _datagram_adapter.read() ) {
+        _advance_clock();
         _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
       // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
+      if ( _outbound_shutdown and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
         std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
                   << " has been fully acknowledged.\n";
         _fully_acked = true;
@@ -94,6 +141,22 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     },
     [&] { return _tcp->active(); } );
 
+  // the TCPPeer's timeouts (the timer only wakes the loop, which ticks the TCPPeer after every event)
+  _tcp_timer = _eventloop.add_timer( "TCP timeout", [] {} );
+
+  // wake-ups from the owner's destructor
+  _eventloop.add_rule(
+    "abort TCPPeer thread",
+    _abort_event,
+    Direction::In,
+    [&] { _abort_event.consume(); },
+    [&] { return _tcp->active(); } );
+
+  if ( _rings ) {
+    _initialize_ring_rules();
+    return;
+  }
+
   // rule 2: read from pipe into outbound buffer
   _eventloop.add_rule(
     "push bytes to TCPPeer",
@@ -116,6 +179,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
                   << " still in flight).\n";
       }
 
+      _advance_clock();
       _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
     },
     [&] {
@@ -168,6 +232,86 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     } );
 }
 
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_initialize_ring_rules()
+{
+  ByteRing& outbound = _rings->outbound();
+  ByteRing& inbound = _rings->inbound();
+
+  // rule 2 (shared rings): move bytes from the outbound ring into the outbound buffer
+  _eventloop.add_rule(
+    "push bytes to TCPPeer",
+    outbound.readable(),
+    Direction::In,
+    [&] {
+      outbound.readable().consume();
+      Writer& writer = _tcp->outbound_writer();
+      while ( writer.available_capacity() > 0 and outbound.bytes_buffered() > 0 ) {
+        const std::string_view data = outbound.peek();
+        const size_t len = std::min( data.size(), writer.available_capacity() );
+        writer.push( std::string { data.substr( 0, len ) } );
+        outbound.pop( len );
+      }
+
+      if ( outbound.is_finished() ) {
+        writer.close();
+        _outbound_shutdown = true;
+
+        // debugging output:
+        std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
+                  << " finished (" << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
+                  << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" )
+                  << " still in flight).\n";
+      } else if ( outbound.bytes_buffered() > 0 ) {
+        outbound.readable().notify(); // no transition will announce the bytes left behind, so re-arm
+      }
+
+      _advance_clock();
+      _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+    },
+    [&] {
+      return ( _tcp->active() ) and ( not _outbound_shutdown )
+             and ( _tcp->outbound_writer().available_capacity() > 0 );
+    } );
+
+  // rule 3 (shared rings): move bytes from the inbound stream into the inbound ring. There is no fd
+  // to wait on while the ring has room, so this is a non-fd rule...
+  _eventloop.add_rule(
+    "read bytes from inbound stream",
+    [&] {
+      Reader& reader = _tcp->inbound_reader();
+      while ( reader.bytes_buffered() and inbound.available_capacity() > 0 ) {
+        reader.pop( inbound.push( reader.peek() ) );
+      }
+
+      if ( reader.is_finished() or reader.has_error() ) {
+        if ( reader.has_error() ) {
+          inbound.set_error();
+        } else {
+          inbound.close();
+        }
+        _inbound_shutdown = true;
+
+        // debugging output:
+        std::cerr << "DEBUG: minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
+                  << " finished " << ( reader.has_error() ? "uncleanly.\n" : "cleanly.\n" );
+      }
+    },
+    [&] {
+      const Reader& reader = _tcp->inbound_reader();
+      return ( reader.bytes_buffered() and inbound.available_capacity() > 0 )
+             or ( ( reader.is_finished() or reader.has_error() ) and not _inbound_shutdown );
+    } );
+
+  // ... and this rule wakes the loop when the application makes room in a full ring
+  _eventloop.add_rule(
+    "inbound ring has room",
+    inbound.writable(),
+    Direction::In,
+    [&] { inbound.writable().consume(); },
+    [&] { return not _inbound_shutdown; } );
+}
+
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
 //! \param[in] type is the type of AF_UNIX sockets to create (e.g., SOCK_SEQPACKET)
 //! \returns a std::pair of connected sockets
@@ -180,10 +324,12 @@ inline std::pair<SocketType, SocketType> socket_pair_helper( int domain, int typ
 }
 
 //! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
+//! \param[in] shared_rings selects the shared-memory data path
 template<TCPDatagramAdapter AdaptT>
-TCPMinnowSocket<AdaptT>::TCPMinnowSocket( AdaptT&& datagram_interface )
+TCPMinnowSocket<AdaptT>::TCPMinnowSocket( AdaptT&& datagram_interface, bool shared_rings )
   : TCPMinnowSocket( socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM ),
-                     std::move( datagram_interface ) )
+                     std::move( datagram_interface ),
+                     shared_rings )
 {}
 
 template<TCPDatagramAdapter AdaptT>
@@ -194,6 +340,7 @@ TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
       std::cerr << "Warning: unclean shutdown of TCPMinnowSocket\n";
       // force the other side to exit
       _abort.store( true );
+      _abort_event.notify();
       _tcp_thread.join();
     }
   } catch ( const std::exception& e ) {
@@ -205,6 +352,9 @@ template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
   shutdown( SHUT_RDWR );
+  if ( _rings ) {
+    _rings->shutdown_write();
+  }
   if ( _tcp_thread.joinable() ) {
     std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
     _tcp_thread.join();
@@ -277,6 +427,11 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
     }
     _tcp_loop( [] { return true; } );
     shutdown( SHUT_RDWR );
+    if ( _rings ) {
+      // let the application see EOF, and fail any write that would never be sent
+      _rings->inbound().close();
+      _rings->outbound().set_error();
+    }
     if ( not _tcp.value().active() ) {
       std::cerr << "DEBUG: minnow TCP connection finished "
                 << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
@@ -10,6 +10,121 @@
 
 using namespace std;
 
+uint64_t FourTuple::hash() const
+{
+  // splitmix64 finalizer over the packed fields
+  uint64_t x = ( static_cast<uint64_t>( local_address ) << 32 ) | remote_address;
+  x ^= ( static_cast<uint64_t>( local_port ) << 16 | remote_port ) * 0x9e3779b97f4a7c15ULL;
+  x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+  x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+  return x ^ ( x >> 31 );
+}
+
+optional<TCPMessage> parse_tcp_in_ip( InternetDatagram ip_dgram, FourTuple& flow, const bool verify_checksum )
+{
+  // does the IPv4 datagram claim that its payload is a TCP segment?
+  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+    return {};
+  }
+
+  // is the payload a valid TCP segment?
+  TCPSegment tcp_seg;
+  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum(), verify_checksum ) ) {
+    return {};
+  }
+
+  flow = { .local_address = ip_dgram.header.dst,
+           .local_port = tcp_seg.udinfo.dst_port,
+           .remote_address = ip_dgram.header.src,
+           .remote_port = tcp_seg.udinfo.src_port };
+  return move( tcp_seg.message );
+}
+
+optional<FourTuple> peek_tcp_in_ip_flow( string_view ip_dgram )
+{
+  const auto u8 = [&]( size_t i ) { return static_cast<uint8_t>( ip_dgram[i] ); };
+  const auto u16 = [&]( size_t i ) { return static_cast<uint16_t>( u8( i ) << 8 | u8( i + 1 ) ); };
+  const auto u32 = [&]( size_t i ) { return static_cast<uint32_t>( u16( i ) ) << 16 | u16( i + 2 ); };
+
+  if ( ip_dgram.size() < IPv4Header::LENGTH or ( u8( 0 ) >> 4 ) != 4 or u8( 9 ) != IPv4Header::PROTO_TCP ) {
+    return {};
+  }
+
+  const size_t header_length = ( u8( 0 ) & 0xfU ) * 4;
+  if ( header_length < IPv4Header::LENGTH or ip_dgram.size() < header_length + 4 ) {
+    return {};
+  }
+
+  return FourTuple { .local_address = u32( 16 ),
+                     .local_port = u16( header_length + 2 ),
+                     .remote_address = u32( 12 ),
+                     .remote_port = u16( header_length ) };
+}
+
+namespace {
+// The segment carrying `msg` (borrowed) from the local to the remote port of `flow`
+TCPSegment make_segment( const TCPMessage& msg, const FourTuple& flow )
+{
+  TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() } };
+  seg.udinfo.src_port = flow.local_port;
+  seg.udinfo.dst_port = flow.remote_port;
+  return seg;
+}
+
+// The header of an IPv4 datagram carrying `seg` from the local to the remote address of `flow`
+IPv4Header make_header( const TCPSegment& seg, const FourTuple& flow )
+{
+  IPv4Header header;
+  header.src = flow.local_address;
+  header.dst = flow.remote_address;
+  header.len = header.hlen * 4 + seg.header_length() + seg.message.sender->payload.size();
+  header.compute_checksum();
+  return header;
+}
+
+// Serialize `seg`, calculating its checksum using information from the IP header
+void serialize_segment( Serializer& serializer,
+                        TCPSegment& seg,
+                        const IPv4Header& header,
+                        const bool partial_checksum )
+{
+  if ( partial_checksum ) {
+    seg.compute_partial_checksum( header.pseudo_checksum() );
+    seg.serialize( serializer );
+  } else {
+    seg.serialize_with_checksum( serializer, header.pseudo_checksum() );
+  }
+}
+} // namespace
+
+//! \param[in] msg is the TCP message to convert
+//! \param[in] flow gives the source (local) and destination (remote) addresses and ports
+//! \param[in] partial_checksum leaves only the pseudo-header sum in the TCP checksum field
+InternetDatagram make_tcp_in_ip( const TCPMessage& msg, const FourTuple& flow, const bool partial_checksum )
+{
+  TCPSegment seg = make_segment( msg, flow );
+  InternetDatagram ip_dgram { .header = make_header( seg, flow ) };
+
+  Serializer serializer;
+  serialize_segment( serializer, seg, ip_dgram.header, partial_checksum );
+  ip_dgram.payload = serializer.finish();
+  return ip_dgram;
+}
+
+//! \details The space for the whole datagram is reserved before the IPv4 header is written, and the TCP
+//! header and payload follow it in the same buffer.
+PacketBuffers serialize_tcp_in_ip( const TCPMessage& msg, const FourTuple& flow, const bool partial_checksum )
+{
+  TCPSegment seg = make_segment( msg, flow );
+  const IPv4Header header = make_header( seg, flow );
+
+  Serializer serializer;
+  serializer.reserve( header.len );
+  header.serialize( serializer );
+  serialize_segment( serializer, seg, header, partial_checksum );
+  return serializer.finish();
+}
+
 //! \details This function attempts to parse a TCP segment from
 //! the IP datagram's payload.
 //!
@@ -22,7 +137,7 @@ using namespace std;
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_dgram )
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_dgram, const bool checksum_valid )
 {
   // is the IPv4 datagram for us?
   // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
@@ -35,28 +150,25 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
     return {};
   }
 
-  // does the IPv4 datagram claim that its payload is a TCP segment?
-  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
-    return {};
-  }
-
   // is the payload a valid TCP segment?
-  TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum() ) ) {
+  const bool verify = not( checksum_valid or checksum_offload().skip_verify );
+  ++( verify ? checksum_counters_mutable().verified : checksum_counters_mutable().skipped );
+  FourTuple flow;
+  auto msg = parse_tcp_in_ip( move( ip_dgram ), flow, verify );
+  if ( not msg.has_value() ) {
     return {};
   }
 
   // is the TCP segment for us?
-  if ( tcp_seg.udinfo.dst_port != config().source.port() ) {
+  if ( flow.local_port != config().source.port() ) {
     return {};
   }
 
   // should we target this source addr/port (and use its destination addr as our source) in reply?
   if ( listening() ) {
-    if ( tcp_seg.message.sender->SYN and not tcp_seg.message.sender->RST ) {
-      config_mutable().source = Address { inet_ntoa( { htobe32( ip_dgram.header.dst ) } ), config().source.port() };
-      config_mutable().destination
-        = Address { inet_ntoa( { htobe32( ip_dgram.header.src ) } ), tcp_seg.udinfo.src_port };
+    if ( msg->sender->SYN and not msg->sender->RST ) {
+      config_mutable().source = Address { inet_ntoa( { htobe32( flow.local_address ) } ), config().source.port() };
+      config_mutable().destination = Address { inet_ntoa( { htobe32( flow.remote_address ) } ), flow.remote_port };
       set_listening( false );
     } else {
       return {};
@@ -64,33 +176,36 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
   }
 
   // is the TCP segment from our peer?
-  if ( tcp_seg.udinfo.src_port != config().destination.port() ) {
+  if ( flow.remote_port != config().destination.port() ) {
     return {};
   }
 
-  return move( tcp_seg.message );
+  return msg;
 }
 
-//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
-//! \param[in] seg is the TCP segment to convert
-InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
+FourTuple TCPOverIPv4Adapter::flow() const
 {
-  const size_t payload_size = msg.sender->payload.size();
-  TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() } };
-  // set the port numbers in the TCP segment
-  seg.udinfo.src_port = config().source.port();
-  seg.udinfo.dst_port = config().destination.port();
+  return { .local_address = config().source.ipv4_numeric(),
+           .local_port = config().source.port(),
+           .remote_address = config().destination.ipv4_numeric(),
+           .remote_port = config().destination.port() };
+}
 
-  // create an Internet Datagram and set its addresses and length
-  InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + payload_size;
+bool TCPOverIPv4Adapter::count_transmit( const bool partial_checksum )
+{
+  ++( partial_checksum ? checksum_counters_mutable().deferred : checksum_counters_mutable().computed );
+  return partial_checksum;
+}
 
-  // set payload, calculating TCP checksum using information from IP header
-  seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
-  ip_dgram.header.compute_checksum();
-  ip_dgram.payload = serialize( seg );
+//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
+//! \param[in] seg is the TCP segment to convert
+//! \param[in] partial_checksum leaves the TCP checksum for a device with checksum offload to complete
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg, const bool partial_checksum )
+{
+  return make_tcp_in_ip( msg, flow(), count_transmit( partial_checksum ) );
+}
 
-  return ip_dgram;
+PacketBuffers TCPOverIPv4Adapter::serialize_tcp_in_ip( const TCPMessage& msg, const bool partial_checksum )
+{
+  return ::serialize_tcp_in_ip( msg, flow(), count_transmit( partial_checksum ) );
 }
@@ -4,13 +4,68 @@
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! The addresses and ports that identify a TCP connection, from the point of view of one endpoint
+struct FourTuple
+{
+  uint32_t local_address {};
+  uint16_t local_port {};
+  uint32_t remote_address {};
+  uint16_t remote_port {};
+
+  bool operator==( const FourTuple& other ) const = default;
+
+  //! Well-mixed hash of all four fields (also usable to spread connections across shards)
+  uint64_t hash() const;
+};
+
+struct FourTupleHash
+{
+  size_t operator()( const FourTuple& t ) const { return t.hash(); }
+};
+
+//! Parse the TCP segment carried in an IPv4 datagram, and record which connection it belongs to
+//! (with "local" being the datagram's destination). Returns an empty optional if the payload is not
+//! a valid TCP segment. With `verify_checksum` false, the TCP checksum is trusted.
+std::optional<TCPMessage> parse_tcp_in_ip( InternetDatagram ip_dgram,
+                                           FourTuple& flow,
+                                           bool verify_checksum = true );
+
+//! Find which connection a serialized IPv4 datagram belongs to by looking only at the addresses and
+//! ports (nothing is verified). Returns an empty optional if it does not look like TCP over IPv4.
+std::optional<FourTuple> peek_tcp_in_ip_flow( std::string_view ip_dgram );
+
+//! Wrap a TCP message in an IPv4 datagram sent from the local to the remote end of a connection
+//! (with `partial_checksum`, the TCP checksum is left for a device with checksum offload to complete)
+InternetDatagram make_tcp_in_ip( const TCPMessage& msg, const FourTuple& flow, bool partial_checksum = false );
+
+//! Serialize the datagram make_tcp_in_ip() would build, in one pass and into one contiguous buffer
+PacketBuffers serialize_tcp_in_ip( const TCPMessage& msg, const FourTuple& flow, bool partial_checksum = false );
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase
 {
 public:
-  std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram );
+  //! Unwrap the TCP message of a datagram for this connection (the TCP checksum is verified unless
+  //! ChecksumOffload::skip_verify is set, or `checksum_valid` says the device already verified it)
+  std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram, bool checksum_valid = false );
+
+  //! Wrap a TCP message for this connection (with `partial_checksum`, which the caller sets only for a
+  //! device that completes it, the TCP checksum is left partial)
+  InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg, bool partial_checksum = false );
+
+  //! Wrap and serialize a TCP message for this connection into one buffer, ready to write
+  PacketBuffers serialize_tcp_in_ip( const TCPMessage& msg, bool partial_checksum = false );
+
+private:
+  FourTuple flow() const;
 
-  InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+  // Count a segment sent, returning whether its checksum is left partial
+  bool count_transmit( bool partial_checksum );
 };
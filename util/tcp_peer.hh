@@ -7,6 +7,7 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
 #include <functional>
 #include <optional>
 
@@ -35,6 +36,23 @@ public:
   }
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
+  /* Milliseconds until a tick() could have an effect (a retransmission, or the end of lingering), if ever */
+  std::optional<uint64_t> ms_until_next_tick() const
+  {
+    std::optional<uint64_t> ret = sender_.ms_until_retransmission();
+
+    const bool any_errors = receiver_.reader().has_error() or sender_.writer().has_error();
+    const bool streams_done = not sender_.sequence_numbers_in_flight() and sender_.reader().is_finished()
+                              and receiver_.writer().is_closed();
+    if ( linger_after_streams_finish_ and streams_done and not any_errors ) {
+      const uint64_t linger_end = time_of_last_receipt_ + 10UL * cfg_.rt_timeout;
+      const uint64_t until_linger_end = linger_end - std::min( cumulative_time_, linger_end );
+      ret = std::min( ret.value_or( until_linger_end ), until_linger_end );
+    }
+
+    return ret;
+  }
+
   /* Is the peer still active? */
   bool active() const
   {
@@ -88,7 +106,7 @@ public:
 
 private:
   TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
+  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout, cfg_.timestamps };
   TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
 
   bool need_send_ {};
@@ -7,7 +7,7 @@
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
  *
- * It contains three fields:
+ * It contains four fields:
  *
  * 1) The acknowledgment number (ackno): the *next* sequence number needed by the TCP Receiver.
  *    This is an optional field that is empty if the TCPReceiver hasn't yet received the Initial Sequence Number.
@@ -17,6 +17,9 @@
  *    the <cstdint> header).
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) The timestamp echo (TSecr of the RFC 7323 timestamps option): the most recent timestamp received from
+ *    the peer's sender, or empty if the peer is not sending timestamps.
  */
 
 struct TCPReceiverMessage
@@ -24,4 +27,5 @@ struct TCPReceiverMessage
   std::optional<Wrap32> ackno {};
   uint16_t window_size {};
   bool RST {};
+  std::optional<uint32_t> timestamp_echo {};
 };
@@ -3,19 +3,81 @@
 #include "helpers.hh"
 #include "wrapping_integers.hh"
 
+#include <array>
 #include <sstream>
 
 using namespace std;
 
 static_assert( !( TCPSegment::HEADER_LENGTH & 0x03 ) ); // header length must be divisible by 4
+static_assert( !( TCPSegment::TIMESTAMPS_OPTION_LENGTH & 0x03 ) );
 
-void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
+namespace {
+// Parse the options area of the header, keeping the timestamps option and skipping the others
+void parse_options( Parser& parser, uint64_t length, TCPMessage& message )
+{
+  while ( length > 0 and not parser.has_error() ) {
+    uint8_t kind {};
+    parser.integer( kind );
+    --length;
+
+    if ( kind == TCPSegment::OPTION_END ) {
+      parser.remove_prefix( length );
+      return;
+    }
+
+    if ( kind == TCPSegment::OPTION_NOP ) {
+      continue;
+    }
+
+    uint8_t option_length {};
+    if ( length == 0 ) {
+      parser.set_error();
+      return;
+    }
+    parser.integer( option_length );
+    if ( option_length < 2 or option_length - 1U > length ) {
+      parser.set_error();
+      return;
+    }
+    length -= option_length - 1;
+
+    if ( kind == TCPSegment::OPTION_TIMESTAMPS and option_length == TCPSegment::TIMESTAMPS_LENGTH ) {
+      uint32_t tsval {};
+      uint32_t tsecr {};
+      parser.integer( tsval );
+      parser.integer( tsecr );
+      message.sender->timestamp = tsval;
+      if ( message.receiver->ackno.has_value() ) {
+        message.receiver->timestamp_echo = tsecr; // TSecr is only valid with the ACK bit
+      }
+    } else {
+      parser.remove_prefix( option_length - 2 );
+    }
+  }
+}
+} // namespace
+
+uint8_t TCPSegment::header_length() const
+{
+  return HEADER_LENGTH + ( message.sender->timestamp.has_value() ? TIMESTAMPS_OPTION_LENGTH : 0 );
+}
+
+void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum, const bool verify_checksum )
 {
   /* verify checksum */
-  InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( parser.buffer() );
-  if ( check.value() ) {
-    parser.set_error();
+  if ( verify_checksum ) {
+    InternetChecksum check { datagram_layer_pseudo_checksum };
+    check.add( parser.buffer() );
+    if ( check.value() ) {
+      parser.set_error();
+      return;
+    }
+  }
+
+  // the fixed part of the header is decoded in one piece
+  array<char, HEADER_LENGTH> scratch {};
+  FixedParser fixed { parser.peek_fixed( scratch ) };
+  if ( parser.has_error() ) {
     return;
   }
 
@@ -23,19 +85,19 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   uint16_t raw16 {};
   uint8_t octet {};
 
-  parser.integer( udinfo.src_port );
-  parser.integer( udinfo.dst_port );
+  fixed.integer( udinfo.src_port );
+  fixed.integer( udinfo.dst_port );
 
-  parser.integer( raw32 );
+  fixed.integer( raw32 );
   message.sender->seqno = Wrap32 { raw32 };
 
-  parser.integer( raw32 );
+  fixed.integer( raw32 );
   message.receiver->ackno = Wrap32 { raw32 };
 
-  parser.integer( octet );
+  fixed.integer( octet );
   const uint8_t data_offset = octet >> 4;
 
-  parser.integer( octet ); // flags
+  fixed.integer( octet ); // flags
   if ( not( octet & 0b0001'0000 ) ) {
     message.receiver->ackno.reset(); // no ACK
   }
@@ -44,16 +106,17 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   message.sender->SYN = octet & 0b0000'0010;
   message.sender->FIN = octet & 0b0000'0001;
 
-  parser.integer( message.receiver->window_size );
-  parser.integer( udinfo.cksum );
-  parser.integer( raw16 ); // urgent pointer
+  fixed.integer( message.receiver->window_size );
+  fixed.integer( udinfo.cksum );
+  fixed.integer( raw16 ); // urgent pointer
+  parser.remove_prefix( HEADER_LENGTH );
 
-  // skip any options or anything extra in the header
+  // parse any options or anything extra in the header
   if ( data_offset < ( HEADER_LENGTH >> 2 ) ) {
     parser.set_error();
     return;
   }
-  parser.remove_prefix( data_offset * 4 - HEADER_LENGTH );
+  parse_options( parser, data_offset * 4 - HEADER_LENGTH, message );
 
   parser.concatenate_all_remaining( message.sender->payload );
 }
@@ -65,12 +128,20 @@ public:
 };
 
 void TCPSegment::serialize( Serializer& serializer ) const
+{
+  // header and payload go into one buffer
+  serializer.reserve( header_length() + message.sender->payload.size() );
+  serialize_header( serializer );
+  serializer.append( message.sender->payload );
+}
+
+void TCPSegment::serialize_header( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender->seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver->ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { ( HEADER_LENGTH >> 2 ) << 4 } ); // data offset
+  serializer.integer( static_cast<uint8_t>( ( header_length() >> 2 ) << 4 ) ); // data offset
   const bool reset = message.sender->RST or message.receiver->RST;
   const uint8_t flags = ( message.receiver->ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender->SYN ? 0b0000'0010U : 0 ) | ( message.sender->FIN ? 0b0000'0001U : 0 );
@@ -78,18 +149,75 @@ void TCPSegment::serialize( Serializer& serializer ) const
   serializer.integer( message.receiver->window_size );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
-  serializer.buffer( message.sender->payload );
+  if ( message.sender->timestamp.has_value() ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_TIMESTAMPS );
+    serializer.integer( TIMESTAMPS_LENGTH );
+    serializer.integer( *message.sender->timestamp );
+    serializer.integer( message.receiver->timestamp_echo.value_or( 0 ) );
+  }
 }
 
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
+  // the payload is summed where it is, without being serialized
   udinfo.cksum = 0;
   Serializer s;
-  serialize( s );
+  serialize_header( s );
+
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  check.add( s.pending() );
+  check.add( message.sender.get().payload );
+  udinfo.cksum = check.value();
+}
+
+void TCPSegment::serialize_with_checksum( Serializer& serializer, uint32_t datagram_layer_pseudo_checksum )
+{
+  // the header may follow other bytes still pending in the serializer (e.g. an IPv4 header)
+  const size_t header_start = serializer.pending().size();
+  const string& payload = message.sender.get().payload; // (the message may be borrowed)
+  udinfo.cksum = 0;
+  serializer.reserve( header_length() + payload.size() );
+  serialize_header( serializer );
 
   InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( s.finish() );
+  check.add( serializer.pending().substr( header_start ) );
+  check.add( payload );
   udinfo.cksum = check.value();
+  serializer.patch_integer( header_start + CHECKSUM_OFFSET, udinfo.cksum );
+
+  serializer.append( payload );
+}
+
+void TCPSegment::compute_partial_checksum( uint32_t datagram_layer_pseudo_checksum )
+{
+  udinfo.cksum = static_cast<uint16_t>( ~InternetChecksum { datagram_layer_pseudo_checksum }.value() );
+}
+
+void TCPSegment::set_src_port( const uint16_t new_port )
+{
+  udinfo.cksum = InternetChecksum::update( udinfo.cksum, udinfo.src_port, new_port );
+  udinfo.src_port = new_port;
+}
+
+void TCPSegment::set_dst_port( const uint16_t new_port )
+{
+  udinfo.cksum = InternetChecksum::update( udinfo.cksum, udinfo.dst_port, new_port );
+  udinfo.dst_port = new_port;
+}
+
+void TCPSegment::set_seqno( const Wrap32 new_seqno )
+{
+  udinfo.cksum = InternetChecksum::update32( udinfo.cksum,
+                                             Wrap32Serializable { message.sender->seqno }.raw_value(),
+                                             Wrap32Serializable { new_seqno }.raw_value() );
+  message.sender->seqno = new_seqno;
+}
+
+void TCPSegment::update_checksum_for_address( const uint32_t old_address, const uint32_t new_address )
+{
+  udinfo.cksum = InternetChecksum::update32( udinfo.cksum, old_address, new_address );
 }
 
 string TCPSegment::to_string() const
@@ -114,6 +242,12 @@ string TCPSegment::to_string() const
     ss << " ACK<" << Wrap32Serializable { *ackno }.raw_value() << ">";
   }
   ss << " winsize=" << message.receiver->window_size;
+  if ( message.sender->timestamp.has_value() ) {
+    ss << " TSval=" << *message.sender->timestamp;
+  }
+  if ( message.receiver->timestamp_echo.has_value() ) {
+    ss << " TSecr=" << *message.receiver->timestamp_echo;
+  }
   ss << " src=" << udinfo.src_port << " dst=" << udinfo.dst_port;
   return ss.str();
 }
@@ -22,13 +22,46 @@ struct TCPSegment
   TCPMessage message {};
   UserDatagramInfo udinfo {};
 
-  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
+  // (with `verify_checksum` false, the checksum is trusted: see ChecksumOffload)
+  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum, bool verify_checksum = true );
   void serialize( Serializer& serializer ) const;
 
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
 
+  // Serialize with a correct checksum, summing the header and payload in the same pass that writes them
+  // (equivalent to compute_checksum() followed by serialize())
+  void serialize_with_checksum( Serializer& serializer, uint32_t datagram_layer_pseudo_checksum );
+
+  // Store only the pseudo-header sum in the checksum field, for a device that completes the checksum
+  // itself (checksum offload: the device sums the header and payload into this partial value)
+  void compute_partial_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // Change a field and adjust the (complete) checksum to match, without summing the segment (RFC 1624),
+  // e.g. to rewrite a segment as a NAT does
+  void set_src_port( uint16_t new_port );
+  void set_dst_port( uint16_t new_port );
+  void set_seqno( Wrap32 new_seqno );
+
+  // Adjust the checksum for an address in the IPv4 pseudo-header changing from `old_address` to `new_address`
+  void update_checksum_for_address( uint32_t old_address, uint32_t new_address );
+
+  static constexpr uint8_t CHECKSUM_OFFSET = 16; // offset of the checksum field in the TCP header
+
   static constexpr uint8_t HEADER_LENGTH = 20; // TCP header length, not including options
 
+  // TCP options (RFC 9293 and RFC 7323)
+  static constexpr uint8_t OPTION_END = 0;
+  static constexpr uint8_t OPTION_NOP = 1;
+  static constexpr uint8_t OPTION_TIMESTAMPS = 8;
+  static constexpr uint8_t TIMESTAMPS_LENGTH = 10;        // kind, length, TSval, TSecr
+  static constexpr uint8_t TIMESTAMPS_OPTION_LENGTH = 12; // including two NOPs for alignment
+
+  // TCP header length, including any options this segment will be serialized with
+  uint8_t header_length() const;
+
   // Return a string containing a summary in human-readable format
   std::string to_string() const;
+
+private:
+  void serialize_header( Serializer& serializer ) const;
 };
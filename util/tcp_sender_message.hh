@@ -2,12 +2,13 @@
 
 #include "wrapping_integers.hh"
 
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains five fields:
+ * It contains six fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -20,6 +21,9 @@
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
  * 5) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 6) The timestamp (TSval of the RFC 7323 timestamps option), if the sender is using timestamps. The peer's
+ *    receiver echoes it back so that the sender can measure the round-trip time.
  */
 
 struct TCPSenderMessage
@@ -32,6 +36,8 @@ struct TCPSenderMessage
 
   bool RST {};
 
+  std::optional<uint32_t> timestamp {};
+
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
 };
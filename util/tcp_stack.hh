@@ -0,0 +1,163 @@
+#pragma once
+
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "random.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_listener.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+#include "tun.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! \brief A TCP stack that serves many connections over one datagram interface from a single thread
+//! \details Where each TCPMinnowSocket runs its own thread and event loop and filters the TUN device
+//! for one connection, a TCPStack owns the interface and demultiplexes every incoming segment to its
+//! connection through a hash table keyed by the segment's FourTuple. Segments for unknown
+//! connections are dropped, unless they are SYNs for a port with a listener.
+//!
+//! Applications get a LocalStreamSocket for each connection, as with TCPMinnowSocket, either from
+//! connect() or from a TCPListener.
+class TCPStack
+{
+public:
+  //! Construct from the TUN device that carries IPv4 datagrams in both directions
+  explicit TCPStack( TunFD&& tun );
+
+  //! Construct from separate file descriptors: each read from `ingress` yields one IPv4 datagram,
+  //! and each outgoing datagram is written to `egress` in one write
+  TCPStack( FileDescriptor&& ingress, FileDescriptor&& egress );
+
+  //! Open a connection from `c_ad.source` to `c_ad.destination` (without waiting for the handshake),
+  //! and return the application's end of the connection's byte stream
+  LocalStreamSocket connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+
+  //! Listen for connections to `local` (address "0" matches any local address), keeping up to `backlog`
+  //! connections that are half-open or waiting to be accepted
+  TCPListener listen( const TCPConfig& c_tcp, const Address& local, size_t backlog = DEFAULT_BACKLOG );
+
+  //! Listen for connections to `local` on behalf of an existing accept queue (e.g. one shared by several stacks)
+  void listen( const TCPConfig& c_tcp, const Address& local, std::shared_ptr<AcceptQueue> queue );
+
+  static constexpr size_t DEFAULT_BACKLOG = 128;
+
+  //! Number of connections currently served by the stack thread
+  size_t connection_count() const { return connection_count_.load(); }
+
+  //! Stop the stack thread; any open connections are abandoned
+  ~TCPStack();
+
+  //! \name
+  //! This object cannot be safely moved or copied, since it is in use by two threads simultaneously
+
+  //!@{
+  TCPStack( const TCPStack& ) = delete;
+  TCPStack( TCPStack&& ) = delete;
+  TCPStack& operator=( const TCPStack& ) = delete;
+  TCPStack& operator=( TCPStack&& ) = delete;
+  //!@}
+
+private:
+  //! One TCP connection and the stack's end of the application's byte stream
+  struct Connection
+  {
+    FourTuple flow;
+    TCPPeer peer;
+    LocalStreamSocket data;
+    bool inbound_shutdown {};  //!< Has the stack shut down the incoming data to the application?
+    bool outbound_shutdown {}; //!< Has the application shut down the outbound data to the connection?
+    std::vector<EventLoop::RuleHandle> rules {};
+
+    //! For a passively opened connection whose handshake is not complete: where to deliver it,
+    //! and the application's end of its byte stream
+    std::shared_ptr<AcceptQueue> listener {};
+    std::optional<LocalStreamSocket> app_side {};
+  };
+
+  //! A listening port
+  struct Listener
+  {
+    uint32_t address; //!< local address to accept connections on (0 for any)
+    TCPConfig config;
+    std::shared_ptr<AcceptQueue> queue;
+  };
+
+  //! A connection requested by the application thread, waiting to be picked up by the stack thread
+  struct PendingConnect
+  {
+    TCPConfig config;
+    FourTuple flow;
+    LocalStreamSocket data;
+  };
+
+  FileDescriptor ingress_;
+  FileDescriptor egress_;
+
+  //! Written by the application thread to wake the stack thread, read by the stack thread
+  LocalStreamSocket wake_sender_;
+  LocalStreamSocket wake_receiver_;
+
+  std::mutex pending_mutex_ {};
+  std::vector<PendingConnect> pending_ {};                          //!< protected by pending_mutex_
+  std::vector<std::pair<uint16_t, Listener>> pending_listeners_ {}; //!< protected by pending_mutex_
+
+  //! \name
+  //! State owned by the stack thread
+
+  //!@{
+  EventLoop eventloop_ { EventLoop::Backend::Epoll };
+  size_t push_category_ {};
+  size_t pull_category_ {};
+  std::unordered_map<FourTuple, std::unique_ptr<Connection>, FourTupleHash> connections_ {};
+  std::unordered_map<uint16_t, Listener> listeners_ {};
+  std::default_random_engine rng_ { get_random_engine() };
+  //!@}
+
+  std::atomic_size_t connection_count_ { 0 };
+  std::atomic_bool stop_ { false };
+  std::thread thread_ {};
+
+  //! Wrap a TCP message for a connection and write it to the egress interface
+  void transmit( const FourTuple& flow, const TCPMessage& msg );
+
+  //! Read and dispatch one datagram from the ingress interface
+  void receive_datagram();
+
+  //! Move connections and listeners requested by the application thread into the tables
+  void accept_pending();
+
+  //! Start a passively opened connection if a listener wants this SYN
+  void open_passive( const FourTuple& flow, TCPMessage&& syn );
+
+  //! Hand a passively opened connection to its listener once the handshake has completed
+  static void deliver_if_established( Connection& conn );
+
+  //! Queue work for the stack thread, waking it if the pending lists were empty
+  void post( const std::function<void()>& add_to_pending );
+
+  //! Add a connection to the table and install its event-loop rules
+  Connection& add_connection( const TCPConfig& config, const FourTuple& flow, LocalStreamSocket&& data );
+
+  //! Tick every connection, and remove the ones that have finished
+  void tick_connections( uint64_t ms_since_last_tick );
+
+  //! Main loop of the stack thread
+  void main_loop();
+
+  TCPStack( FileDescriptor&& ingress,
+            FileDescriptor&& egress,
+            std::pair<LocalStreamSocket, LocalStreamSocket> wake_pair );
+};
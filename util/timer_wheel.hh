@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// A hashed timing wheel (Varghese & Lauck). Each timer is filed in the slot for its deadline, so
+// advancing time costs work proportional to the slots passed over and the timers in them, not to the
+// total number of timers outstanding.
+//
+// A timer carries a value of type T (e.g. the key of the table entry it expires). Time is measured
+// in milliseconds from the wheel's creation and only moves forward via advance(), which hands each
+// due timer's value to the caller in deadline order. The caller may schedule or cancel timers meanwhile.
+template<typename T>
+class TimerWheel
+{
+public:
+  using TimerId = uint64_t;
+
+  explicit TimerWheel( uint64_t granularity_ms = 1, size_t slot_count = 1024 )
+    : granularity_ms_( granularity_ms ), slots_( slot_count )
+  {
+    if ( granularity_ms == 0 or slot_count == 0 ) {
+      throw std::runtime_error( "TimerWheel: granularity and slot count must be positive" );
+    }
+  }
+
+  // Schedule a timer to fire once the clock reaches `deadline_ms` (a deadline in the past fires on the next
+  // advance)
+  TimerId schedule_at( uint64_t deadline_ms, T value )
+  {
+    deadline_ms = std::max( deadline_ms, now_ );
+    const TimerId id = next_id_++;
+    slots_[slot_of( deadline_ms )].push_back( { deadline_ms, id, std::move( value ) } );
+    live_.insert( id );
+    return id;
+  }
+
+  // Schedule a timer to fire `delay_ms` from now
+  TimerId schedule_in( uint64_t delay_ms, T value ) { return schedule_at( now_ + delay_ms, std::move( value ) ); }
+
+  // Cancel a pending timer (no effect if it has already fired). The entry is discarded when its slot is visited.
+  void cancel( TimerId id ) { live_.erase( id ); }
+
+  // Move the clock forward by `ms`, calling `expire( T&& )` for every timer whose deadline has been reached
+  template<typename ExpireFunction>
+  void advance( uint64_t ms, ExpireFunction&& expire )
+  {
+    const uint64_t target = now_ + ms;
+
+    // Visit each slot between the old and new time (at most once around the wheel), collecting due timers.
+    // Timers filed in a visited slot but due on a later revolution stay where they are.
+    std::vector<Timer> due;
+    const uint64_t first_tick = now_ / granularity_ms_;
+    const uint64_t ticks = std::min<uint64_t>( target / granularity_ms_ - first_tick + 1, slots_.size() );
+    for ( uint64_t tick = first_tick; tick < first_tick + ticks; ++tick ) {
+      auto& slot = slots_[tick % slots_.size()];
+      auto first_due
+        = std::partition( slot.begin(), slot.end(), [&]( const Timer& t ) { return t.deadline > target; } );
+      std::move( first_due, slot.end(), std::back_inserter( due ) );
+      slot.erase( first_due, slot.end() );
+    }
+
+    now_ = target;
+
+    std::sort( due.begin(), due.end(), []( const Timer& a, const Timer& b ) {
+      return a.deadline != b.deadline ? a.deadline < b.deadline : a.id < b.id;
+    } );
+
+    for ( auto& timer : due ) {
+      if ( live_.erase( timer.id ) ) {
+        expire( std::move( timer.value ) );
+      }
+    }
+  }
+
+  uint64_t now() const { return now_; }
+  size_t pending() const { return live_.size(); }
+
+private:
+  struct Timer
+  {
+    uint64_t deadline;
+    TimerId id;
+    T value;
+  };
+
+  size_t slot_of( uint64_t time_ms ) const { return ( time_ms / granularity_ms_ ) % slots_.size(); }
+
+  uint64_t granularity_ms_;
+  std::vector<std::vector<Timer>> slots_;
+  std::unordered_set<TimerId> live_ {}; // timers scheduled but not yet fired or cancelled
+  uint64_t now_ {};
+  TimerId next_id_ {};
+};
@@ -0,0 +1,36 @@
+#include "timerfd.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <sys/timerfd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+TimerFD::TimerFD()
+  : FileDescriptor( ::CheckSystemCall( "timerfd_create",
+                                       ::timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC ) ) )
+{}
+
+void TimerFD::set( const steady_clock::time_point deadline )
+{
+  // an all-zero it_value would disarm the timer instead
+  const auto ns = max<int64_t>( duration_cast<nanoseconds>( deadline.time_since_epoch() ).count(), 1 );
+  const itimerspec spec { .it_interval = { 0, 0 }, .it_value = { ns / 1'000'000'000, ns % 1'000'000'000 } };
+  CheckSystemCall( "timerfd_settime", ::timerfd_settime( fd_num(), TFD_TIMER_ABSTIME, &spec, nullptr ) );
+}
+
+void TimerFD::disarm()
+{
+  const itimerspec spec {};
+  CheckSystemCall( "timerfd_settime", ::timerfd_settime( fd_num(), 0, &spec, nullptr ) );
+}
+
+void TimerFD::consume()
+{
+  string buffer( sizeof( uint64_t ), 0 );
+  read( buffer );
+}
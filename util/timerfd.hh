@@ -0,0 +1,23 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <chrono>
+
+//! A FileDescriptor to a Linux [timerfd](\ref man2::timerfd_create) on the steady clock, readable once its
+//! deadline has passed
+class TimerFD : public FileDescriptor
+{
+public:
+  //! Create a non-blocking, disarmed timerfd on CLOCK_MONOTONIC (the clock behind std::chrono::steady_clock)
+  TimerFD();
+
+  //! Fire once at `deadline` (at once if it has passed), replacing any earlier setting
+  void set( std::chrono::steady_clock::time_point deadline );
+
+  //! Stop the timer from firing
+  void disarm();
+
+  //! Reset the expiration count, so the timerfd is no longer readable
+  void consume();
+};
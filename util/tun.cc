@@ -1,19 +1,51 @@
 #include "tun.hh"
+#include "buffer_pool.hh"
+#include "checksum.hh"
 #include "exception.hh"
+#include "small_vector.hh"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <fcntl.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
+#include <stdexcept>
+#include <string_view>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 static constexpr const char* CLONEDEV = "/dev/net/tun";
 
+static_assert( sizeof( VirtioNetHeader ) == 10 ); // struct virtio_net_hdr
+
 using namespace std;
 
+namespace {
+
+// The byte at `offset` into the concatenation of `buffers` (which must reach that far)
+char& byte_at( vector<string>& buffers, size_t offset )
+{
+  for ( auto& buf : buffers ) {
+    if ( offset < buf.size() ) {
+      return buf[offset];
+    }
+    offset -= buf.size();
+  }
+  throw out_of_range( "byte_at" );
+}
+
+} // namespace
+
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects
 //! Ethernet frames)
+//! \param[in] tcp_offload is `true` to exchange TCP/IPv4 segments of up to 64 KiB with the kernel, which
+//! segments what we write (GSO) and coalesces what we read (GRO), and to leave TCP checksums to the kernel.
+//! Each packet is then preceded by a VirtioNetHeader.
+//! \param[in] multi_queue is `true` to attach one more queue to a device created with `multi_queue`; the
+//! kernel spreads incoming flows across the queues, and sends a flow's packets to the queue that last
+//! wrote one of its packets.
 //!
 //! To create a TUN device, you should already have run
 //!
@@ -21,13 +53,19 @@ using namespace std;
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD( const string& devname, const bool is_tun )
-  : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) )
+TunTapFD::TunTapFD( const string& devname, const bool is_tun, const bool tcp_offload, const bool multi_queue )
+  : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) ), tcp_offload_( tcp_offload )
 {
   struct ifreq tun_req
   {};
 
   tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI ); // no packetinfo
+  if ( tcp_offload ) {
+    tun_req.ifr_flags = static_cast<int16_t>( tun_req.ifr_flags | IFF_VNET_HDR );
+  }
+  if ( multi_queue ) {
+    tun_req.ifr_flags = static_cast<int16_t>( tun_req.ifr_flags | IFF_MULTI_QUEUE );
+  }
 
   // copy devname to ifr_name, making sure to null terminate
 
@@ -35,4 +73,124 @@ TunTapFD::TunTapFD( const string& devname, const bool is_tun )
   tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
   CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) );
+
+  if ( tcp_offload ) {
+    int header_size = sizeof( VirtioNetHeader );
+    CheckSystemCall( "ioctl(TUNSETVNETHDRSZ)", ioctl( fd_num(), TUNSETVNETHDRSZ, &header_size ) );
+  }
+
+  // set the offloads either way, since a persistent device keeps those of its previous user
+  const unsigned int offloads = tcp_offload ? TUN_F_CSUM | TUN_F_TSO4 : 0;
+  CheckSystemCall( "ioctl(TUNSETOFFLOAD)", ioctl( fd_num(), TUNSETOFFLOAD, offloads ) );
+}
+
+//! To create a multiqueue TUN device, run
+//!
+//!     ip tuntap add mode tun multi_queue user `username` name `devname`
+vector<TunFD> TunFD::open_queues( const string& devname, const size_t count, const bool tcp_offload )
+{
+  vector<TunFD> queues;
+  queues.reserve( count );
+  for ( size_t i = 0; i < count; i++ ) {
+    queues.emplace_back( devname, tcp_offload, true );
+  }
+  return queues;
+}
+
+void TunTapFD::read( VirtioNetHeader& vnet, vector<string>& buffers )
+{
+  if ( not tcp_offload_ ) {
+    throw runtime_error( "TunTapFD: device was not opened with TCP offload" );
+  }
+  if ( buffers.empty() ) {
+    return;
+  }
+
+  // read the header, the caller's buffers (the last at full size) and the tail chunks in one readv
+  if ( buffers.back().capacity() < BufferPool::LARGE_CAPACITY ) {
+    buffers.back() = BufferPool::large();
+  }
+  buffers.back().resize( BufferPool::LARGE_CAPACITY );
+
+  SmallVector<iovec, 8> iovecs;
+  iovecs.reserve( 1 + buffers.size() + tail_chunks_.size() );
+  iovecs.push_back( { &vnet, sizeof( vnet ) } );
+  for ( auto& x : buffers ) {
+    iovecs.push_back( { x.data(), x.size() } );
+  }
+  for ( auto& chunk : tail_chunks_ ) {
+    if ( chunk.capacity() < BufferPool::LARGE_CAPACITY ) {
+      chunk = BufferPool::large();
+    }
+    chunk.resize( BufferPool::LARGE_CAPACITY ); // (only chunks handed to the caller need filling again)
+    iovecs.push_back( { chunk.data(), chunk.size() } );
+  }
+
+  const ssize_t bytes_read = ::readv( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) );
+  if ( bytes_read < 0 ) {
+    if ( non_blocking() and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
+      buffers.clear();
+      return;
+    }
+    throw unix_error { "read" };
+  }
+
+  register_read();
+
+  if ( static_cast<size_t>( bytes_read ) < sizeof( vnet ) ) {
+    throw runtime_error( "TunTapFD: read a packet without its header" );
+  }
+  const size_t packet_size = bytes_read - sizeof( vnet );
+
+  // trim the buffers to the packet, handing over the tail chunks it reached
+  size_t remaining = packet_size;
+  for ( auto& buf : buffers ) {
+    buf.resize( min( buf.size(), remaining ) );
+    remaining -= buf.size();
+  }
+  for ( size_t i = 0; remaining > 0 and i < tail_chunks_.size(); i++ ) {
+    buffers.push_back( move( tail_chunks_[i] ) );
+    tail_chunks_[i] = BufferPool::large();
+    buffers.back().resize( min<size_t>( BufferPool::LARGE_CAPACITY, remaining ) );
+    remaining -= buffers.back().size();
+  }
+
+  // complete a checksum that the kernel left partial (its sum so far is in the checksum field), summing
+  // each buffer's part of the checksummed region in turn
+  if ( vnet.flags & VirtioNetHeader::F_NEEDS_CSUM ) {
+    const size_t field = vnet.csum_start + vnet.csum_offset;
+    if ( field + 2 > packet_size ) {
+      throw runtime_error( "TunTapFD: checksum offset beyond the end of the packet" );
+    }
+
+    InternetChecksum check;
+    size_t offset = 0;
+    for ( const auto& buf : buffers ) {
+      if ( offset + buf.size() > vnet.csum_start ) {
+        check.add( string_view { buf }.substr( vnet.csum_start > offset ? vnet.csum_start - offset : 0 ) );
+      }
+      offset += buf.size();
+    }
+
+    const uint16_t checksum = check.value();
+    byte_at( buffers, field ) = static_cast<char>( checksum >> 8 );
+    byte_at( buffers, field + 1 ) = static_cast<char>( checksum & 0xff );
+    vnet.flags = VirtioNetHeader::F_DATA_VALID;
+  }
+}
+
+//! \returns the number of bytes written, including the header
+size_t TunTapFD::write( const VirtioNetHeader& vnet, const span<const Ref<string>> buffers )
+{
+  if ( not tcp_offload_ ) {
+    throw runtime_error( "TunTapFD: device was not opened with TCP offload" );
+  }
+
+  SmallVector<string_view, 8> views;
+  views.reserve( buffers.size() + 1 );
+  views.emplace_back( reinterpret_cast<const char*>( &vnet ), sizeof( vnet ) ); // NOLINT(*-reinterpret-cast)
+  for ( const auto& x : buffers ) {
+    views.emplace_back( x.get() );
+  }
+  return FileDescriptor::write( views );
 }
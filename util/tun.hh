@@ -1,16 +1,69 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "file_descriptor.hh"
+#include "ref.hh"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <vector>
+
+//! \brief The header preceding each packet on a TUN/TAP device opened with TCP offload
+//! \details Mirrors `struct virtio_net_hdr` from linux/virtio_net.h (which cannot be included from C++),
+//! with fields in host byte order.
+struct VirtioNetHeader
+{
+  uint8_t flags {};
+  uint8_t gso_type {};
+  uint16_t hdr_len {};     //!< length of the headers copied into each segment
+  uint16_t gso_size {};    //!< payload bytes per segment
+  uint16_t csum_start {};  //!< where the checksummed region starts
+  uint16_t csum_offset {}; //!< where the checksum field is, from csum_start
+
+  static constexpr uint8_t F_NEEDS_CSUM = 1; //!< checksum is partial (only the pseudo-header sum)
+  static constexpr uint8_t F_DATA_VALID = 2; //!< checksum is known to be valid
+  static constexpr uint8_t GSO_NONE = 0;
+  static constexpr uint8_t GSO_TCPV4 = 1;
+};
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor
 {
+public:
+  //! Largest packet a device with TCP offload can pass in one read or write (a GSO super-segment)
+  static constexpr size_t MAX_OFFLOAD_PACKET_SIZE = 65535;
+
+private:
+  //! Pool-sized buffers that, after the caller's last buffer, can take the rest of the largest packet
+  static constexpr size_t TAIL_CHUNKS = ( MAX_OFFLOAD_PACKET_SIZE - 1 ) / BufferPool::LARGE_CAPACITY;
+
+  bool tcp_offload_;
+  std::array<std::string, TAIL_CHUNKS> tail_chunks_ {}; // handed to the caller only when a packet needs them
+
 public:
   //! Open an existing persistent [TUN or TAP
   //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunTapFD( const std::string& devname, bool is_tun );
+  explicit TunTapFD( const std::string& devname, bool is_tun, bool tcp_offload = false, bool multi_queue = false );
+
+  //! Whether each packet is preceded by a VirtioNetHeader, and TCP/IPv4 segments may exceed the MTU
+  bool tcp_offload() const { return tcp_offload_; }
+
+  using FileDescriptor::read;
+  using FileDescriptor::write;
+
+  //! \brief Read one packet from a device opened with TCP offload
+  //! \details Fills `buffers` in order, as FileDescriptor::read does, except that a packet longer than
+  //! them (a GRO coalescing, of up to MAX_OFFLOAD_PACKET_SIZE) continues in buffers of
+  //! BufferPool::LARGE_CAPACITY appended to `buffers`. The packet is read in place, without a copy. A
+  //! checksum the kernel left for us to complete is filled in, so the packet can be parsed as usual.
+  //! `vnet` receives the packet's header.
+  void read( VirtioNetHeader& vnet, std::vector<std::string>& buffers );
+
+  //! Write one packet, preceded by `vnet`, to a device opened with TCP offload
+  size_t write( const VirtioNetHeader& vnet, std::span<const Ref<std::string>> buffers );
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -18,7 +71,12 @@ class TunFD : public TunTapFD
 {
 public:
   //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunFD( const std::string& devname ) : TunTapFD( devname, true ) {}
+  explicit TunFD( const std::string& devname, const bool tcp_offload = false, const bool multi_queue = false )
+    : TunTapFD( devname, true, tcp_offload, multi_queue )
+  {}
+
+  //! Open `count` queues of an existing multiqueue TUN device, each to be read and written by one thread
+  static std::vector<TunFD> open_queues( const std::string& devname, size_t count, bool tcp_offload = false );
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
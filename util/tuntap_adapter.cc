@@ -1,25 +1,91 @@
 #include "tuntap_adapter.hh"
+#include "buffer_pool.hh"
 #include "helpers.hh"
 
+#include <stdexcept>
+
 using namespace std;
 
+TCPOverIPv4OverTunFdAdapter::TCPOverIPv4OverTunFdAdapter( TunFD&& tun, const bool use_io_uring )
+  : _tun( move( tun ) )
+{
+  if ( use_io_uring ) {
+    if ( _tun.tcp_offload() ) {
+      throw runtime_error( "TCPOverIPv4OverTunFdAdapter: io_uring does not support a TunFD with TCP offload" );
+    }
+    _uring = make_unique<IoUringPacketIO>( _tun );
+  }
+
+  // a device with TCP offload completes the checksums it is left, which by default it is
+  if ( _tun.tcp_offload() ) {
+    set_device_completes_checksums( true );
+    set_checksum_offload( { .partial_transmit = true } );
+  }
+}
+
 optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
 {
-  vector<string> strs( 3 );
+  if ( _uring ) {
+    // one copy, out of the buffer the kernel read the datagram into
+    auto& strs = _read_buffers;
+    strs.resize( 1 );
+    strs[0] = BufferPool::large();
+    InternetDatagram ip_dgram;
+    if ( _uring->read( strs[0] ) and parse( ip_dgram, strs, not checksum_offload().skip_verify ) ) {
+      return unwrap_tcp_in_ip( move( ip_dgram ) );
+    }
+    return {};
+  }
+
+  // the header buffers come from the pool, and return to it once parsed (the payload buffer is
+  // taken from the pool by FileDescriptor::read)
+  auto& strs = _read_buffers;
+  strs.resize( 3 );
+  strs[0] = BufferPool::small();
   strs[0].resize( IPv4Header::LENGTH );
+  strs[1] = BufferPool::small();
   strs[1].resize( TCPSegment::HEADER_LENGTH );
-  _tun.read( strs );
+  VirtioNetHeader vnet {};
+  if ( _tun.tcp_offload() ) {
+    _tun.read( vnet, strs ); // the segment may be a GRO coalescing of several (up to 64 KiB)
+  } else {
+    _tun.read( strs );
+  }
 
+  // moves the strings out, leaving the vector for the next read
   InternetDatagram ip_dgram;
-  if ( parse( ip_dgram, move( strs ) ) ) {
-    return unwrap_tcp_in_ip( move( ip_dgram ) );
+  if ( parse( ip_dgram, strs, not checksum_offload().skip_verify ) ) {
+    // the kernel vouches for (or TunTapFD::read completed) a checksum marked valid
+    return unwrap_tcp_in_ip( move( ip_dgram ), vnet.flags & VirtioNetHeader::F_DATA_VALID );
   }
   return {};
 }
 
 void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )
 {
-  _tun.write( serialize( wrap_tcp_in_ip( seg ) ) );
+  if ( _uring ) {
+    _uring->write( serialize_tcp_in_ip( seg ) );
+    return;
+  }
+
+  if ( not _tun.tcp_offload() ) {
+    _tun.write( serialize_tcp_in_ip( seg ) );
+    return;
+  }
+
+  // leave the TCP checksum to the kernel if asked to (the TCPSender's segments fit the MSS, so none needs
+  // splitting)
+  const bool partial = checksum_offload().partial_transmit;
+  const PacketBuffers datagram = serialize_tcp_in_ip( seg, partial );
+  VirtioNetHeader vnet {};
+  vnet.gso_type = VirtioNetHeader::GSO_NONE;
+  vnet.hdr_len = static_cast<uint16_t>( datagram.front()->size() - seg.sender->payload.size() );
+  if ( partial ) {
+    vnet.flags = VirtioNetHeader::F_NEEDS_CSUM;
+    vnet.csum_start = IPv4Header::LENGTH;
+    vnet.csum_offset = TCPSegment::CHECKSUM_OFFSET;
+  }
+  _tun.write( vnet, datagram );
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
@@ -1,12 +1,16 @@
 #pragma once
 
+#include "io_uring_packet_io.hh"
 #include "lossy_fd_adapter.hh"
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
 
+#include <memory>
 #include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
 template<class T>
 concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
@@ -16,29 +20,46 @@ concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
 };
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
+//! \details If the TunFD was opened with TCP offload, the kernel completes the checksums of the segments
+//! written (unless ChecksumOffload::partial_transmit, on by default for such a device, is turned off),
+//! and may coalesce the segments read. Other adapters refuse partial_transmit, as nothing would complete
+//! the checksums.
+//! With io_uring, the device is read and written through an IoUringPacketIO instead: the segments written
+//! are queued until flush(), and fd() is the ring's, which is readable when a datagram has arrived.
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 {
 private:
   TunFD _tun;
+  std::vector<std::string> _read_buffers {};   //!< Reused by each read
+  std::unique_ptr<IoUringPacketIO> _uring {}; //!< Set in io_uring mode
 
 public:
-  //! Construct from a TunFD
-  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
+  //! \brief Construct from a TunFD, to be read and written directly or (with `use_io_uring`) through an io_uring
+  //! \throws runtime_error if asked for io_uring on a TunFD opened with TCP offload, which it does not support
+  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun, bool use_io_uring = false );
 
   //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
   std::optional<TCPMessage> read();
 
-  //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
+  //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device (or queues the write)
   void write( const TCPMessage& seg );
 
+  //! In io_uring mode, hand the queued writes to the kernel at once
+  void flush()
+  {
+    if ( _uring ) {
+      _uring->flush();
+    }
+  }
+
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }
 
   //! Access the underlying TUN device
   explicit operator const TunFD&() const { return _tun; }
 
-  //! Access underlying file descriptor
-  FileDescriptor& fd() { return _tun; }
+  //! Access the file descriptor to wait on: the TUN device, or in io_uring mode the ring
+  FileDescriptor& fd() { return _uring ? _uring->fd() : _tun; }
 };
 
 static_assert( TCPDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );